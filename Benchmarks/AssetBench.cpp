@@ -0,0 +1,933 @@
+// Asset pipeline micro-benchmarks: OBJ parsing, triangulation, GPU buffer
+// packing, bulk vertex math (AoS against the SoA kernels), meshlets, DDS reading and
+// scene files, light clustering, software rendering, flocking, terrain and cold starts from loose
+// files against an asset pack, on the shipped assets and generated stress inputs
+//
+// Build (Linux, from this folder), add -mavx2 for the AVX2 kernels or
+// -DMESHSOA_NO_SIMD -DFLOCK_NO_SIMD for the scalar ones:
+//	g++ -O2 -std=c++14 -pthread -I../CameraControl AssetBench.cpp ../CameraControl/meshbuffer.cpp ../CameraControl/meshsoa.cpp ../CameraControl/meshnormals.cpp ../CameraControl/dds.cpp ../CameraControl/scene.cpp ../CameraControl/transform.cpp ../CameraControl/jobs.cpp ../CameraControl/lightcluster.cpp ../CameraControl/softraster.cpp ../CameraControl/pack.cpp ../CameraControl/flock.cpp ../CameraControl/terrain.cpp ../CameraControl/meshlet.cpp -o asset_bench
+// Run from the CameraControl folder so the asset paths resolve, optionally
+// passing name filters and --min-time <seconds>:
+//	../Benchmarks/asset_bench LoadFile readDDS
+
+#define OBJL_NO_CONSOLE_OUTPUT
+
+#include <array>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "BenchHarness.h"
+
+#include "OBJ-Loader.h"
+#include "meshbuffer.h"
+#include "meshsoa.h"
+#include "meshnormals.h"
+#include "parallel.h"
+#include "dds.h"
+#include "scene.h"
+#include "lightcluster.h"
+#include "softraster.h"
+#include "flock.h"
+#include "terrain.h"
+#include "pack.h"
+#include "meshlet.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+static size_t fileSize(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	return file.is_open() ? (size_t)file.tellg() : 0;
+}
+
+// Drop a file from the page cache so the next read has to go to the disk. Only
+// Linux offers this without root, elsewhere the cold runs read warm files
+static void evictFromCache(const std::string& path)
+{
+#ifdef __linux__
+	int file = open(path.c_str(), O_RDONLY);
+	if (file >= 0)
+	{
+		posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+		close(file);
+	}
+#endif
+}
+
+// Write an N x N grid of textured quads, with or without normals. Every face
+// is a quad so LoadFile has to triangulate it
+static void writeStressObj(const std::string& path, int n, bool withNormals = true)
+{
+	std::ofstream file(path);
+	file << "o stress_grid\n";
+	for (int z = 0; z <= n; z++)
+		for (int x = 0; x <= n; x++)
+			file << "v " << x * 0.1f << " " << sinf(x * 0.3f) * cosf(z * 0.2f) << " " << z * 0.1f << "\n";
+	for (int z = 0; z <= n; z++)
+		for (int x = 0; x <= n; x++)
+			file << "vt " << float(x) / n << " " << float(z) / n << "\n";
+	if (withNormals)
+		file << "vn 0 1 0\n";
+	const char* normal = withNormals ? "/1 " : " ";
+	for (int z = 0; z < n; z++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			int a = z * (n + 1) + x + 1;
+			int b = a + 1;
+			int c = a + n + 2;
+			int d = a + n + 1;
+			file << "f " << a << "/" << a << normal << b << "/" << b << normal
+				<< c << "/" << c << normal << d << "/" << d << normal << "\n";
+		}
+	}
+}
+
+// Write a DXT texture with a full mip chain filled with pseudo random blocks
+static void writeStressDDS(const std::string& path, unsigned int size, unsigned int fourCC)
+{
+	unsigned int blockSize = fourCC == FOURCC_DXT1 ? 8 : 16;
+	unsigned int levels = 0;
+	unsigned int total = 0;
+	for (unsigned int s = size; s > 0; s /= 2, levels++)
+		total += ((s + 3) / 4) * ((s + 3) / 4) * blockSize;
+
+	unsigned char header[124] = {};
+	unsigned int linearSize = ((size + 3) / 4) * ((size + 3) / 4) * blockSize;
+	*(unsigned int*)&header[0] = 124;
+	*(unsigned int*)&header[8] = size;
+	*(unsigned int*)&header[12] = size;
+	*(unsigned int*)&header[16] = linearSize;
+	*(unsigned int*)&header[24] = levels;
+	*(unsigned int*)&header[80] = fourCC;
+
+	std::vector<unsigned char> data(std::max(total, linearSize * 2));
+	unsigned int seed = 12345;
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		data[i] = (unsigned char)(seed >> 24);
+	}
+
+	FILE* fp = fopen(path.c_str(), "wb");
+	fwrite("DDS ", 1, 4, fp);
+	fwrite(header, 1, sizeof(header), fp);
+	fwrite(data.data(), 1, data.size(), fp);
+	fclose(fp);
+}
+
+// Write a text scene with one object line per instance, as an editor would export it.
+// Objects are split into groups of 1000, one group in ten spins. The last objects
+// join the first group out of order, so the loader has to sort the nodes
+static void writeStressScene(const std::string& path, int count)
+{
+	std::ofstream file(path);
+	file << "material Fir_v1 textures/fir.dds\n";
+	file << "mesh tree objects/fir.obj\n";
+	file << "mesh raven objects/raven.obj\n";
+	for (int i = 0; i < count; i++)
+	{
+		int group = i / 1000;
+		if (i % 1000 == 0)
+		{
+			file << "group g" << group << " position " << (group % 10) * 20.0f << " 0 " << (group / 10) * 20.0f;
+			file << (group % 10 == 0 ? " spin 30\n" : "\n");
+		}
+		file << (i % 10 ? "object tree" : "object raven") << " parent g" << (i + 10 < count ? group : 0)
+			<< " position " << (i % 31) * 0.5f << " 0 " << (i % 1000 / 31) * 0.5f
+			<< " rotation 0 " << (i * 37) % 360 << " 0 scale " << 0.8f + (i % 7) * 0.1f << "\n";
+	}
+}
+
+// A regular convex polygon in the XZ plane
+static std::vector<objl::Vertex> makePolygon(int corners)
+{
+	std::vector<objl::Vertex> polygon(corners);
+	for (int i = 0; i < corners; i++)
+	{
+		float angle = 6.2831853f * i / corners;
+		polygon[i].Position = objl::Vector3(cosf(angle), 0.0f, sinf(angle));
+	}
+	return polygon;
+}
+
+// A UV sphere with shared vertices, 2 * rings * segments triangles
+static void makeSphere(int rings, int segments, std::vector<float>& positions, std::vector<unsigned int>& indices)
+{
+	positions.clear();
+	indices.clear();
+
+	for (int r = 0; r <= rings; r++)
+	{
+		float phi = glm::pi<float>() * r / rings;
+		for (int s = 0; s <= segments; s++)
+		{
+			float theta = glm::two_pi<float>() * s / segments;
+			positions.push_back(sinf(phi) * cosf(theta));
+			positions.push_back(cosf(phi));
+			positions.push_back(sinf(phi) * sinf(theta));
+		}
+	}
+
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < segments; s++)
+		{
+			unsigned int a = r * (segments + 1) + s;
+			unsigned int b = a + segments + 1;
+			indices.push_back(a); indices.push_back(a + 1); indices.push_back(b);
+			indices.push_back(a + 1); indices.push_back(b + 1); indices.push_back(b);
+		}
+	}
+}
+
+// Partition a mesh into meshlets and cull them from 64 views orbiting it. When
+// either is selected it is also checked that every triangle lands in exactly one
+// meshlet within the limits, and that a meshlet the normal cone rejects has no
+// triangle facing the camera
+static void benchMeshlets(bench::Runner& runner, const std::string& name, const float* positions, size_t stride,
+	size_t vertexCount, const std::vector<unsigned int>& indices, float viewDistance)
+{
+	if (!runner.selected("buildMeshlets/" + name) && !runner.selected("cullMeshlets/" + name))
+		return;
+
+	const int views = 64;
+	glm::mat4 projection = glm::perspective(45.0f, 1.0f, 0.1f, 100.0f * viewDistance);
+	std::vector<glm::vec3> eyes(views);
+	std::vector<glm::mat4> viewProjections(views);
+	for (int v = 0; v < views; v++)
+	{
+		float angle = glm::two_pi<float>() * v / views;
+		eyes[v] = glm::vec3(cosf(angle) * viewDistance, viewDistance * 0.3f, sinf(angle) * viewDistance);
+		viewProjections[v] = projection * glm::lookAt(eyes[v], glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	size_t triangles = indices.size() / 3;
+	runner.run("buildMeshlets/" + name, [&]()
+	{
+		MeshletData data = buildMeshlets(positions, stride, vertexCount, indices);
+		bench::doNotOptimize(data.meshlets.size());
+	}, 0.0, (double)triangles, "tri");
+
+	MeshletData data = buildMeshlets(positions, stride, vertexCount, indices);
+	MeshletDrawList list;
+	runner.run("cullMeshlets/" + name, [&]()
+	{
+		for (int v = 0; v < views; v++)
+			cullMeshlets(data, glm::mat4(1.0f), viewProjections[v], eyes[v], list);
+		bench::doNotOptimize(list.visibleTriangles);
+	}, 0.0, (double)data.meshlets.size() * views, "meshlet");
+
+	// The same triangles, each corner order kept, before and after partitioning
+	std::vector<std::array<unsigned int, 3> > before(triangles), after(triangles);
+	for (size_t t = 0; t < triangles && data.indices.size() == indices.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			before[t][k] = indices[t * 3 + k];
+			after[t][k] = data.indices[t * 3 + k];
+		}
+	}
+	std::sort(before.begin(), before.end());
+	std::sort(after.begin(), after.end());
+	bool partitioned = data.indices.size() == indices.size() && before == after;
+	for (const Meshlet& meshlet : data.meshlets)
+		partitioned = partitioned && meshlet.vertexCount <= MESHLET_MAX_VERTICES && meshlet.triangleCount <= MESHLET_MAX_TRIANGLES;
+
+	unsigned long long visible = 0, frustum = 0, cone = 0, wrongCone = 0;
+	for (int v = 0; v < views; v++)
+	{
+		cullMeshlets(data, glm::mat4(1.0f), viewProjections[v], eyes[v], list);
+		visible += list.visibleTriangles;
+		frustum += list.frustumCulled;
+		cone += list.coneCulled;
+
+		for (const Meshlet& meshlet : data.meshlets)
+		{
+			if (glm::dot(glm::normalize(meshlet.coneApex - eyes[v]), meshlet.coneAxis) < meshlet.coneCutoff)
+				continue;
+			for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+			{
+				const unsigned int* corner = &data.indices[meshlet.indexOffset + t * 3];
+				const float* p[3] = { positions + corner[0] * stride, positions + corner[1] * stride, positions + corner[2] * stride };
+				glm::vec3 a(p[0][0], p[0][1], p[0][2]), b(p[1][0], p[1][1], p[1][2]), c(p[2][0], p[2][1], p[2][2]);
+				if (glm::dot(glm::cross(b - a, c - a), eyes[v] - a) > 0.0f)
+				{
+					wrongCone++;
+					break;
+				}
+			}
+		}
+	}
+
+	std::cout << "    " << data.meshlets.size() << " meshlets, " << std::setprecision(1) << (double)triangles / data.meshlets.size()
+		<< " triangles each, " << 100.0 * visible / ((double)triangles * views) << "% of triangles visible, "
+		<< frustum / views << " frustum and " << cone / views << " cone culled meshlets per view" << std::endl;
+	runner.check("buildMeshlets/" + name, "meshlets partition the triangles", partitioned);
+	runner.check("cullMeshlets/" + name, "cone culled meshlets all back facing", wrongCone == 0);
+}
+
+// Reference AoS versions of the meshsoa kernels, written the way the loader
+// does its math: one objl::Vertex and one objl::math call at a time
+
+static void aosBounds(const std::vector<objl::Vertex>& vertices, MeshBounds& bounds)
+{
+	objl::Vector3 low = vertices[0].Position, high = low;
+	for (size_t i = 1; i < vertices.size(); i++)
+	{
+		const objl::Vector3& p = vertices[i].Position;
+		low = objl::Vector3(std::min(low.X, p.X), std::min(low.Y, p.Y), std::min(low.Z, p.Z));
+		high = objl::Vector3(std::max(high.X, p.X), std::max(high.Y, p.Y), std::max(high.Z, p.Z));
+	}
+	bounds.min[0] = low.X; bounds.min[1] = low.Y; bounds.min[2] = low.Z;
+	bounds.max[0] = high.X; bounds.max[1] = high.Y; bounds.max[2] = high.Z;
+}
+
+static void aosNormals(std::vector<objl::Vertex>& vertices, const std::vector<unsigned int>& indices, bool smooth)
+{
+	if (smooth)
+		for (size_t i = 0; i < vertices.size(); i++)
+			vertices[i].Normal = objl::Vector3();
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		objl::Vertex& a = vertices[indices[t]];
+		objl::Vertex& b = vertices[indices[t + 1]];
+		objl::Vertex& c = vertices[indices[t + 2]];
+		objl::Vector3 n = objl::math::CrossV3(b.Position - a.Position, c.Position - a.Position);
+		if (smooth)
+		{
+			a.Normal = a.Normal + n;
+			b.Normal = b.Normal + n;
+			c.Normal = c.Normal + n;
+		}
+		else
+		{
+			float length = objl::math::MagnitudeV3(n);
+			n = length > 0.0f ? n / length : objl::Vector3();
+			a.Normal = b.Normal = c.Normal = n;
+		}
+	}
+
+	if (smooth)
+	{
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			float length = objl::math::MagnitudeV3(vertices[i].Normal);
+			vertices[i].Normal = length > 0.0f ? vertices[i].Normal / length : objl::Vector3();
+		}
+	}
+}
+
+static void aosTangents(const std::vector<objl::Vertex>& vertices, const std::vector<unsigned int>& indices,
+	std::vector<objl::Vector3>& tangents, std::vector<objl::Vector3>& bitangents, std::vector<float>& signs)
+{
+	tangents.assign(vertices.size(), objl::Vector3());
+	bitangents.assign(vertices.size(), objl::Vector3());
+	signs.resize(vertices.size());
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		const objl::Vertex& a = vertices[indices[t]];
+		const objl::Vertex& b = vertices[indices[t + 1]];
+		const objl::Vertex& c = vertices[indices[t + 2]];
+		objl::Vector3 e1 = b.Position - a.Position, e2 = c.Position - a.Position;
+		objl::Vector2 d1 = b.TextureCoordinate - a.TextureCoordinate, d2 = c.TextureCoordinate - a.TextureCoordinate;
+		float det = d1.X * d2.Y - d2.X * d1.Y;
+		float r = det != 0.0f ? 1.0f / det : 0.0f;
+		objl::Vector3 tangent = (e1 * d2.Y - e2 * d1.Y) * r;
+		objl::Vector3 bitangent = (e2 * d1.X - e1 * d2.X) * r;
+		for (int k = 0; k < 3; k++)
+		{
+			tangents[indices[t + k]] = tangents[indices[t + k]] + tangent;
+			bitangents[indices[t + k]] = bitangents[indices[t + k]] + bitangent;
+		}
+	}
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const objl::Vector3& n = vertices[i].Normal;
+		objl::Vector3 tangent = tangents[i] - n * objl::math::DotV3(n, tangents[i]);
+		float length = objl::math::MagnitudeV3(tangent);
+		tangents[i] = length > 0.0f ? tangent / length : objl::Vector3();
+		signs[i] = objl::math::DotV3(objl::math::CrossV3(n, tangents[i]), bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+	}
+}
+
+static void aosTransform(std::vector<objl::Vertex>& vertices, const float* m)
+{
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		objl::Vector3 p = vertices[i].Position;
+		vertices[i].Position = objl::Vector3(
+			m[0] * p.X + m[4] * p.Y + m[8] * p.Z + m[12],
+			m[1] * p.X + m[5] * p.Y + m[9] * p.Z + m[13],
+			m[2] * p.X + m[6] * p.Y + m[10] * p.Z + m[14]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bench::Runner runner(argc, argv);
+	// The thread counts compared, at least 4 so the checks mean something on small machines
+	const unsigned int threadCounts[] = { 1, std::max(4u, parallelThreadCount()) };
+
+	const char* objects[] = { "objects/fir.obj", "objects/raven.obj", "objects/watchtower.obj" };
+	const char* textures[] = { "textures/fir.dds", "textures/floor1.dds", "textures/raven.dds", "textures/watchtower.dds" };
+
+	if (fileSize(objects[0]) == 0)
+	{
+		std::cout << "Assets not found, run from the CameraControl folder" << std::endl;
+		return 1;
+	}
+
+	// Generated stress inputs, removed again at the end
+	std::vector<std::string> objPaths(objects, objects + 3);
+	std::vector<std::string> ddsPaths(textures, textures + 4);
+	std::vector<std::string> generated;
+
+	objPaths.push_back("bench_stress_grid_128.obj");
+	writeStressObj(objPaths.back(), 128);
+	generated.push_back(objPaths.back());
+	objPaths.push_back("bench_stress_grid_512.obj");
+	writeStressObj(objPaths.back(), 512);
+	generated.push_back(objPaths.back());
+
+	ddsPaths.push_back("bench_stress_4096_dxt1.dds");
+	writeStressDDS(ddsPaths.back(), 4096, FOURCC_DXT1);
+	generated.push_back(ddsPaths.back());
+	ddsPaths.push_back("bench_stress_4096_dxt5.dds");
+	writeStressDDS(ddsPaths.back(), 4096, FOURCC_DXT5);
+	generated.push_back(ddsPaths.back());
+
+	bench::Runner::printHeader();
+
+	// OBJ parsing
+	for (size_t i = 0; i < objPaths.size(); i++)
+	{
+		const std::string& path = objPaths[i];
+		objl::Loader probe;
+		probe.LoadFile(path);
+		double vertices = (double)probe.LoadedVertices.size();
+
+		std::string name = "LoadFile/" + path.substr(path.find_last_of('/') + 1);
+		runner.run(name, [&]()
+		{
+			objl::Loader loader;
+			loader.LoadFile(path);
+			bench::doNotOptimize(loader.LoadedVertices.size());
+		}, (double)fileSize(path), vertices, "vert");
+
+		// Heap allocations should not scale with the face count
+		if (!runner.results.empty() && runner.results.back().name == name)
+		{
+			double triangles = probe.LoadedIndices.size() / 3.0;
+			std::cout << "    " << std::setprecision(3) << runner.results.back().allocationsPerIteration / triangles
+				<< " allocations per triangle, parse arena " << probe.LastLoadArenaBlocks << " blocks / "
+				<< probe.LastLoadArenaBytes / 1024 << " KB" << std::endl;
+		}
+	}
+
+	// Triangulation of single faces, 1000 faces per call
+	const int cornerCounts[] = { 3, 4, 5, 8, 16 };
+	for (int corners : cornerCounts)
+	{
+		std::vector<objl::Vertex> polygon = makePolygon(corners);
+		objl::Loader loader;
+		runner.run("VertexTriangluation/" + std::to_string(corners) + "-gon", [&]()
+		{
+			std::vector<unsigned int> indices;
+			for (int f = 0; f < 1000; f++)
+			{
+				indices.clear();
+				loader.VertexTriangluation(indices, polygon);
+			}
+			bench::doNotOptimize(indices.size());
+		}, 0.0, 1000.0, "face");
+	}
+
+	// Interleaving into the GPU vertex layout and index copy
+	for (size_t i = 0; i < objPaths.size(); i++)
+	{
+		const std::string& path = objPaths[i];
+		std::string name = path.substr(path.find_last_of('/') + 1);
+		objl::Loader loader;
+		loader.LoadFile(path);
+		double vertices = (double)loader.LoadedVertices.size();
+		double indices = (double)loader.LoadedIndices.size();
+
+		runner.run("loadVertices/" + name, [&]()
+		{
+			std::vector<float> packed = loadVertices(loader);
+			bench::doNotOptimize(packed.size());
+		}, vertices * 9 * sizeof(float), vertices, "vert");
+
+		runner.run("loadIndices/" + name, [&]()
+		{
+			std::vector<unsigned int> packed = loadIndices(loader);
+			bench::doNotOptimize(packed.size());
+		}, indices * sizeof(unsigned int), indices, "index");
+	}
+
+	// Everything setUpObject does on the CPU, the peak RSS column shows how many
+	// copies of the model are alive at once
+	for (size_t i = 0; i < objPaths.size(); i++)
+	{
+		const std::string& path = objPaths[i];
+		runner.run("pipeline/" + path.substr(path.find_last_of('/') + 1), [&]()
+		{
+			objl::Loader loader;
+			loader.LoadFile(path);
+			std::vector<float> vertices = loadVertices(loader);
+			std::vector<objl::Vertex>().swap(loader.LoadedVertices);
+			std::vector<unsigned int> indices = loadIndices(std::move(loader));
+			bench::doNotOptimize(vertices.size() + indices.size());
+		}, (double)fileSize(path));
+	}
+
+	// Bulk vertex math, AoS reference against the SoA kernels. Both sides work
+	// in place on their own copy so repeated runs do the same work
+	std::cout << "meshsoa kernels: " << meshSoaKernels() << std::endl;
+	const char* soaObjects[] = { "objects/watchtower.obj", "bench_stress_grid_512.obj" };
+	for (const char* path : soaObjects)
+	{
+		std::string name = std::string(path).substr(std::string(path).find_last_of('/') + 1);
+		objl::Loader loader;
+		loader.LoadFile(path);
+		std::vector<objl::Vertex> aos = loader.LoadedVertices;
+		const std::vector<unsigned int>& indices = loader.LoadedIndices;
+		MeshSoA soa;
+		loadMeshSoA(loader, soa);
+		double vertices = (double)aos.size();
+		double triangles = indices.size() / 3.0;
+
+		// A small rotation about Y, repeated transforms stay bounded
+		const float c = cosf(0.01f), s = sinf(0.01f);
+		const float rotation[16] = { c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0, 0, 0, 0, 1 };
+		const float normalMatrix[9] = { c, 0, -s, 0, 1, 0, s, 0, c };
+
+		MeshBounds aosBox, soaBox;
+		runner.run("bounds/AoS/" + name, [&]() { aosBounds(aos, aosBox); bench::doNotOptimize(aosBox); }, vertices * sizeof(objl::Vertex), vertices, "vert");
+		runner.run("bounds/SoA/" + name, [&]() { computeBounds(soa, soaBox); bench::doNotOptimize(soaBox); }, vertices * 3 * sizeof(float), vertices, "vert");
+
+		runner.run("flatNormals/AoS/" + name, [&]() { aosNormals(aos, indices, false); }, 0.0, triangles, "tri");
+		// Flat normals split the shared vertices, on their own copy so the other
+		// kernels keep the loaded mesh. The warm up call does the split
+		MeshSoA flatSoa = soa;
+		runner.run("flatNormals/SoA/" + name, [&]() { computeNormals(flatSoa, false); }, 0.0, triangles, "tri");
+		runner.run("smoothNormals/AoS/" + name, [&]() { aosNormals(aos, indices, true); }, 0.0, triangles, "tri");
+		runner.run("smoothNormals/SoA/" + name, [&]() { computeNormals(soa, true); }, 0.0, triangles, "tri");
+
+		std::vector<objl::Vector3> tangents, bitangents;
+		std::vector<float> signs;
+		runner.run("tangents/AoS/" + name, [&]() { aosTangents(aos, indices, tangents, bitangents, signs); }, 0.0, triangles, "tri");
+		runner.run("tangents/SoA/" + name, [&]() { computeTangents(soa); }, 0.0, triangles, "tri");
+
+		runner.run("transform/AoS/" + name, [&]() { aosTransform(aos, rotation); }, 0.0, vertices, "vert");
+		runner.run("transform/SoA/" + name, [&]() { transformPositions(soa, rotation); transformNormals(soa, normalMatrix); }, 0.0, vertices, "vert");
+
+		runner.run("interleave/AoS/" + name, [&]()
+		{
+			std::vector<float> packed = loadVertices(loader);
+			bench::doNotOptimize(packed.size());
+		}, vertices * 9 * sizeof(float), vertices, "vert");
+		std::vector<float> packed;
+		runner.run("interleave/SoA/" + name, [&]()
+		{
+			interleaveVertices(soa, packed);
+			bench::doNotOptimize(packed.size());
+		}, vertices * 9 * sizeof(float), vertices, "vert");
+
+		// Both paths should agree, the transforms above were applied the same
+		// number of times only if both ran, so compare on fresh data
+		std::vector<objl::Vertex> check = loader.LoadedVertices;
+		MeshSoA checkSoa;
+		loadMeshSoA(loader, checkSoa);
+		aosBounds(check, aosBox);
+		computeBounds(checkSoa, soaBox);
+		aosNormals(check, indices, true);
+		computeNormals(checkSoa, true);
+		aosTangents(check, indices, tangents, bitangents, signs);
+		computeTangents(checkSoa);
+		float boxError = 0.0f, normalError = 0.0f, tangentError = 0.0f;
+		for (int k = 0; k < 3; k++)
+			boxError = std::max(boxError, std::max(fabsf(aosBox.min[k] - soaBox.min[k]), fabsf(aosBox.max[k] - soaBox.max[k])));
+		for (size_t i = 0; i < check.size(); i++)
+		{
+			normalError = std::max(normalError, objl::math::MagnitudeV3(check[i].Normal -
+				objl::Vector3(checkSoa.normalX[i], checkSoa.normalY[i], checkSoa.normalZ[i])));
+			tangentError = std::max(tangentError, objl::math::MagnitudeV3(tangents[i] -
+				objl::Vector3(checkSoa.tangentX[i], checkSoa.tangentY[i], checkSoa.tangentZ[i])));
+		}
+		std::cout << std::scientific << std::setprecision(2) << "    max difference AoS/SoA: bounds " << boxError << ", normals " << normalError
+			<< ", tangents " << tangentError << std::fixed << std::endl;
+	}
+
+	// Meshlets of the watchtower, welded first since the loader gives every corner
+	// its own vertex, and of spheres up to 4M triangles
+	{
+		objl::Loader loader;
+		if (loader.LoadFile("objects/watchtower.obj"))
+		{
+			MeshSoA mesh;
+			loadMeshSoA(loader, mesh);
+			weldVertices(mesh);
+			std::vector<float> vertices;
+			interleaveVertices(mesh, vertices);
+			benchMeshlets(runner, "watchtower.obj", &vertices[0], 9, mesh.vertexCount, mesh.indices, 20.0f);
+		}
+
+		const int sizes[] = { 256, 1024 };
+		for (int size : sizes)
+		{
+			std::vector<float> positions;
+			std::vector<unsigned int> indices;
+			makeSphere(size, size * 2, positions, indices);
+			benchMeshlets(runner, "sphere" + std::to_string(size), &positions[0], 3, positions.size() / 3, indices, 3.0f);
+		}
+	}
+
+	// Smooth normal and tangent generation on a million triangles without
+	// normals, on one thread and on all of them. The result has to be the
+	// same bits either way
+	{
+		std::string path = "bench_stress_grid_708_no_normals.obj";
+		writeStressObj(path, 708, false);
+		generated.push_back(path);
+
+		objl::Loader loader;
+		loader.LoadFile(path);
+		MeshSoA flat;
+		loadMeshSoA(loader, flat);
+		double triangles = flat.indices.size() / 3.0;
+
+		for (unsigned int threads : threadCounts)
+		{
+			NormalSettings settings;
+			settings.threads = threads;
+			MeshSoA smooth = flat;
+			runner.run("smoothNormals/" + std::to_string(threads) + "-thread/1M-tri", [&]()
+			{
+				generateSmoothNormals(smooth, settings);
+			}, 0.0, triangles, "tri");
+		}
+
+		// Smoothed once per thread count from the same flat mesh, then welded
+		MeshSoA smooth;
+		if (runner.sameOnThreads("smoothNormals/1M-tri", "normals and tangents", threadCounts[1], [&](unsigned int threads)
+		{
+			NormalSettings settings;
+			settings.threads = threads;
+			smooth = flat;
+			generateSmoothNormals(smooth, settings);
+			const FloatStream* streams[] = { &smooth.normalX, &smooth.normalY, &smooth.normalZ,
+				&smooth.tangentX, &smooth.tangentY, &smooth.tangentZ, &smooth.tangentW };
+			std::vector<FloatStream> result;
+			for (const FloatStream* stream : streams)
+				result.push_back(*stream);
+			return result;
+		}) && runner.selected("smoothNormals/1M-tri"))
+		{
+			size_t before = smooth.vertexCount;
+			size_t after = weldVertices(smooth);
+			std::cout << "    loader normals generated: " << (loader.GeneratedNormals ? "yes" : "no")
+				<< ", welded " << before << " -> " << after << " vertices" << std::endl;
+		}
+	}
+
+	// Scene loading, 100k objects as text and baked to the binary form
+	{
+		const int count = 100000;
+		std::string textPath = "bench_stress_scene.scene";
+		std::string binaryPath = "bench_stress_scene.sceneb";
+		writeStressScene(textPath, count);
+		generated.push_back(textPath);
+
+		Scene source;
+		source.loadText(textPath);
+		source.saveBinary(binaryPath);
+		generated.push_back(binaryPath);
+
+		Scene baked;
+		baked.loadBinary(binaryPath);
+		bool same = baked.objects.size() == source.objects.size() && baked.animations.size() == source.animations.size();
+		for (size_t i = 0; same && i < baked.objects.size(); i++)
+			same = baked.objects[i].mesh == source.objects[i].mesh && baked.world(baked.objects[i]) == source.world(source.objects[i]);
+		std::cout << "    " << source.animations.size() << " animated nodes moving " << source.animate(1.5)
+			<< " of " << source.transforms.size() << " nodes" << std::endl;
+		runner.check("sceneBinary/100k", "binary matches text", same);
+
+		runner.run("sceneText/100k", [&]()
+		{
+			Scene scene;
+			scene.loadText(textPath);
+			bench::doNotOptimize(scene.objects.size());
+		}, (double)fileSize(textPath), (double)count, "obj");
+
+		runner.run("sceneBinary/100k", [&]()
+		{
+			Scene scene;
+			scene.loadBinary(binaryPath);
+			bench::doNotOptimize(scene.objects.size());
+		}, (double)fileSize(binaryPath), (double)count, "obj");
+
+		// Only the subtrees of the animated nodes are rebuilt, against rebuilding every node
+		size_t moved = source.animate(1.5);
+		for (unsigned int threads : threadCounts)
+		{
+			runner.run("sceneAnimate/" + std::to_string(threads) + "-thread/100k", [&]()
+			{
+				bench::doNotOptimize(source.animate(1.5, threads));
+			}, 0.0, (double)moved, "node");
+		}
+
+		runner.run("transformRebuildAll/100k", [&]()
+		{
+			for (size_t i = 0; i < source.transforms.size(); i++)
+				if (source.transforms.parent((unsigned int)i) < 0)
+					source.transforms.setLocal((unsigned int)i, source.transforms.local((unsigned int)i));
+			bench::doNotOptimize(source.transforms.update(1));
+		}, 0.0, (double)source.transforms.size(), "node");
+	}
+
+	// Light clustering from the start of the default camera orbit, the same lanterns --lights places
+	{
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 3.0f, 3.0f), glm::vec3(0.0f, 3.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(45.0f, 1.0f, 0.1f, 100.0f);
+		unsigned int counts[] = { 1, 100, 1000 };
+		for (unsigned int count : counts)
+		{
+			std::vector<PointLight> lights;
+			scatterLights(lights, count, 1, glm::vec3(-40.0f, 0.5f, -60.0f), glm::vec3(40.0f, 8.0f, 20.0f));
+
+			LightClusters clusters;
+			clusters.setProjection(projection, 0.1f, 100.0f);
+			for (unsigned int threads : threadCounts)
+			{
+				runner.run("lightClusters/" + std::to_string(threads) + "-thread/" + std::to_string(count), [&]()
+				{
+					clusters.build(lights, view, threads);
+					bench::doNotOptimize(clusters.indices.size());
+				}, 0.0, (double)count, "light");
+			}
+
+			std::string name = "lightClusters/" + std::to_string(count);
+			if (runner.sameOnThreads(name, "clusters", threadCounts[1], [&](unsigned int threads)
+			{
+				clusters.build(lights, view, threads);
+				return std::make_pair(clusters.ranges, clusters.indices);
+			}) && runner.selected(name))
+			{
+				std::cout << "    " << clusters.indices.size() << " light references, at most " << clusters.maxLights
+					<< " lights in a cluster" << std::endl;
+			}
+		}
+	}
+
+	// The watchtower drawn on the CPU from the start of the default camera orbit
+	{
+		objl::Loader loader;
+		SoftMesh tower;
+		SoftTexture texture;
+		if (loader.LoadFile("objects/watchtower.obj") && loadSoftTexture("textures/watchtower.dds", texture))
+		{
+			tower.vertices = loadVertices(loader);
+			tower.indices = loadIndices(std::move(loader));
+			SoftMaterial material;
+			material.diffuse = &texture;
+			material.specularColor = glm::vec3(0.5f);
+
+			glm::vec3 eye(0.0f, 3.0f, 3.0f);
+			glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 3.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::mat4 projection = glm::perspective(45.0f, 1.0f, 0.1f, 100.0f);
+			SoftRasterizer rasterizer;
+			rasterizer.resize(640, 640);
+			rasterizer.setCamera(view, projection, eye);
+			rasterizer.setLight(glm::vec3(15.0f, 15.0f, 15.0f), glm::vec3(1.0f));
+			for (unsigned int threads : threadCounts)
+			{
+				runner.run("softRaster/" + std::to_string(threads) + "-thread/watchtower", [&]()
+				{
+					rasterizer.draw(tower, glm::mat4(1.0f), material);
+					rasterizer.render(threads);
+				}, 0.0, 640.0 * 640.0, "pixel");
+			}
+
+			if (runner.sameOnThreads("softRaster/watchtower", "image", threadCounts[1], [&](unsigned int threads)
+			{
+				rasterizer.draw(tower, glm::mat4(1.0f), material);
+				rasterizer.render(threads);
+				return rasterizer.pixels();
+			}) && runner.selected("softRaster/watchtower"))
+			{
+				std::cout << "    " << rasterizer.triangles() << " triangles" << std::endl;
+			}
+		}
+	}
+
+	// Flocks stepped at 60 Hz from the same spawn, then culled to the default camera
+	{
+		glm::mat4 viewProjection = glm::perspective(45.0f, 1.0f, 0.1f, 100.0f)
+			* glm::lookAt(glm::vec3(0.0f, 3.0f, 3.0f), glm::vec3(0.0f, 3.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		unsigned int counts[] = { 10000, 100000 };
+		for (unsigned int count : counts)
+		{
+			std::string size = std::to_string(count / 1000) + "k";
+			Flock flock;
+			std::vector<glm::mat4> transforms;
+			for (unsigned int threads : threadCounts)
+			{
+				flock.spawn(count, 1);
+				runner.run("flock/" + std::to_string(threads) + "-thread/" + size, [&]()
+				{
+					flock.step(1.0f / 60.0f, threads);
+				}, 0.0, (double)count, "boid");
+				runner.run("flockTransforms/" + std::to_string(threads) + "-thread/" + size, [&]()
+				{
+					flock.writeTransforms(viewProjection, glm::mat4(1.0f), 0.1f, 4.0f, transforms, threads);
+				}, 0.0, (double)count, "boid");
+			}
+
+			runner.sameOnThreads("flock/" + size, "flock after 10 steps", threadCounts[1], [&](unsigned int threads)
+			{
+				flock.spawn(count, 1);
+				for (int s = 0; s < 10; s++)
+					flock.step(1.0f / 60.0f, threads);
+				std::vector<std::vector<float> > state = { flock.positionX, flock.positionY, flock.positionZ,
+					flock.velocityX, flock.velocityY, flock.velocityZ };
+				return state;
+			});
+		}
+	}
+
+	// The default kilometre of terrain generated, then its chunks picked for the
+	// default camera as every frame does
+	{
+		Terrain terrain;
+		for (unsigned int threads : threadCounts)
+		{
+			runner.run("terrainGenerate/" + std::to_string(threads) + "-thread/1km", [&]()
+			{
+				terrain.generate(TerrainSettings(), threads);
+			}, 0.0, (double)TerrainSettings().size * TerrainSettings().size, "m2");
+		}
+		runner.sameOnThreads("terrainGenerate/1km", "terrain", threadCounts[1], [&](unsigned int threads)
+		{
+			terrain.generate(TerrainSettings(), threads);
+			return terrain.vertices();
+		});
+
+		glm::mat4 viewProjection = glm::perspective(45.0f, 1.0f, 0.1f, 100.0f)
+			* glm::lookAt(glm::vec3(0.0f, 3.0f, 3.0f), glm::vec3(0.0f, 3.0f, 2.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		MeshletDrawList chunks;
+		if (runner.selected("terrainSelect/1km"))
+		{
+			if (terrain.chunkCount() == 0)
+				terrain.generate(TerrainSettings());
+			runner.run("terrainSelect/1km", [&]()
+			{
+				terrain.select(glm::mat4(1.0f), viewProjection, glm::vec3(0.0f, 3.0f, 3.0f), chunks);
+				bench::doNotOptimize(chunks.visibleTriangles);
+			}, 0.0, (double)terrain.chunkCount(), "chunk");
+			std::cout << "    " << terrain.chunkCount() << " chunks of " << terrain.vertices().size() / 9 / terrain.chunkCount()
+				<< " vertices, " << chunks.visibleMeshlets << " and " << chunks.visibleTriangles << " triangles drawn, "
+				<< chunks.frustumCulled << " culled" << std::endl;
+		}
+	}
+
+	// DDS reading (the GPU upload in loadDDS needs a context and is measured by --bench)
+	for (size_t i = 0; i < ddsPaths.size(); i++)
+	{
+		const std::string& path = ddsPaths[i];
+		DDSImage probe;
+		readDDS(path.c_str(), probe);
+		double texels = (double)probe.width * probe.height;
+
+		runner.run("readDDS/" + path.substr(path.find_last_of('/') + 1), [&]()
+		{
+			DDSImage image;
+			readDDS(path.c_str(), image);
+			bench::doNotOptimize(image.data.size());
+		}, (double)fileSize(path), texels, "texel");
+	}
+
+	// Cold start: every file the default scene loads, read loose and through a pack
+	// with and without compression, after dropping them from the page cache. The
+	// difference shows on spinning disks and network filesystems, where each
+	// loose file costs seeks or round trips
+	{
+		const char* shaderFiles[] = { "vert.glsl", "frag.glsl", "simple_frag.glsl", "depth_vert.glsl", "depth_frag.glsl", "overdraw_frag.glsl" };
+		std::vector<std::string> files(1, "scenes/default.scene");
+		files.insert(files.end(), objects, objects + 3);
+		files.insert(files.end(), textures, textures + 4);
+		files.insert(files.end(), shaderFiles, shaderFiles + 6);
+		double bytes = 0.0;
+		for (size_t i = 0; i < files.size(); i++)
+			bytes += (double)fileSize(files[i]);
+
+		auto loadAll = [&]()
+		{
+			Scene scene;
+			scene.load(files[0]);
+			for (size_t i = 1; i < files.size(); i++)
+			{
+				const std::string& path = files[i];
+				if (path.compare(0, 8, "objects/") == 0)
+				{
+					objl::Loader loader;
+					loadObject(loader, path);
+					bench::doNotOptimize(loader.LoadedIndices.size());
+				}
+				else if (path.compare(0, 9, "textures/") == 0)
+				{
+					DDSImage image;
+					readDDS(path.c_str(), image);
+					bench::doNotOptimize(image.data.size());
+				}
+				else
+				{
+					pack::Asset source;
+					pack::read(path, source);
+					bench::doNotOptimize(source.size);
+				}
+			}
+		};
+
+		runner.run("coldStart/loose", [&]()
+		{
+			for (size_t i = 0; i < files.size(); i++)
+				evictFromCache(files[i]);
+			loadAll();
+		}, bytes);
+
+		const char* packNames[] = { "bench_assets.pack", "bench_assets_lz4.pack" };
+		for (int compressed = 0; compressed < 2; compressed++)
+		{
+			std::string packPath = packNames[compressed];
+			if (!pack::write(packPath, files, compressed != 0))
+				continue;
+			generated.push_back(packPath);
+
+			runner.run(std::string("coldStart/") + (compressed ? "packLZ4 (" : "pack (")
+				+ std::to_string(fileSize(packPath) / 1024) + " KiB)", [&]()
+			{
+				evictFromCache(packPath);
+				pack::open(packPath);
+				loadAll();
+				pack::close();
+			}, bytes);
+		}
+	}
+
+	for (size_t i = 0; i < generated.size(); i++)
+		remove(generated[i].c_str());
+
+	return runner.finish();
+}
@@ -0,0 +1,272 @@
+// Minimal self-contained benchmark harness
+//
+// Include from exactly one source file per benchmark program, it replaces the
+// global operator new / delete to count allocations.
+
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fstream>
+#include <sys/resource.h>
+#endif
+
+namespace bench
+{
+	std::atomic<unsigned long long> allocationCount(0);
+	std::atomic<unsigned long long> allocationBytes(0);
+
+	// Keep a value alive so the optimiser cannot remove the work that made it. The
+	// barrier makes the compiler assume the value is read; elsewhere its address
+	// escapes through a volatile store
+	template <class T>
+	inline void doNotOptimize(const T& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static const void* volatile sink;
+		sink = &value;
+#endif
+	}
+
+	// Reset the peak resident set size so the next reading belongs to one benchmark
+	inline void resetPeakRss()
+	{
+#ifdef __linux__
+		std::ofstream clearRefs("/proc/self/clear_refs");
+		if (clearRefs.is_open())
+			clearRefs << "5";
+#endif
+	}
+
+	// Peak resident set size in KiB (since the last reset where supported)
+	inline size_t peakRssKb()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return counters.PeakWorkingSetSize / 1024;
+		return 0;
+#else
+#ifdef __linux__
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmHWM:") == 0)
+				return (size_t)std::strtoull(line.c_str() + 6, NULL, 10);
+		}
+#endif
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return (size_t)usage.ru_maxrss;
+#endif
+	}
+
+	struct Result
+	{
+		std::string name;
+		int iterations;
+		double minMs;
+		double medianMs;
+		double bytesPerIteration;
+		double itemsPerIteration;
+		std::string itemUnit;
+		size_t peakRssKb;
+		double allocationsPerIteration;
+		double allocatedBytesPerIteration;
+	};
+
+	class Runner
+	{
+	public:
+		Runner(int argc, char** argv)
+			: minSeconds(0.5)
+		{
+			for (int i = 1; i < argc; i++)
+			{
+				std::string arg = argv[i];
+				if (arg == "--min-time" && i + 1 < argc)
+					minSeconds = std::atof(argv[++i]);
+				else
+					filters.push_back(arg);
+			}
+		}
+
+		// Time fn until minSeconds have passed (at least 3 runs). bytes and items
+		// are the amount of work done by one call, used for the throughput columns
+		template <class F>
+		void run(const std::string& name, F fn, double bytes = 0.0, double items = 0.0, const std::string& itemUnit = "items")
+		{
+			if (!selected(name))
+				return;
+
+			typedef std::chrono::high_resolution_clock Clock;
+
+			// Warm up caches and let lazy initialisation happen outside the timings
+			fn();
+
+			resetPeakRss();
+			unsigned long long allocationsBefore = allocationCount.load();
+			unsigned long long bytesBefore = allocationBytes.load();
+
+			std::vector<double> samples;
+			double total = 0.0;
+			while ((total < minSeconds || samples.size() < 3) && samples.size() < 100000)
+			{
+				Clock::time_point start = Clock::now();
+				fn();
+				double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+				samples.push_back(ms);
+				total += ms / 1000.0;
+			}
+
+			Result result;
+			result.name = name;
+			result.iterations = (int)samples.size();
+			result.allocationsPerIteration = double(allocationCount.load() - allocationsBefore) / samples.size();
+			result.allocatedBytesPerIteration = double(allocationBytes.load() - bytesBefore) / samples.size();
+			result.peakRssKb = peakRssKb();
+
+			std::sort(samples.begin(), samples.end());
+			result.minMs = samples.front();
+			result.medianMs = samples[samples.size() / 2];
+			result.bytesPerIteration = bytes;
+			result.itemsPerIteration = items;
+			result.itemUnit = itemUnit;
+
+			print(result);
+			results.push_back(result);
+		}
+
+		static void printHeader()
+		{
+			std::cout << std::left << std::setw(40) << "benchmark" << std::right
+				<< std::setw(8) << "iters" << std::setw(12) << "median ms" << std::setw(12) << "min ms"
+				<< std::setw(11) << "MB/s" << std::setw(22) << "throughput"
+				<< std::setw(12) << "allocs/it" << std::setw(13) << "alloc KB/it" << std::setw(12) << "peak RSS MB" << std::endl;
+		}
+
+		// Run body(threadCount) on one thread and on threads and compare what the two
+		// return, recording a failure when they differ. Both runs happen here, not in
+		// the timed loops, and only when the filters select name
+		template <class F>
+		bool sameOnThreads(const std::string& name, const std::string& what, unsigned int threads, F body)
+		{
+			if (!selected(name))
+				return true;
+			auto one = body(1u);
+			auto many = body(threads);
+			return check(name, "same " + what + " on 1 and " + std::to_string(threads) + " threads", one == many);
+		}
+
+		// Print the outcome of a check, a failed one makes finish() return non-zero
+		bool check(const std::string& name, const std::string& what, bool passed)
+		{
+			std::cout << "    " << what << ": " << (passed ? "yes" : "NO") << std::endl;
+			if (!passed)
+				failures.push_back(name + ": " + what);
+			return passed;
+		}
+
+		// List the failed checks, returns the exit code for main
+		int finish() const
+		{
+			if (failures.empty())
+				return 0;
+			std::cout << failures.size() << " check(s) failed:" << std::endl;
+			for (size_t i = 0; i < failures.size(); i++)
+				std::cout << "    " << failures[i] << std::endl;
+			return 1;
+		}
+
+		bool selected(const std::string& name) const
+		{
+			if (filters.empty())
+				return true;
+			for (size_t i = 0; i < filters.size(); i++)
+				if (name.find(filters[i]) != std::string::npos)
+					return true;
+			return false;
+		}
+
+		std::vector<Result> results;
+
+	private:
+
+		static void print(const Result& r)
+		{
+			double seconds = r.medianMs / 1000.0;
+			std::cout << std::left << std::setw(40) << r.name << std::right << std::fixed
+				<< std::setw(8) << r.iterations
+				<< std::setprecision(3) << std::setw(12) << r.medianMs << std::setw(12) << r.minMs
+				<< std::setprecision(1) << std::setw(11);
+			if (r.bytesPerIteration > 0.0)
+				std::cout << r.bytesPerIteration / seconds / (1024.0 * 1024.0);
+			else
+				std::cout << "-";
+
+			if (r.itemsPerIteration > 0.0)
+			{
+				char buffer[64];
+				snprintf(buffer, sizeof(buffer), "%.2f M%s/s", r.itemsPerIteration / seconds / 1e6, r.itemUnit.c_str());
+				std::cout << std::setw(22) << buffer;
+			}
+			else
+			{
+				std::cout << std::setw(22) << "-";
+			}
+
+			std::cout << std::setprecision(1) << std::setw(12) << r.allocationsPerIteration
+				<< std::setw(13) << r.allocatedBytesPerIteration / 1024.0
+				<< std::setw(12) << r.peakRssKb / 1024.0 << std::endl;
+		}
+
+		double minSeconds;
+		std::vector<std::string> filters;
+		std::vector<std::string> failures;
+	};
+}
+
+// Counting allocator hooks, every other operator new / delete form forwards here
+void* operator new(size_t size)
+{
+	bench::allocationCount.fetch_add(1, std::memory_order_relaxed);
+	bench::allocationBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+// Kept out of line: inlined into a delete expression, the free would be
+// reported as mismatched with the new that made the pointer
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+#endif
@@ -18,8 +18,17 @@
 // Math.h - STD math Library
 #include <math.h>
 
-// Print progress to console while loading (large models)
+// Stdlib.h - strtof / strtol for allocation free number parsing
+#include <stdlib.h>
+
+// Unordered_map - STD Hash Map Library, material lookup by name
+#include <unordered_map>
+
+// Print progress to console while loading (large models),
+// define OBJL_NO_CONSOLE_OUTPUT before including to silence it
+#ifndef OBJL_NO_CONSOLE_OUTPUT
 #define OBJL_CONSOLE_OUTPUT
+#endif
 
 // Namespace: OBJL
 //
@@ -191,26 +200,31 @@ namespace objl
 	// Structure: Mesh
 	//
 	// Description: A Simple Mesh Object that holds
-	//	a name, a vertex list, and an index list
+	//	a name and the range of the loader's vertex and
+	//	index lists that belong to it. The indices in that
+	//	range point into the whole vertex list, subtract
+	//	VertexStart to get an index local to the mesh
 	struct Mesh
 	{
 		// Default Constructor
 		Mesh()
+			: VertexStart(0), VertexCount(0), IndexStart(0), IndexCount(0)
 		{
 
 		}
 		// Variable Set Constructor
-		Mesh(std::vector<Vertex>& _Vertices, std::vector<unsigned int>& _Indices)
+		Mesh(unsigned int _VertexStart, unsigned int _VertexCount, unsigned int _IndexStart, unsigned int _IndexCount)
+			: VertexStart(_VertexStart), VertexCount(_VertexCount), IndexStart(_IndexStart), IndexCount(_IndexCount)
 		{
-			Vertices = _Vertices;
-			Indices = _Indices;
 		}
 		// Mesh Name
 		std::string MeshName;
-		// Vertex List
-		std::vector<Vertex> Vertices;
-		// Index List
-		std::vector<unsigned int> Indices;
+		// Vertex Range in Loader::LoadedVertices
+		unsigned int VertexStart;
+		unsigned int VertexCount;
+		// Index Range in Loader::LoadedIndices
+		unsigned int IndexStart;
+		unsigned int IndexCount;
 
 		// Material
 		Material MeshMaterial;
@@ -223,7 +237,7 @@ namespace objl
 	namespace math
 	{
 		// Vector3 Cross Product
-		Vector3 CrossV3(const Vector3 a, const Vector3 b)
+		inline Vector3 CrossV3(const Vector3 a, const Vector3 b)
 		{
 			return Vector3(a.Y * b.Z - a.Z * b.Y,
 				a.Z * b.X - a.X * b.Z,
@@ -231,19 +245,19 @@ namespace objl
 		}
 
 		// Vector3 Magnitude Calculation
-		float MagnitudeV3(const Vector3 in)
+		inline float MagnitudeV3(const Vector3 in)
 		{
 			return (sqrtf(powf(in.X, 2) + powf(in.Y, 2) + powf(in.Z, 2)));
 		}
 
 		// Vector3 DotProduct
-		float DotV3(const Vector3 a, const Vector3 b)
+		inline float DotV3(const Vector3 a, const Vector3 b)
 		{
 			return (a.X * b.X) + (a.Y * b.Y) + (a.Z * b.Z);
 		}
 
 		// Angle between 2 Vector3 Objects
-		float AngleBetweenV3(const Vector3 a, const Vector3 b)
+		inline float AngleBetweenV3(const Vector3 a, const Vector3 b)
 		{
 			float angle = DotV3(a, b);
 			angle /= (MagnitudeV3(a) * MagnitudeV3(b));
@@ -251,7 +265,7 @@ namespace objl
 		}
 
 		// Projection Calculation of a onto b
-		Vector3 ProjV3(const Vector3 a, const Vector3 b)
+		inline Vector3 ProjV3(const Vector3 a, const Vector3 b)
 		{
 			Vector3 bn = b / MagnitudeV3(b);
 			return bn * DotV3(a, bn);
@@ -265,13 +279,13 @@ namespace objl
 	namespace algorithm
 	{
 		// Vector3 Multiplication Opertor Overload
-		Vector3 operator*(const float& left, const Vector3& right)
+		inline Vector3 operator*(const float& left, const Vector3& right)
 		{
 			return Vector3(right.X * left, right.Y * left, right.Z * left);
 		}
 
 		// A test to see if P1 is on the same side as P2 of a line segment ab
-		bool SameSide(Vector3 p1, Vector3 p2, Vector3 a, Vector3 b)
+		inline bool SameSide(Vector3 p1, Vector3 p2, Vector3 a, Vector3 b)
 		{
 			Vector3 cp1 = math::CrossV3(b - a, p1 - a);
 			Vector3 cp2 = math::CrossV3(b - a, p2 - a);
@@ -283,7 +297,7 @@ namespace objl
 		}
 
 		// Generate a cross produect normal for a triangle
-		Vector3 GenTriNormal(Vector3 t1, Vector3 t2, Vector3 t3)
+		inline Vector3 GenTriNormal(Vector3 t1, Vector3 t2, Vector3 t3)
 		{
 			Vector3 u = t2 - t1;
 			Vector3 v = t3 - t1;
@@ -294,7 +308,7 @@ namespace objl
 		}
 
 		// Check to see if a Vector3 Point is within a 3 Vector3 Triangle
-		bool inTriangle(Vector3 point, Vector3 tri1, Vector3 tri2, Vector3 tri3)
+		inline bool inTriangle(Vector3 point, Vector3 tri1, Vector3 tri2, Vector3 tri3)
 		{
 			// Test to see if it is within an infinite prism that the triangle outlines.
 			bool within_tri_prisim = SameSide(point, tri1, tri2, tri3) && SameSide(point, tri2, tri1, tri3)
@@ -405,8 +419,188 @@ namespace objl
 				idx--;
 			return elements[idx];
 		}
+
+		// Get element at a parsed OBJ index (1 based, negative counts from the end),
+		// returns the fallback when the index is missing or out of range
+		template <class T, class Alloc>
+		inline T getElement(const std::vector<T, Alloc>& elements, int index, const T& fallback)
+		{
+			int idx = index < 0 ? int(elements.size()) + index : index - 1;
+			if (index == 0 || idx < 0 || idx >= int(elements.size()))
+				return fallback;
+			return elements[idx];
+		}
+
+		// Find the text following the first token of a line without copying it
+		inline const char* tailPointer(const std::string& in)
+		{
+			const char* p = in.c_str();
+			while (*p == ' ' || *p == '\t') p++;
+			while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+			while (*p == ' ' || *p == '\t') p++;
+			return p;
+		}
+
+		// Parse up to count whitespace separated floats, returns how many were read
+		inline int parseFloats(const char* in, float* out, int count)
+		{
+			int parsed = 0;
+			while (parsed < count)
+			{
+				char* end;
+				float value = strtof(in, &end);
+				if (end == in)
+					break;
+				out[parsed++] = value;
+				in = end;
+			}
+			return parsed;
+		}
+
+		// Parse the next "v", "v/vt", "v//vn" or "v/vt/vn" corner of a face line,
+		// advancing in past it. Missing fields are set to 0, which OBJ never uses
+		// as an index. Returns false once the line is exhausted
+		inline bool parseFaceCorner(const char*& in, int fields[3])
+		{
+			while (*in == ' ' || *in == '\t')
+				in++;
+			if (*in == '\0')
+				return false;
+
+			fields[0] = fields[1] = fields[2] = 0;
+			int field = 0;
+			while (*in != '\0' && *in != ' ' && *in != '\t')
+			{
+				if (*in == '/')
+				{
+					field++;
+					in++;
+					continue;
+				}
+
+				char* end;
+				long value = strtol(in, &end, 10);
+				if (end == in)
+				{
+					in++;
+					continue;
+				}
+				if (field < 3)
+					fields[field] = int(value);
+				in = end;
+			}
+			return true;
+		}
 	}
 
+	// Class: LoaderArena
+	//
+	// Description: A monotonic block allocator for temporaries that
+	//	only live for one load. Memory is handed out linearly from
+	//	large blocks and all of it is given back at once by Release
+	class LoaderArena
+	{
+	public:
+		// Called with the size of every block the arena allocates,
+		// lets tools count loader allocations
+		typedef void (*AllocationHookFn)(size_t bytes);
+		static AllocationHookFn& AllocationHook()
+		{
+			static AllocationHookFn hook = nullptr;
+			return hook;
+		}
+
+		explicit LoaderArena(size_t blockSize = 64 * 1024)
+			: BlockSize(blockSize), Offset(0), CurrentSize(0), BlockAllocations(0), BytesAllocated(0)
+		{
+		}
+		~LoaderArena()
+		{
+			Release();
+		}
+
+		// Blocks are owned, so the arena can not be copied
+		LoaderArena(const LoaderArena&) = delete;
+		LoaderArena& operator=(const LoaderArena&) = delete;
+
+		void* Allocate(size_t bytes, size_t alignment)
+		{
+			size_t offset = (Offset + alignment - 1) & ~(alignment - 1);
+			if (Blocks.empty() || offset + bytes > CurrentSize)
+			{
+				CurrentSize = bytes > BlockSize ? bytes : BlockSize;
+				Blocks.push_back(static_cast<char*>(::operator new(CurrentSize)));
+				BlockAllocations++;
+				BytesAllocated += CurrentSize;
+				if (AllocationHook())
+					AllocationHook()(CurrentSize);
+				offset = 0;
+			}
+			Offset = offset + bytes;
+			return Blocks.back() + offset;
+		}
+
+		// Free every block, anything allocated from the arena is invalid afterwards
+		void Release()
+		{
+			for (size_t i = 0; i < Blocks.size(); i++)
+				::operator delete(Blocks[i]);
+			Blocks.clear();
+			Offset = 0;
+			CurrentSize = 0;
+		}
+
+		size_t BlockSize;
+		size_t Offset;
+		size_t CurrentSize;
+		std::vector<char*> Blocks;
+
+		// Totals since construction
+		size_t BlockAllocations;
+		size_t BytesAllocated;
+	};
+
+	// Structure: ArenaAllocator
+	//
+	// Description: Standard allocator adaptor so containers can
+	//	draw from a LoaderArena, deallocation is a no-op
+	template <class T>
+	struct ArenaAllocator
+	{
+		typedef T value_type;
+
+		explicit ArenaAllocator(LoaderArena* arena) : Arena(arena) {}
+		template <class U>
+		ArenaAllocator(const ArenaAllocator<U>& other) : Arena(other.Arena) {}
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(Arena->Allocate(n * sizeof(T), alignof(T)));
+		}
+		void deallocate(T*, size_t)
+		{
+		}
+
+		template <class U>
+		bool operator==(const ArenaAllocator<U>& other) const { return Arena == other.Arena; }
+		template <class U>
+		bool operator!=(const ArenaAllocator<U>& other) const { return Arena != other.Arena; }
+
+		LoaderArena* Arena;
+	};
+
+	// Read only stream buffer over memory it does not own, lets a file that is
+	// already in memory be parsed without copying it
+	class MemoryStreamBuffer : public std::streambuf
+	{
+	public:
+		MemoryStreamBuffer(const char* data, size_t size)
+		{
+			char* begin = const_cast<char*>(data);
+			setg(begin, begin, begin + size);
+		}
+	};
+
 	// Class: Loader
 	//
 	// Description: The OBJ Model Loader
@@ -432,7 +626,7 @@ namespace objl
 		bool LoadFile(std::string Path)
 		{
 			// If the file is not an .obj file return false
-			if (Path.substr(Path.size() - 4, 4) != ".obj")
+			if (Path.size() < 4 || Path.substr(Path.size() - 4, 4) != ".obj")
 				return false;
 
 
@@ -441,23 +635,67 @@ namespace objl
 			if (!file.is_open())
 				return false;
 
+			return LoadStream(file, Path);
+		}
+
+		// Load an .obj file that is already in memory, Path is only used
+		// to find material libraries next to it
+		//
+		// If the data is loaded return true
+		bool LoadFromMemory(const char* data, size_t size, const std::string& Path)
+		{
+			MemoryStreamBuffer buffer(data, size);
+			std::istream stream(&buffer);
+			return LoadStream(stream, Path);
+		}
+
+		// Parse .obj text from a stream
+		bool LoadStream(std::istream& file, const std::string& Path)
+		{
 			LoadedMeshes.clear();
 			LoadedVertices.clear();
 			LoadedIndices.clear();
+			GeneratedNormals = false;
+
+			// Every per line and per face temporary comes from this arena,
+			// the scratch containers are reused so once they have grown to the
+			// largest face no further allocations happen while parsing
+			LoaderArena arena;
+			ArenaAllocator<Vertex> vertexAlloc(&arena);
+			ArenaAllocator<unsigned int> indexAlloc(&arena);
 
 			std::vector<Vector3> Positions;
 			std::vector<Vector2> TCoords;
 			std::vector<Vector3> Normals;
 
-			std::vector<Vertex> Vertices;
-			std::vector<unsigned int> Indices;
+			// Where the mesh currently being read starts in the loaded lists,
+			// every vertex and index is stored exactly once
+			size_t meshVertexStart = 0;
+			size_t meshIndexStart = 0;
+			auto meshHasFaces = [&]()
+			{
+				return LoadedIndices.size() > meshIndexStart && LoadedVertices.size() > meshVertexStart;
+			};
+
+			std::vector<Vertex, ArenaAllocator<Vertex> > vVerts(vertexAlloc);
+			std::vector<Vertex, ArenaAllocator<Vertex> > tVerts(vertexAlloc);
+			std::vector<unsigned int, ArenaAllocator<unsigned int> > iIndices(indexAlloc);
 
 			std::vector<std::string> MeshMatNames;
 
 			bool listening = false;
 			std::string meshname;
 
-			Mesh tempMesh;
+			// Close the current range of vertices and indices as a new mesh
+			auto emitMesh = [&](const std::string& name)
+			{
+				LoadedMeshes.push_back(Mesh((unsigned int)meshVertexStart, (unsigned int)(LoadedVertices.size() - meshVertexStart),
+					(unsigned int)meshIndexStart, (unsigned int)(LoadedIndices.size() - meshIndexStart)));
+				LoadedMeshes.back().MeshName = name;
+
+				meshVertexStart = LoadedVertices.size();
+				meshIndexStart = LoadedIndices.size();
+			};
 
 #ifdef OBJL_CONSOLE_OUTPUT
 			const unsigned int outputEveryNth = 1000;
@@ -465,8 +703,13 @@ namespace objl
 #endif
 
 			std::string curline;
+			std::string token;
 			while (std::getline(file, curline))
 			{
+				// Files written on Windows keep their '\r' when read on other platforms
+				if (!curline.empty() && curline[curline.size() - 1] == '\r')
+					curline.erase(curline.size() - 1);
+
 #ifdef OBJL_CONSOLE_OUTPUT
 				if ((outputIndicator = ((outputIndicator + 1) % outputEveryNth)) == 1)
 				{
@@ -477,20 +720,23 @@ namespace objl
 							<< "\t| vertices > " << Positions.size()
 							<< "\t| texcoords > " << TCoords.size()
 							<< "\t| normals > " << Normals.size()
-							<< "\t| triangles > " << (Vertices.size() / 3)
+							<< "\t| triangles > " << ((LoadedVertices.size() - meshVertexStart) / 3)
 							<< (!MeshMatNames.empty() ? "\t| material: " + MeshMatNames.back() : "");
 					}
 				}
 #endif
 
+				// Tokens are short enough for the small string buffer, so this does not allocate
+				token = algorithm::firstToken(curline);
+
 				// Generate a Mesh Object or Prepare for an object to be created
-				if (algorithm::firstToken(curline) == "o" || algorithm::firstToken(curline) == "g" || curline[0] == 'g')
+				if (token == "o" || token == "g" || curline[0] == 'g')
 				{
 					if (!listening)
 					{
 						listening = true;
 
-						if (algorithm::firstToken(curline) == "o" || algorithm::firstToken(curline) == "g")
+						if (token == "o" || token == "g")
 						{
 							meshname = algorithm::tail(curline);
 						}
@@ -503,25 +749,15 @@ namespace objl
 					{
 						// Generate the mesh to put into the array
 
-						if (!Indices.empty() && !Vertices.empty())
+						if (meshHasFaces())
 						{
-							// Create Mesh
-							tempMesh = Mesh(Vertices, Indices);
-							tempMesh.MeshName = meshname;
-
-							// Insert Mesh
-							LoadedMeshes.push_back(tempMesh);
-
-							// Cleanup
-							Vertices.clear();
-							Indices.clear();
-							meshname.clear();
+							emitMesh(meshname);
 
 							meshname = algorithm::tail(curline);
 						}
 						else
 						{
-							if (algorithm::firstToken(curline) == "o" || algorithm::firstToken(curline) == "g")
+							if (token == "o" || token == "g")
 							{
 								meshname = algorithm::tail(curline);
 							}
@@ -537,100 +773,71 @@ namespace objl
 #endif
 				}
 				// Generate a Vertex Position
-				if (algorithm::firstToken(curline) == "v")
+				else if (token == "v")
 				{
-					std::vector<std::string> spos;
-					Vector3 vpos;
-					algorithm::split(algorithm::tail(curline), spos, " ");
+					float values[3] = { 0.0f, 0.0f, 0.0f };
+					algorithm::parseFloats(algorithm::tailPointer(curline), values, 3);
 
-					vpos.X = std::stof(spos[0]);
-					vpos.Y = std::stof(spos[1]);
-					vpos.Z = std::stof(spos[2]);
-
-					Positions.push_back(vpos);
+					Positions.push_back(Vector3(values[0], values[1], values[2]));
 				}
 				// Generate a Vertex Texture Coordinate
-				if (algorithm::firstToken(curline) == "vt")
+				else if (token == "vt")
 				{
-					std::vector<std::string> stex;
-					Vector2 vtex;
-					algorithm::split(algorithm::tail(curline), stex, " ");
-
-					vtex.X = std::stof(stex[0]);
-					vtex.Y = std::stof(stex[1]);
+					float values[2] = { 0.0f, 0.0f };
+					algorithm::parseFloats(algorithm::tailPointer(curline), values, 2);
 
-					TCoords.push_back(vtex);
+					TCoords.push_back(Vector2(values[0], values[1]));
 				}
 				// Generate a Vertex Normal;
-				if (algorithm::firstToken(curline) == "vn")
+				else if (token == "vn")
 				{
-					std::vector<std::string> snor;
-					Vector3 vnor;
-					algorithm::split(algorithm::tail(curline), snor, " ");
+					float values[3] = { 0.0f, 0.0f, 0.0f };
+					algorithm::parseFloats(algorithm::tailPointer(curline), values, 3);
 
-					vnor.X = std::stof(snor[0]);
-					vnor.Y = std::stof(snor[1]);
-					vnor.Z = std::stof(snor[2]);
-
-					Normals.push_back(vnor);
+					Normals.push_back(Vector3(values[0], values[1], values[2]));
 				}
 				// Generate a Face (vertices & indices)
-				if (algorithm::firstToken(curline) == "f")
+				else if (token == "f")
 				{
 					// Generate the vertices
-					std::vector<Vertex> vVerts;
-					GenVerticesFromRawOBJ(vVerts, Positions, TCoords, Normals, curline);
+					vVerts.clear();
+					GenVerticesFromRawOBJ(vVerts, Positions, TCoords, Normals, algorithm::tailPointer(curline));
 
 					// Add Vertices
-					for (int i = 0; i < int(vVerts.size()); i++)
-					{
-						Vertices.push_back(vVerts[i]);
+					unsigned int firstVertex = (unsigned int)LoadedVertices.size();
+					LoadedVertices.insert(LoadedVertices.end(), vVerts.begin(), vVerts.end());
 
-						LoadedVertices.push_back(vVerts[i]);
-					}
-
-					std::vector<unsigned int> iIndices;
-
-					VertexTriangluation(iIndices, vVerts);
+					iIndices.clear();
+					VertexTriangluation(iIndices, vVerts, tVerts);
 
 					// Add Indices
 					for (int i = 0; i < int(iIndices.size()); i++)
 					{
-						unsigned int indnum = (unsigned int)((Vertices.size()) - vVerts.size()) + iIndices[i];
-						Indices.push_back(indnum);
-
-						indnum = (unsigned int)((LoadedVertices.size()) - vVerts.size()) + iIndices[i];
-						LoadedIndices.push_back(indnum);
-
+						LoadedIndices.push_back(firstVertex + iIndices[i]);
 					}
 				}
 				// Get Mesh Material Name
-				if (algorithm::firstToken(curline) == "usemtl")
+				else if (token == "usemtl")
 				{
 					MeshMatNames.push_back(algorithm::tail(curline));
 
 					// Create new Mesh, if Material changes within a group
-					if (!Indices.empty() && !Vertices.empty())
+					if (meshHasFaces())
 					{
 						// Create Mesh
-						tempMesh = Mesh(Vertices, Indices);
-						tempMesh.MeshName = meshname;
+						std::string name = meshname;
 						int i = 2;
 						while (1) {
-							tempMesh.MeshName = meshname + "_" + std::to_string(i);
+							name = meshname + "_" + std::to_string(i);
 
 							for (auto& m : LoadedMeshes)
-								if (m.MeshName == tempMesh.MeshName)
+								if (m.MeshName == name)
 									continue;
 							break;
 						}
 
 						// Insert Mesh
-						LoadedMeshes.push_back(tempMesh);
-
-						// Cleanup
-						Vertices.clear();
-						Indices.clear();
+						emitMesh(name);
 					}
 
 #ifdef OBJL_CONSOLE_OUTPUT
@@ -638,7 +845,7 @@ namespace objl
 #endif
 				}
 				// Load Materials
-				if (algorithm::firstToken(curline) == "mtllib")
+				else if (token == "mtllib")
 				{
 					// Generate LoadedMaterial
 
@@ -650,7 +857,7 @@ namespace objl
 
 					if (temp.size() != 1)
 					{
-						for (int i = 0; i < temp.size() - 1; i++)
+						for (int i = 0; i < int(temp.size()) - 1; i++)
 						{
 							pathtomat += temp[i] + "/";
 						}
@@ -674,33 +881,32 @@ namespace objl
 
 			// Deal with last mesh
 
-			if (!Indices.empty() && !Vertices.empty())
+			if (meshHasFaces())
 			{
-				// Create Mesh
-				tempMesh = Mesh(Vertices, Indices);
-				tempMesh.MeshName = meshname;
-
-				// Insert Mesh
-				LoadedMeshes.push_back(tempMesh);
+				emitMesh(meshname);
 			}
 
-			file.close();
+			// The arena frees every parse temporary in one go when it goes out of scope
+			LastLoadArenaBlocks = arena.BlockAllocations;
+			LastLoadArenaBytes = arena.BytesAllocated;
 
-			// Set Materials for each Mesh
-			for (int i = 0; i < MeshMatNames.size(); i++)
+			// Set Materials for each Mesh, looked up by hashed name
+			std::unordered_map<std::string, int> materialIndex;
+			materialIndex.reserve(LoadedMaterials.size());
+			for (int j = 0; j < int(LoadedMaterials.size()); j++)
+				materialIndex.insert(std::make_pair(LoadedMaterials[j].name, j));
+
+			for (int i = 0; i < int(MeshMatNames.size()) && i < int(LoadedMeshes.size()); i++)
 			{
-				std::string matname = MeshMatNames[i];
+				const std::string& matname = MeshMatNames[i];
 
-				// Find corresponding material name in loaded materials
-				// when found copy material variables into mesh material
-				for (int j = 0; j < LoadedMaterials.size(); j++)
-				{
-					if (LoadedMaterials[j].name == matname)
-					{
-						LoadedMeshes[i].MeshMaterial = LoadedMaterials[j];
-						break;
-					}
-				}
+				// When found copy material variables into mesh material, otherwise
+				// keep the name so the caller can still resolve it elsewhere
+				std::unordered_map<std::string, int>::const_iterator found = materialIndex.find(matname);
+				if (found != materialIndex.end())
+					LoadedMeshes[i].MeshMaterial = LoadedMaterials[found->second];
+				else
+					LoadedMeshes[i].MeshMaterial.name = matname;
 			}
 
 			if (LoadedMeshes.empty() && LoadedVertices.empty() && LoadedIndices.empty())
@@ -713,119 +919,73 @@ namespace objl
 			}
 		}
 
+		// Blocks and bytes the parse arena needed during the last LoadFile
+		size_t LastLoadArenaBlocks = 0;
+		size_t LastLoadArenaBytes = 0;
+
+		// True if some faces had no normals and got a flat one from the loader
+		bool GeneratedNormals = false;
+
 		// Loaded Mesh Objects
 		std::vector<Mesh> LoadedMeshes;
-		// Loaded Vertex Objects
+		// Loaded Vertex Objects, the single store every mesh is a range of.
+		// Callers that keep the data can std::move it out instead of copying
 		std::vector<Vertex> LoadedVertices;
-		// Loaded Index Positions
+		// Loaded Index Positions, into LoadedVertices
 		std::vector<unsigned int> LoadedIndices;
 		// Loaded Material Objects
 		std::vector<Material> LoadedMaterials;
 
 	private:
 		// Generate vertices from a list of positions, 
-		//	tcoords, normals and a face line
-		void GenVerticesFromRawOBJ(std::vector<Vertex>& oVerts,
+		//	tcoords, normals and the corners of a face line
+		template <class VertexVector>
+		void GenVerticesFromRawOBJ(VertexVector& oVerts,
 			const std::vector<Vector3>& iPositions,
 			const std::vector<Vector2>& iTCoords,
 			const std::vector<Vector3>& iNormals,
-			std::string icurline)
+			const char* iface)
 		{
-			std::vector<std::string> sface, svert;
 			Vertex vVert;
-			algorithm::split(algorithm::tail(icurline), sface, " ");
+			int fields[3];
 
 			bool noNormal = false;
 
 			// For every given vertex do this
-			for (int i = 0; i < int(sface.size()); i++)
+			while (algorithm::parseFaceCorner(iface, fields))
 			{
-				// See What type the vertex is.
-				int vtype;
-
-				algorithm::split(sface[i], svert, "/");
-
-				// Check for just position - v1
-				if (svert.size() == 1)
+				// A corner always needs a position - v1
+				if (fields[0] == 0)
+					continue;
+
+				// Calculate and store the vertex, texture and normal are
+				// optional - v1/vt1, v1//vn1 or v1/vt1/vn1
+				vVert.Position = algorithm::getElement(iPositions, fields[0], Vector3());
+				vVert.TextureCoordinate = algorithm::getElement(iTCoords, fields[1], Vector2(0, 0));
+				if (fields[2] != 0)
 				{
-					// Only position
-					vtype = 1;
+					vVert.Normal = algorithm::getElement(iNormals, fields[2], Vector3());
 				}
-
-				// Check for position & texture - v1/vt1
-				if (svert.size() == 2)
-				{
-					// Position & Texture
-					vtype = 2;
-				}
-
-				// Check for Position, Texture and Normal - v1/vt1/vn1
-				// or if Position and Normal - v1//vn1
-				if (svert.size() == 3)
-				{
-					if (svert[1] != "")
-					{
-						// Position, Texture, and Normal
-						vtype = 4;
-					}
-					else
-					{
-						// Position & Normal
-						vtype = 3;
-					}
-				}
-
-				// Calculate and store the vertex
-				switch (vtype)
-				{
-				case 1: // P
+				else
 				{
-					vVert.Position = algorithm::getElement(iPositions, svert[0]);
-					vVert.TextureCoordinate = Vector2(0, 0);
 					noNormal = true;
-					oVerts.push_back(vVert);
-					break;
-				}
-				case 2: // P/T
-				{
-					vVert.Position = algorithm::getElement(iPositions, svert[0]);
-					vVert.TextureCoordinate = algorithm::getElement(iTCoords, svert[1]);
-					noNormal = true;
-					oVerts.push_back(vVert);
-					break;
-				}
-				case 3: // P//N
-				{
-					vVert.Position = algorithm::getElement(iPositions, svert[0]);
-					vVert.TextureCoordinate = Vector2(0, 0);
-					vVert.Normal = algorithm::getElement(iNormals, svert[2]);
-					oVerts.push_back(vVert);
-					break;
-				}
-				case 4: // P/T/N
-				{
-					vVert.Position = algorithm::getElement(iPositions, svert[0]);
-					vVert.TextureCoordinate = algorithm::getElement(iTCoords, svert[1]);
-					vVert.Normal = algorithm::getElement(iNormals, svert[2]);
-					oVerts.push_back(vVert);
-					break;
-				}
-				default:
-				{
-					break;
-				}
 				}
+				oVerts.push_back(vVert);
 			}
 
 			// take care of missing normals
-			// these may not be truly acurate but it is the 
-			// best they get for not compiling a mesh with normals	
-			if (noNormal)
+			// this gives a flat unit normal facing the counter clockwise
+			// side, run a smoothing pass over the indexed mesh afterwards
+			// for anything better (see GeneratedNormals)
+			if (noNormal && oVerts.size() >= 3)
 			{
-				Vector3 A = oVerts[0].Position - oVerts[1].Position;
-				Vector3 B = oVerts[2].Position - oVerts[1].Position;
+				Vector3 A = oVerts[1].Position - oVerts[0].Position;
+				Vector3 B = oVerts[2].Position - oVerts[0].Position;
 
 				Vector3 normal = math::CrossV3(A, B);
+				float length = math::MagnitudeV3(normal);
+				normal = length > 0.0f ? normal / length : Vector3();
+				GeneratedNormals = true;
 
 				for (int i = 0; i < int(oVerts.size()); i++)
 				{
@@ -834,10 +994,21 @@ namespace objl
 			}
 		}
 
+	public:
 		// Triangulate a list of vertices into a face by printing
 		//	inducies corresponding with triangles within it
 		void VertexTriangluation(std::vector<unsigned int>& oIndices,
 			const std::vector<Vertex>& iVerts)
+		{
+			std::vector<Vertex> tVerts;
+			VertexTriangluation(oIndices, iVerts, tVerts);
+		}
+
+		// Same as above, reusing tVerts as the working list so
+		//	repeated calls do not need to allocate
+		template <class IndexVector, class VertexVector, class ScratchVector>
+		void VertexTriangluation(IndexVector& oIndices,
+			const VertexVector& iVerts, ScratchVector& tVerts)
 		{
 			// If there are 2 or less verts,
 			// no triangle can be created,
@@ -856,7 +1027,7 @@ namespace objl
 			}
 
 			// Create a list of vertices
-			std::vector<Vertex> tVerts = iVerts;
+			tVerts.assign(iVerts.begin(), iVerts.end());
 
 			while (true)
 			{
@@ -1003,6 +1174,7 @@ namespace objl
 			}
 		}
 
+	private:
 		// Load Materials from .mtl file
 		bool LoadMaterials(std::string path)
 		{
@@ -1024,6 +1196,10 @@ namespace objl
 			std::string curline;
 			while (std::getline(file, curline))
 			{
+				// Files written on Windows keep their '\r' when read on other platforms
+				if (!curline.empty() && curline[curline.size() - 1] == '\r')
+					curline.erase(curline.size() - 1);
+
 				// new material and material name
 				if (algorithm::firstToken(curline) == "newmtl")
 				{
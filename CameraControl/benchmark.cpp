@@ -0,0 +1,253 @@
+// Deterministic camera paths and JSON reporting for the --bench mode
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <math.h>
+#include <sstream>
+#include <stdio.h>
+
+#include <glm/gtc/constants.hpp>
+
+#include "benchmark.h"
+
+bool CameraPath::load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		return false;
+
+	keys.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream stream(line);
+		CameraKey key;
+		if (stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+			keys.push_back(key);
+	}
+
+	std::sort(keys.begin(), keys.end(), [](const CameraKey& a, const CameraKey& b) { return a.time < b.time; });
+	return !keys.empty();
+}
+
+void CameraPath::makeDefault()
+{
+	keys.clear();
+
+	// Circle the watchtower twice at different heights, always looking at its platform
+	const int steps = 16;
+	const glm::vec3 target(0.0f, 5.0f, 0.0f);
+	for (int i = 0; i <= steps; i++)
+	{
+		float angle = glm::two_pi<float>() * i / (steps / 2);
+		float radius = (i % 2) ? 14.0f : 10.0f;
+
+		CameraKey key;
+		key.time = i * 1.0f;
+		key.position = glm::vec3(cosf(angle) * radius, 3.0f + 4.0f * (i % 4) / 3.0f, sinf(angle) * radius);
+
+		glm::vec3 front = glm::normalize(target - key.position);
+		// Keep the yaw continuous so interpolation never spins the wrong way
+		key.yaw = glm::degrees(angle) + 180.0f;
+		key.pitch = glm::degrees(asinf(front.y));
+		keys.push_back(key);
+	}
+}
+
+float CameraPath::duration() const
+{
+	return keys.empty() ? 0.0f : keys.back().time;
+}
+
+// Uniform Catmull-Rom between p1 and p2
+template <class T>
+static T catmullRom(const T& p0, const T& p1, const T& p2, const T& p3, float t)
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return (p1 * 2.0f + (p2 - p0) * t + (p0 * 2.0f - p1 * 5.0f + p2 * 4.0f - p3) * t2
+		+ (p1 * 3.0f - p0 - p2 * 3.0f + p3) * t3) * 0.5f;
+}
+
+void CameraPath::evaluate(double time, glm::vec3& position, float& yaw, float& pitch) const
+{
+	if (keys.empty())
+		return;
+	if (keys.size() == 1 || duration() <= 0.0f)
+	{
+		position = keys[0].position;
+		yaw = keys[0].yaw;
+		pitch = keys[0].pitch;
+		return;
+	}
+
+	float t = (float)fmod(time, (double)duration());
+
+	size_t i = 0;
+	while (i + 2 < keys.size() && keys[i + 1].time <= t)
+		i++;
+
+	const CameraKey& k0 = keys[i > 0 ? i - 1 : i];
+	const CameraKey& k1 = keys[i];
+	const CameraKey& k2 = keys[i + 1];
+	const CameraKey& k3 = keys[std::min(i + 2, keys.size() - 1)];
+
+	float span = k2.time - k1.time;
+	float u = span > 0.0f ? (t - k1.time) / span : 0.0f;
+
+	position = catmullRom(k0.position, k1.position, k2.position, k3.position, u);
+	yaw = catmullRom(k0.yaw, k1.yaw, k2.yaw, k3.yaw, u);
+	pitch = glm::clamp(catmullRom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, u), -89.0f, 89.0f);
+}
+
+// A JSON string literal, quotes, backslashes and control characters escaped
+static std::string jsonString(const std::string& text)
+{
+	std::string out = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+			out += escaped;
+		}
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+double percentile(std::vector<double> samples, double p)
+{
+	if (samples.empty())
+		return 0.0;
+
+	std::sort(samples.begin(), samples.end());
+	size_t rank = (size_t)ceil(p / 100.0 * samples.size());
+	if (rank > 0)
+		rank--;
+	return samples[std::min(rank, samples.size() - 1)];
+}
+
+bool BenchReport::write(const std::string& path) const
+{
+	double total = 0.0;
+	for (size_t i = 0; i < frameMs.size(); i++)
+		total += frameMs[i];
+	double mean = frameMs.empty() ? 0.0 : total / frameMs.size();
+
+	double loadTotal = 0.0;
+	for (size_t i = 0; i < loadMs.size(); i++)
+		loadTotal += loadMs[i].second;
+
+	std::ostringstream json;
+	json << std::fixed << std::setprecision(4);
+	json << "{\n";
+	json << "  \"renderer\": " << jsonString(renderer) << ",\n";
+	json << "  \"width\": " << width << ",\n";
+	json << "  \"height\": " << height << ",\n";
+	json << "  \"warmup_frames\": " << warmupFrames << ",\n";
+	json << "  \"pipeline_depth\": " << pipelineDepth << ",\n";
+	json << "  \"job_threads\": " << jobThreads << ",\n";
+	json << "  \"frames\": " << frameMs.size() << ",\n";
+	json << "  \"frame_ms\": {\n";
+	json << "    \"mean\": " << mean << ",\n";
+	json << "    \"p50\": " << percentile(frameMs, 50.0) << ",\n";
+	json << "    \"p95\": " << percentile(frameMs, 95.0) << ",\n";
+	json << "    \"p99\": " << percentile(frameMs, 99.0) << ",\n";
+	json << "    \"max\": " << percentile(frameMs, 100.0) << "\n";
+	json << "  },\n";
+	json << "  \"triangles_per_frame\": " << (frameMs.empty() ? 0 : triangles / frameMs.size()) << ",\n";
+	json << "  \"triangles_per_sec\": " << (total > 0.0 ? triangles / (total / 1000.0) : 0.0) << ",\n";
+	size_t frames = frameMs.empty() ? 1 : frameMs.size();
+	json << "  \"state_changes_per_frame\": {\n";
+	json << "    \"issued\": " << (double)stateChanges / frames << ",\n";
+	json << "    \"redundant_skipped\": " << (double)redundantStateChanges / frames << ",\n";
+	json << "    \"unsorted\": " << (double)unsortedStateChanges / frames << "\n";
+	json << "  },\n";
+	json << "  \"transforms_updated_per_frame\": " << (double)transformUpdates / frames << ",\n";
+	json << "  \"flock\": {\n";
+	json << "    \"boids\": " << flockBoids << ",\n";
+	json << "    \"sim_ms_per_frame\": " << flockMs / frames << ",\n";
+	json << "    \"drawn_per_frame\": " << (double)flockInstances / frames << "\n";
+	json << "  },\n";
+	json << "  \"terrain\": {\n";
+	json << "    \"chunks\": " << terrainChunks << ",\n";
+	json << "    \"chunks_drawn_per_frame\": " << (double)terrainChunksDrawn / frames << ",\n";
+	json << "    \"triangles_per_frame\": " << (double)terrainTriangles / frames << "\n";
+	json << "  },\n";
+	json << "  \"shadows\": {\n";
+	json << "    \"enabled\": " << (shadows ? "true" : "false") << ",\n";
+	json << "    \"cached\": " << (shadowCache ? "true" : "false") << ",\n";
+	json << "    \"size\": " << shadowSize << ",\n";
+	json << "    \"static_redraws\": " << shadowStaticRedraws << ",\n";
+	json << "    \"faces_per_frame\": " << (double)shadowFaces / frames << ",\n";
+	json << "    \"submit_ms_per_frame\": " << shadowMs / frames << ",\n";
+	json << "    \"gpu_ms_per_frame\": " << (shadowGpuFrames ? shadowGpuMs / shadowGpuFrames : 0.0) << "\n";
+	json << "  },\n";
+	json << "  \"uniform_buffer\": {\n";
+	json << "    \"persistent\": " << (persistentMapping ? "true" : "false") << ",\n";
+	json << "    \"stalls\": " << uniformStalls << "\n";
+	json << "  },\n";
+	json << "  \"point_lights\": {\n";
+	json << "    \"count\": " << pointLights << ",\n";
+	json << "    \"cluster_references_per_frame\": " << (double)lightReferences / frames << ",\n";
+	json << "    \"max_per_cluster\": " << maxClusterLights << "\n";
+	json << "  },\n";
+	double shadedPerFrame = shadedSampleFrames ? (double)shadedSamples / shadedSampleFrames : 0.0;
+	json << "  \"shading\": {\n";
+	json << "    \"depth_prepass\": " << (depthPrepass ? "true" : "false") << ",\n";
+	json << "    \"fragments_per_frame\": " << shadedPerFrame << ",\n";
+	double pixelsPerFrame = frameMs.empty() ? (double)width * height : drawnPixels / frameMs.size();
+	json << "    \"fragments_per_pixel\": " << (pixelsPerFrame > 0.0 ? shadedPerFrame / pixelsPerFrame : 0.0) << "\n";
+	json << "  },\n";
+	json << "  \"resolution\": {\n";
+	json << "    \"dynamic\": " << (frameBudgetMs > 0.0 ? "true" : "false") << ",\n";
+	json << "    \"budget_ms\": " << frameBudgetMs << ",\n";
+	json << "    \"mean_scale\": " << (frameMs.empty() ? 1.0 : resolutionScaleSum / frameMs.size()) << ",\n";
+	json << "    \"min_scale\": " << minResolutionScale << ",\n";
+	json << "    \"gpu_ms_mean\": " << (gpuMsFrames ? gpuMs / gpuMsFrames : 0.0) << "\n";
+	json << "  },\n";
+	json << "  \"capture\": {\n";
+	json << "    \"frames\": " << captureFrames << ",\n";
+	json << "    \"dropped\": " << captureDropped << ",\n";
+	json << "    \"render_thread_ms_per_frame\": " << (captureFrames + captureDropped ? captureMs / (captureFrames + captureDropped) : 0.0) << "\n";
+	json << "  },\n";
+	json << "  \"load_ms\": {\n";
+	for (size_t i = 0; i < loadMs.size(); i++)
+		json << "    " << jsonString(loadMs[i].first) << ": " << loadMs[i].second << ",\n";
+	json << "    \"total\": " << loadTotal << "\n";
+	json << "  },\n";
+	json << "  \"shaders\": {\n";
+	json << "    \"ready_ms\": " << shaderReadyMs << ",\n";
+	json << "    \"parallel_compile\": " << (parallelShaderCompile ? "true" : "false") << ",\n";
+	json << "    \"variants\": " << shaderVariants << "\n";
+	json << "  }\n";
+	json << "}\n";
+
+	if (path.empty() || path == "-")
+	{
+		std::cout << json.str();
+		return true;
+	}
+
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR::BENCHMARK::REPORT_NOT_WRITTEN " << path << std::endl;
+		return false;
+	}
+	file << json.str();
+	return true;
+}
@@ -0,0 +1,124 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Fixed simulation step used by benchmark replays (seconds)
+const double BENCH_TIMESTEP = 1.0 / 60.0;
+
+// A camera pose at a point in time, angles in degrees as used by mouse_callback
+struct CameraKey
+{
+	float time;
+	glm::vec3 position;
+	float yaw;
+	float pitch;
+};
+
+// A scripted camera flight, interpolated with Catmull-Rom splines and looped
+class CameraPath
+{
+public:
+	// Load a path file, one "time x y z yaw pitch" key per line, # starts a comment
+	bool load(const std::string& path);
+
+	// Orbit of the watchtower used when no path file is given
+	void makeDefault();
+
+	void evaluate(double time, glm::vec3& position, float& yaw, float& pitch) const;
+	float duration() const;
+
+	std::vector<CameraKey> keys;
+};
+
+// Timings collected during a benchmark run, written out as JSON
+struct BenchReport
+{
+	std::string renderer;
+	int width = 0;
+	int height = 0;
+	int warmupFrames = 0;
+	// Frames in flight between building and drawing, and threads building them
+	int pipelineDepth = 1;
+	unsigned int jobThreads = 1;
+
+	// Milliseconds from submitting the first shader until the last program was
+	// ready, and whether the driver compiled them on its own threads
+	double shaderReadyMs = 0.0;
+	bool parallelShaderCompile = false;
+	// Shading program variants compiled for the scene's materials
+	size_t shaderVariants = 0;
+
+	// Milliseconds per measured frame
+	std::vector<double> frameMs;
+	// Triangles submitted over all measured frames
+	unsigned long long triangles = 0;
+	// Binds issued, binds skipped as redundant, and the binds the draws
+	// would have needed unsorted, over all measured frames
+	unsigned long long stateChanges = 0;
+	unsigned long long redundantStateChanges = 0;
+	unsigned long long unsortedStateChanges = 0;
+	// World matrices rebuilt over all measured frames
+	unsigned long long transformUpdates = 0;
+	// Boids in the flock, the milliseconds stepping it and the ravens drawn over all measured frames
+	unsigned int flockBoids = 0;
+	double flockMs = 0.0;
+	unsigned long long flockInstances = 0;
+	// Chunks in the terrain, and the chunks and triangles of it drawn over all measured frames
+	unsigned int terrainChunks = 0;
+	unsigned long long terrainChunksDrawn = 0;
+	unsigned long long terrainTriangles = 0;
+	// Shadow cube maps of the main light, whether the static one was cached, the
+	// times it was redrawn, and the submit and GPU time and faces drawn over all measured frames
+	bool shadows = false;
+	bool shadowCache = false;
+	int shadowSize = 0;
+	unsigned int shadowStaticRedraws = 0;
+	double shadowMs = 0.0;
+	unsigned long long shadowFaces = 0;
+	double shadowGpuMs = 0.0;
+	unsigned int shadowGpuFrames = 0;
+	// Whether per draw uniforms went through a persistently mapped buffer, and the
+	// measured frames that had to wait for the GPU to free their part of it
+	bool persistentMapping = false;
+	unsigned long long uniformStalls = 0;
+	// Point lights, the light indices written to the clusters over all measured
+	// frames and the most lights any one cluster held
+	unsigned int pointLights = 0;
+	unsigned long long lightReferences = 0;
+	unsigned int maxClusterLights = 0;
+	// Whether depth was laid down before shading, and the samples the shading
+	// pass wrote over the measured frames whose query came back in time. Per pixel
+	// is against the pixels drawn, fewer than the target's with dynamic resolution
+	bool depthPrepass = false;
+	unsigned long long shadedSamples = 0;
+	unsigned int shadedSampleFrames = 0;
+	// Frame time budget of dynamic resolution, 0 when it was off, the scale of the
+	// drawn size to the target's added up over the measured frames, and the GPU
+	// time of the measured frames whose timer came back in time
+	double frameBudgetMs = 0.0;
+	double resolutionScaleSum = 0.0;
+	double drawnPixels = 0.0;
+	double minResolutionScale = 1.0;
+	double gpuMs = 0.0;
+	unsigned int gpuMsFrames = 0;
+	// Measured frames read back by --capture, the ones dropped with every readback
+	// buffer busy, and the milliseconds the render thread spent capturing
+	unsigned int captureFrames = 0;
+	unsigned int captureDropped = 0;
+	double captureMs = 0.0;
+	// Named load stages in milliseconds, in the order they ran
+	std::vector<std::pair<std::string, double> > loadMs;
+
+	// Write the report, an empty path or "-" writes to stdout
+	bool write(const std::string& path) const;
+};
+
+// Nearest rank percentile (0 - 100) of a list of samples
+double percentile(std::vector<double> samples, double p);
+
+#endif
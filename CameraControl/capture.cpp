@@ -0,0 +1,264 @@
+// Frame capture through pixel pack buffers read back a few frames late
+
+#include <chrono>
+#include <iostream>
+#include <ctype.h>
+#include <string.h>
+
+#include "capture.h"
+
+static bool isVideoPath(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = path.substr(dot + 1);
+	for (size_t i = 0; i < extension.size(); i++)
+		extension[i] = (char)tolower((unsigned char)extension[i]);
+	return extension == "y4m";
+}
+
+bool FrameCapture::start(const std::string& file, unsigned int rate)
+{
+	stop();
+
+	path = file;
+	fps = rate > 0 ? rate : 60;
+	video = isVideoPath(file);
+	persistent = GLEW_ARB_buffer_storage != 0;
+	captured = dropped = 0;
+	threadMs = 0.0;
+	next = 0;
+	nextVideoFrame = 0;
+	pendingVideo.clear();
+
+	stopping = false;
+	for (int i = 0; i < ENCODER_THREADS; i++)
+		encoders.push_back(std::thread(&FrameCapture::encoderLoop, this));
+	active = true;
+	return true;
+}
+
+void FrameCapture::stop()
+{
+	if (!active)
+		return;
+
+	collect(true);
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+		stopping = true;
+	}
+	queueReady.notify_all();
+	for (size_t i = 0; i < encoders.size(); i++)
+		encoders[i].join();
+	encoders.clear();
+
+	for (int i = 0; i < SLOTS; i++)
+	{
+		Slot& slot = slots[i];
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+		slot.fence = 0;
+		if (slot.mapped)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glDeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+		slot.capacity = 0;
+		slot.mapped = NULL;
+		slot.state = FREE;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	{
+		std::lock_guard<std::mutex> guard(videoLock);
+		if (!pendingVideo.empty())
+			std::cout << "ERROR::CAPTURE::FRAMES_MISSING " << pendingVideo.size() << " not written" << std::endl;
+		pendingVideo.clear();
+		videoFile.close();
+	}
+	std::cout << "Captured " << captured << " frames to " << path << ", " << dropped << " dropped" << std::endl;
+	active = false;
+}
+
+// Grow the slot's buffer to hold bytes. A persistent mapping is made once per buffer
+bool FrameCapture::reserve(Slot& slot, size_t bytes)
+{
+	if (slot.buffer && slot.capacity >= bytes)
+		return true;
+
+	if (slot.buffer)
+	{
+		if (slot.mapped)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glDeleteBuffers(1, &slot.buffer);
+	}
+	slot.mapped = NULL;
+	slot.capacity = 0;
+
+	glGenBuffers(1, &slot.buffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, bytes, NULL, flags);
+		slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, flags);
+		if (!slot.mapped)
+		{
+			std::cout << "ERROR::CAPTURE::MAP_FAILED" << std::endl;
+			return false;
+		}
+	}
+	else
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+	slot.capacity = bytes;
+	return true;
+}
+
+// Unmap the slots the encoders are done with and queue the ones whose readback has
+// finished, oldest first so a video's frames mostly arrive in order. With wait the
+// readbacks still in flight are waited for
+void FrameCapture::collect(bool wait)
+{
+	for (int i = 0; i < SLOTS; i++)
+	{
+		Slot& slot = slots[(next + i) % SLOTS];
+		if (slot.state == RELEASED)
+		{
+			if (!persistent)
+			{
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				slot.mapped = NULL;
+			}
+			slot.state = FREE;
+		}
+		if (slot.state != READING)
+			continue;
+
+		GLenum result = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+		if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+			continue;
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		// The copy is done, so mapping does not wait for the GPU
+		if (!persistent)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (size_t)slot.width * slot.height * 4, GL_MAP_READ_BIT);
+			if (!slot.mapped)
+			{
+				std::cout << "ERROR::CAPTURE::MAP_FAILED" << std::endl;
+				slot.state = FREE;
+				continue;
+			}
+		}
+
+		slot.state = QUEUED;
+		{
+			std::lock_guard<std::mutex> guard(queueLock);
+			queue.push_back(&slot);
+		}
+		queueReady.notify_one();
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::capture(GLuint framebuffer, int width, int height)
+{
+	if (!active || width <= 0 || height <= 0)
+		return;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+	collect(false);
+
+	// The video takes the size of its first frame
+	if (video && captured == 0 && !videoFile.isOpen() && !videoFile.open(path, width, height, fps))
+	{
+		stop();
+		return;
+	}
+
+	Slot& slot = slots[next];
+	if (slot.state != FREE)
+		dropped++;
+	else if (reserve(slot, (size_t)width * height * 4))
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.width = width;
+		slot.height = height;
+		slot.frame = captured++;
+		slot.state = READING;
+		next = (next + 1) % SLOTS;
+	}
+
+	threadMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// Copy a queued slot out top row first, hand the buffer back and encode the copy
+void FrameCapture::encoderLoop()
+{
+	std::vector<unsigned char> pixels, yuv;
+	for (;;)
+	{
+		Slot* slot;
+		{
+			std::unique_lock<std::mutex> guard(queueLock);
+			queueReady.wait(guard, [this] { return stopping || !queue.empty(); });
+			if (queue.empty())
+				return;
+			slot = queue.front();
+			queue.pop_front();
+		}
+
+		int width = slot->width, height = slot->height;
+		unsigned int frame = slot->frame;
+		size_t rowBytes = (size_t)width * 4;
+		pixels.resize(rowBytes * height);
+		for (int y = 0; y < height; y++)
+			memcpy(&pixels[(size_t)(height - 1 - y) * rowBytes], slot->mapped + (size_t)y * rowBytes, rowBytes);
+		slot->state = RELEASED;
+
+		if (video)
+		{
+			// Frames of another size than the first cannot go in the same video
+			if (videoFile.width() == (unsigned int)width && videoFile.height() == (unsigned int)height)
+				convertToYUV420(width, height, &pixels[0], yuv);
+			else
+				yuv.clear();
+			writeVideo(frame, yuv);
+		}
+		else
+			writeImage(numberedPath(path, frame), width, height, &pixels[0]);
+	}
+}
+
+// Write the frame if the ones before it are written, then the ones that were
+// waiting on it. An empty frame is skipped
+void FrameCapture::writeVideo(unsigned int frame, std::vector<unsigned char>& yuv)
+{
+	std::lock_guard<std::mutex> guard(videoLock);
+	pendingVideo[frame].swap(yuv);
+	for (;;)
+	{
+		std::map<unsigned int, std::vector<unsigned char> >::iterator it = pendingVideo.find(nextVideoFrame);
+		if (it == pendingVideo.end())
+			break;
+		if (!it->second.empty() && !videoFile.writeFrame(it->second))
+			std::cout << "ERROR::CAPTURE::FRAME_NOT_WRITTEN " << nextVideoFrame << std::endl;
+		pendingVideo.erase(it);
+		nextVideoFrame++;
+	}
+}
@@ -0,0 +1,99 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image.h"
+
+// Records frames to numbered images or a Y4M video without stalling the GL thread.
+// Each frame is read into a pixel pack buffer and fenced, and only mapped once the
+// fence has signalled a frame or more later. With ARB_buffer_storage the buffers
+// stay mapped persistently. Flipping, conversion and encoding run on encoder
+// threads of its own: jobs on the shared pool could be picked up by the GL thread
+// while it waits for a frame to be built. When every buffer is still busy the
+// frame is dropped and counted instead of waiting
+class FrameCapture
+{
+public:
+	static const int SLOTS = 4;
+	static const int ENCODER_THREADS = 2;
+
+	~FrameCapture() { stop(); }
+
+	// A .y4m path records a video at fps, any other path numbered images in a
+	// format writeImage knows: out.png becomes out_0000.png, out_0001.png and so on
+	bool start(const std::string& path, unsigned int fps = 60);
+	// Read back the frames still in flight, finish encoding them and close the files.
+	// Needs the GL context, like capture
+	void stop();
+	bool isActive() const { return active; }
+
+	// Queue the colour of framebuffer, width by height from the bottom left, and
+	// hand over the frames whose readback has finished
+	void capture(GLuint framebuffer, int width, int height);
+
+	// Since the last start
+	unsigned int framesCaptured() const { return captured; }
+	unsigned int framesDropped() const { return dropped; }
+	// Milliseconds the GL thread spent in capture
+	double renderThreadMs() const { return threadMs; }
+
+private:
+	enum SlotState { FREE, READING, QUEUED, RELEASED };
+
+	struct Slot
+	{
+		GLuint buffer = 0;
+		size_t capacity = 0;
+		unsigned char* mapped = NULL;
+		GLsync fence = 0;
+		int width = 0;
+		int height = 0;
+		unsigned int frame = 0;
+		std::atomic<int> state;
+
+		Slot() : state(FREE) {}
+	};
+
+	bool reserve(Slot& slot, size_t bytes);
+	void collect(bool wait);
+	void encoderLoop();
+	void writeVideo(unsigned int frame, std::vector<unsigned char>& yuv);
+
+	bool active = false;
+	bool persistent = false;
+	bool video = false;
+	std::string path;
+	unsigned int fps = 60;
+
+	Slot slots[SLOTS];
+	int next = 0;
+	unsigned int captured = 0;
+	unsigned int dropped = 0;
+	double threadMs = 0.0;
+
+	// Slots read back and waiting for an encoder
+	std::vector<std::thread> encoders;
+	std::mutex queueLock;
+	std::condition_variable queueReady;
+	std::deque<Slot*> queue;
+	bool stopping = false;
+
+	// Frames converted out of order wait here until the ones before them are written
+	std::mutex videoLock;
+	Y4MWriter videoFile;
+	std::map<unsigned int, std::vector<unsigned char> > pendingVideo;
+	unsigned int nextVideoFrame = 0;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <string.h>
+
+#include "dds.h"
+#include "pack.h"
+
+bool readDDS(const char* imagepath, DDSImage& image) {
+
+	/* from the open asset pack if it holds the file, otherwise from disk */
+	pack::Asset file;
+	if (!pack::read(imagepath, file))
+		return false;
+
+	/* verify the type of file, then the surface desc follows */
+	if (file.size < 128 || strncmp(file.data, "DDS ", 4) != 0)
+		return false;
+	const unsigned char* header = (const unsigned char*)file.data + 4;
+
+	image.height = *(unsigned int*)&(header[8]);
+	image.width = *(unsigned int*)&(header[12]);
+	unsigned int linearSize = *(unsigned int*)&(header[16]);
+	image.mipMapCount = *(unsigned int*)&(header[24]);
+	image.fourCC = *(unsigned int*)&(header[80]);
+
+	switch (image.fourCC)
+	{
+	case FOURCC_DXT1:
+		image.blockSize = 8;
+		break;
+	case FOURCC_DXT3:
+	case FOURCC_DXT5:
+		image.blockSize = 16;
+		break;
+	default:
+		return false;
+	}
+
+	/* how big is it going to be including all mipmaps? */
+	size_t bufsize = image.mipMapCount > 1 ? (size_t)linearSize * 2 : linearSize;
+	const unsigned char* pixels = header + 124;
+	size_t available = file.size - 128;
+	image.data.assign(pixels, pixels + (bufsize < available ? bufsize : available));
+
+	return true;
+}
+
+// Expand a 5:6:5 colour to 8 bits per channel
+static void unpack565(unsigned int packed, unsigned char* rgb)
+{
+	unsigned int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	rgb[0] = (unsigned char)((r << 3) | (r >> 2));
+	rgb[1] = (unsigned char)((g << 2) | (g >> 4));
+	rgb[2] = (unsigned char)((b << 3) | (b >> 2));
+}
+
+// The 16 colours of a DXT colour block. DXT1 blocks with the first endpoint not
+// above the second have three colours and transparent black
+static void decodeColorBlock(const unsigned char* block, bool dxt1, unsigned char texels[16][4])
+{
+	unsigned int c0 = block[0] | (block[1] << 8);
+	unsigned int c1 = block[2] | (block[3] << 8);
+	unsigned char palette[4][4];
+	unpack565(c0, palette[0]);
+	unpack565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int i = 0; i < 3; i++)
+	{
+		if (c0 > c1 || !dxt1)
+		{
+			palette[2][i] = (unsigned char)((2 * palette[0][i] + palette[1][i]) / 3);
+			palette[3][i] = (unsigned char)((palette[0][i] + 2 * palette[1][i]) / 3);
+		}
+		else
+		{
+			palette[2][i] = (unsigned char)((palette[0][i] + palette[1][i]) / 2);
+			palette[3][i] = 0;
+		}
+	}
+	if (dxt1 && c0 <= c1)
+		palette[3][3] = 0;
+
+	unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+	for (int i = 0; i < 16; i++)
+		memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4);
+}
+
+// DXT5 alpha: two endpoints and 3 bit indices into six or eight steps between them
+static void decodeAlphaBlock(const unsigned char* block, unsigned char texels[16][4])
+{
+	unsigned int a0 = block[0], a1 = block[1];
+	unsigned char palette[8] = { (unsigned char)a0, (unsigned char)a1 };
+	for (unsigned int i = 1; i < 7; i++)
+	{
+		if (a0 > a1)
+			palette[i + 1] = (unsigned char)(((7 - i) * a0 + i * a1) / 7);
+		else if (i < 5)
+			palette[i + 1] = (unsigned char)(((5 - i) * a0 + i * a1) / 5);
+	}
+	if (a0 <= a1)
+	{
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	unsigned long long indices = 0;
+	for (int i = 0; i < 6; i++)
+		indices |= (unsigned long long)block[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++)
+		texels[i][3] = palette[(indices >> (3 * i)) & 7];
+}
+
+bool decodeDDS(const DDSImage& image, std::vector<unsigned char>& rgba)
+{
+	unsigned int blocksX = (image.width + 3) / 4;
+	unsigned int blocksY = (image.height + 3) / 4;
+	if (image.blockSize == 0 || (size_t)blocksX * blocksY * image.blockSize > image.data.size())
+		return false;
+
+	rgba.resize((size_t)image.width * image.height * 4);
+	const unsigned char* block = &image.data[0];
+	for (unsigned int by = 0; by < blocksY; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksX; bx++, block += image.blockSize)
+		{
+			unsigned char texels[16][4];
+			if (image.fourCC == FOURCC_DXT1)
+				decodeColorBlock(block, true, texels);
+			else
+			{
+				decodeColorBlock(block + 8, false, texels);
+				if (image.fourCC == FOURCC_DXT5)
+					decodeAlphaBlock(block, texels);
+				else
+					for (int i = 0; i < 16; i++)
+						texels[i][3] = (unsigned char)(((block[i / 2] >> (4 * (i & 1))) & 15) * 17);
+			}
+
+			// Blocks on the right and bottom edges of odd sized images are partly outside
+			for (unsigned int y = 0; y < 4 && by * 4 + y < image.height; y++)
+				for (unsigned int x = 0; x < 4 && bx * 4 + x < image.width; x++)
+					memcpy(&rgba[((size_t)(by * 4 + y) * image.width + bx * 4 + x) * 4], texels[y * 4 + x], 4);
+		}
+	}
+	return true;
+}
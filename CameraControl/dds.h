@@ -0,0 +1,29 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <vector>
+
+#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
+#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
+#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+
+// A compressed DDS image as stored on disk, every mip level packed one after the other
+struct DDSImage
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int mipMapCount = 0;
+	unsigned int fourCC = 0;
+	unsigned int blockSize = 0;	// Bytes per 4x4 block, 8 for DXT1 and 16 for DXT3/5
+	std::vector<unsigned char> data;
+};
+
+// Read a DXT1/3/5 .DDS file into memory without touching OpenGL,
+// returns false if the file is missing or not a supported format
+bool readDDS(const char* imagepath, DDSImage& image);
+
+// Decompress the top mip level to 8 bit RGBA, rows in file order.
+// Returns false if the image holds less data than its size needs
+bool decodeDDS(const DDSImage& image, std::vector<unsigned char>& rgba);
+
+#endif
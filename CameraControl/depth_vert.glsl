@@ -0,0 +1,26 @@
+#version 330 core
+// INSTANCED may be #defined after the version line, as for vert.glsl
+layout (location = 0) in vec3 position;
+#ifdef INSTANCED
+layout (location = 3) in mat4 instanceModel;
+#else
+// Written per draw to a ring buffer
+layout (std140) uniform Object
+{
+    mat4 model;
+};
+#endif
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// Must match vert.glsl exactly, the shading pass tests for equal depth
+invariant gl_Position;
+
+void main()
+{
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+#endif
+    gl_Position = projection * view * model * vec4(position, 1.0f);
+}
@@ -0,0 +1,103 @@
+// Sorted draw submission with redundant state filtering
+
+#include <algorithm>
+#include <math.h>
+
+#include "drawlist.h"
+
+static const unsigned int NOTHING_BOUND = 0xFFFFFFFF;
+
+uint64_t makeDrawKey(unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth)
+{
+	return ((uint64_t)(shader & 0xFFFF) << 48) | ((uint64_t)(material & 0xFFFF) << 32) | ((uint64_t)(mesh & 0xFFFF) << 16) | (depth & 0xFFFF);
+}
+
+uint64_t makeDepthFirstKey(unsigned int depth, unsigned int shader, unsigned int material, unsigned int mesh)
+{
+	return ((uint64_t)(depth & 0xFFFF) << 48) | ((uint64_t)(shader & 0xFFFF) << 32) | ((uint64_t)(material & 0xFFFF) << 16) | (mesh & 0xFFFF);
+}
+
+unsigned int depthSortBits(float depth, float nearPlane, float farPlane)
+{
+	if (depth <= nearPlane)
+		return 0;
+	if (depth >= farPlane)
+		return 0xFFFF;
+	return (unsigned int)(logf(depth / nearPlane) / logf(farPlane / nearPlane) * 65535.0f);
+}
+
+void StateCache::reset()
+{
+	// Nothing is known about the bound state at the start of a frame
+	counts = StateChangeCounts();
+	program = NOTHING_BOUND;
+	vertexArray = NOTHING_BOUND;
+	material = NOTHING_BOUND;
+}
+
+void StateCache::useProgram(GLuint newProgram)
+{
+	if (program == newProgram)
+	{
+		counts.redundant++;
+		return;
+	}
+	program = newProgram;
+	glUseProgram(program);
+	counts.programs++;
+
+	std::unordered_map<GLuint, MaterialUniforms>::const_iterator found = locations.find(program);
+	if (found == locations.end())
+		found = locations.insert(std::make_pair(program, MaterialUniforms::locate(program))).first;
+	uniforms = &found->second;
+
+	// Material uniforms belong to the program, they have to be set again
+	material = NOTHING_BOUND;
+}
+
+void StateCache::bindVertexArray(GLuint newVertexArray)
+{
+	if (vertexArray == newVertexArray)
+	{
+		counts.redundant++;
+		return;
+	}
+	vertexArray = newVertexArray;
+	glBindVertexArray(vertexArray);
+	counts.vertexArrays++;
+}
+
+bool StateCache::bindMaterial(unsigned int newMaterial)
+{
+	if (material == newMaterial)
+	{
+		counts.redundant++;
+		return false;
+	}
+	material = newMaterial;
+	counts.materials++;
+	return true;
+}
+
+unsigned int DrawList::countStateChanges() const
+{
+	unsigned int changes = 0;
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		const DrawItem& item = items[i];
+		const DrawItem* previous = i > 0 ? &items[i - 1] : NULL;
+		bool programChanged = !previous || previous->program != item.program;
+		changes += programChanged ? 1 : 0;
+		changes += programChanged || previous->material != item.material ? 1 : 0;
+		changes += !previous || previous->mesh != item.mesh ? 1 : 0;
+	}
+	return changes;
+}
+
+void DrawList::sort()
+{
+	std::stable_sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b)
+	{
+		return a.key < b.key;
+	});
+}
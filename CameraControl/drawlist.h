@@ -0,0 +1,94 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "material.h"
+
+// One object to draw this frame. The key orders draws by shader, then
+// material, then mesh so each kind of state changes as rarely as possible
+struct DrawItem
+{
+	uint64_t key;
+	GLuint program;
+	unsigned int material;
+	int mesh;
+	glm::mat4 model;
+	float depth;	// View depth of the mesh's centre
+	bool dynamic;	// Moved by an animation, its shadow is drawn every frame
+	const char* name;	// Profiler scope name
+};
+
+// Pack shader, material and mesh into a sort key, 16 bits each, most significant
+// first. The last 16 bits order draws with the same state front to back
+uint64_t makeDrawKey(unsigned int shader, unsigned int material, unsigned int mesh, unsigned int depth = 0);
+
+// Sort key putting the nearest draws first whatever their state, so the depth
+// test rejects as many hidden fragments as it can. State only breaks ties
+uint64_t makeDepthFirstKey(unsigned int depth, unsigned int shader, unsigned int material, unsigned int mesh);
+
+// View depth between the clip planes as 16 sort bits, spaced logarithmically so
+// near objects are told apart as finely as far ones
+unsigned int depthSortBits(float depth, float nearPlane, float farPlane);
+
+// Binds issued for a frame, and the ones skipped because the state was already set
+struct StateChangeCounts
+{
+	unsigned int programs = 0;
+	unsigned int materials = 0;
+	unsigned int vertexArrays = 0;
+	unsigned int redundant = 0;
+
+	unsigned int total() const { return programs + materials + vertexArrays; }
+};
+
+// Remembers the bound program, material and vertex array so repeated binds
+// can be skipped. reset() at the start of every frame
+class StateCache
+{
+public:
+	void reset();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vertexArray);
+	// Returns true if the material changed and has to be applied
+	bool bindMaterial(unsigned int material);
+
+	// Material uniform locations of the bound program
+	const MaterialUniforms& materialUniforms() const { return *uniforms; }
+
+	StateChangeCounts counts;
+
+private:
+	GLuint program = 0xFFFFFFFF;
+	GLuint vertexArray = 0xFFFFFFFF;
+	unsigned int material = 0xFFFFFFFF;
+
+	// Looked up the first time each program is bound, programs are never relinked
+	std::unordered_map<GLuint, MaterialUniforms> locations;
+	const MaterialUniforms* uniforms = nullptr;
+};
+
+class DrawList
+{
+public:
+	void clear() { items.clear(); }
+	void add(const DrawItem& item) { items.push_back(item); }
+
+	// Number of binds the items need in their current order, skipping repeats
+	unsigned int countStateChanges() const;
+
+	// Order by key, items with equal keys keep their submission order
+	void sort();
+
+	std::vector<DrawItem> items;
+};
+
+#endif
@@ -0,0 +1,97 @@
+// Dynamic resolution: GPU frame timing and the scale picked from it
+
+#include <algorithm>
+#include <math.h>
+
+#include "dynres.h"
+
+// Aim a little under the budget so frames that take longer than usual still fit
+static const double BUDGET_HEADROOM = 0.9;
+// Weight of the newest frame in the averaged cost per pixel
+static const double COST_SMOOTHING = 0.1;
+// Most the scale changes in one frame, down and up
+static const float MAX_DROP = 0.85f;
+static const float MAX_RISE = 1.03f;
+// Relative changes smaller than this keep the resolution as it is
+static const float MIN_CHANGE = 0.02f;
+
+void GpuFrameTimer::create()
+{
+	glGenQueries(SLOTS * 2, queries);
+}
+
+void GpuFrameTimer::destroy()
+{
+	glDeleteQueries(SLOTS * 2, queries);
+	*this = GpuFrameTimer();
+}
+
+void GpuFrameTimer::begin(double pixels)
+{
+	// The frame that used this slot last is dropped if the GPU is not done with it
+	if (pending[current])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(queries[current * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 start = 0, stop = 0;
+			glGetQueryObjectui64v(queries[current * 2], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(queries[current * 2 + 1], GL_QUERY_RESULT, &stop);
+			resultMs = (double)(stop - start) / 1.0e6;
+			resultPixels = slotPixels[current];
+			hasResult = true;
+		}
+		pending[current] = false;
+	}
+
+	glQueryCounter(queries[current * 2], GL_TIMESTAMP);
+	slotPixels[current] = pixels;
+}
+
+void GpuFrameTimer::end()
+{
+	glQueryCounter(queries[current * 2 + 1], GL_TIMESTAMP);
+	pending[current] = true;
+	current = (current + 1) % SLOTS;
+}
+
+bool GpuFrameTimer::result(double& milliseconds, double& pixels)
+{
+	if (!hasResult)
+		return false;
+	milliseconds = resultMs;
+	pixels = resultPixels;
+	hasResult = false;
+	return true;
+}
+
+void ResolutionController::configure(double budget, float minimum, float maximum)
+{
+	budgetMs = budget;
+	minScale = minimum;
+	maxScale = std::max(minimum, maximum);
+	currentScale = std::min(std::max(currentScale, minScale), maxScale);
+	msPerPixel = 0.0;
+}
+
+bool ResolutionController::update(double gpuMs, double pixels, double windowPixels)
+{
+	if (gpuMs <= 0.0 || pixels <= 0.0 || windowPixels <= 0.0)
+		return false;
+
+	double cost = gpuMs / pixels;
+	msPerPixel = msPerPixel > 0.0 ? msPerPixel + (cost - msPerPixel) * COST_SMOOTHING : cost;
+
+	// The scale at which the window's pixels would take the budget
+	float target = (float)sqrt(budgetMs * BUDGET_HEADROOM / (msPerPixel * windowPixels));
+	target = std::min(std::max(target, currentScale * MAX_DROP), currentScale * MAX_RISE);
+	target = std::min(std::max(target, minScale), maxScale);
+
+	// Small steps are only taken to reach the ends of the range
+	bool atLimit = target == minScale || target == maxScale;
+	if (target == currentScale || (!atLimit && fabsf(target / currentScale - 1.0f) < MIN_CHANGE))
+		return false;
+	currentScale = target;
+	return true;
+}
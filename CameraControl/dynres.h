@@ -0,0 +1,64 @@
+#ifndef DYNRES_H
+#define DYNRES_H
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "profiler.h"
+
+// GPU time of whole frames from timestamp pairs, which unlike GL_TIME_ELAPSED can
+// enclose the profiler's own queries. A frame's time is read back
+// PROFILER_FRAME_LATENCY frames later if it is ready by then, so the CPU never waits
+class GpuFrameTimer
+{
+public:
+	// Needs a current GL context
+	void create();
+	void destroy();
+
+	// Enclose the GPU work of a frame, pixels is how many it draws and comes back with its time
+	void begin(double pixels);
+	void end();
+
+	// The newest frame read back since the last call, false if none came back
+	bool result(double& milliseconds, double& pixels);
+
+private:
+	static const int SLOTS = PROFILER_FRAME_LATENCY + 1;
+
+	GLuint queries[SLOTS * 2] = {};
+	double slotPixels[SLOTS] = {};
+	bool pending[SLOTS] = {};
+	int current = 0;
+
+	bool hasResult = false;
+	double resultMs = 0.0;
+	double resultPixels = 0.0;
+};
+
+// Picks the scale of the render resolution that holds a GPU frame time budget. The
+// time of a frame is taken to grow with the pixels it draws; the cost per pixel
+// is averaged over recent frames, so results read back a few frames late at an
+// older scale still count. The scale drops quickly and rises slowly
+class ResolutionController
+{
+public:
+	// Scales apply to each side of the window, so 0.5 draws a quarter of the pixels
+	void configure(double budgetMs, float minScale = 0.5f, float maxScale = 1.0f);
+
+	// Feed the GPU time of a frame and the pixels it drew, against the window's
+	// pixel count. Returns true if the scale changed
+	bool update(double gpuMs, double pixels, double windowPixels);
+
+	float scale() const { return currentScale; }
+	double budget() const { return budgetMs; }
+
+private:
+	double budgetMs = 16.0;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float currentScale = 1.0f;
+	double msPerPixel = 0.0;
+};
+
+#endif
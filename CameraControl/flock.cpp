@@ -0,0 +1,430 @@
+// Boids flocking over a hashed uniform grid, see flock.h
+
+#include <algorithm>
+#include <math.h>
+
+#include "flock.h"
+#include "parallel.h"
+#include "xorshift.h"
+
+#ifdef FLOCK_SSE
+#include <emmintrin.h>
+#endif
+
+// Boids one job updates at least, and the chunk size of the culled transforms
+static const size_t STEP_RANGE = 256;
+static const size_t TRANSFORM_CHUNK = 2048;
+
+// Cells next to each other along x land in neighbouring buckets, so the three cells
+// of a row around a boid are one run of buckets and one run of sorted boids
+static inline uint32_t rowHash(int y, int z)
+{
+	return ((uint32_t)y * 73856093u ^ (uint32_t)z * 19349663u) * 2654435761u;
+}
+
+static inline int cellCoordinate(float value, float scale)
+{
+	return (int)floorf(value * scale);
+}
+
+uint32_t Flock::cellOf(float x, float y, float z) const
+{
+	return (rowHash(cellCoordinate(y, cellScale), cellCoordinate(z, cellScale)) + (uint32_t)cellCoordinate(x, cellScale)) & bucketMask;
+}
+
+void Flock::spawn(unsigned int count, unsigned int seed, const FlockSettings& flockSettings)
+{
+	settings = flockSettings;
+	cellScale = 1.0f / settings.neighbourRadius;
+	simulatedTime = 0.0;
+
+	// At least twice as many buckets as boids keeps unrelated cells from sharing one
+	uint32_t buckets = 1024;
+	while (buckets < count * 2u)
+		buckets *= 2;
+	bucketMask = buckets - 1;
+	bucketStart.assign(buckets + 1, 0);
+
+	XorShift32 random(seed);
+
+	std::vector<float>* streams[] = { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ };
+	for (std::vector<float>* stream : streams)
+		stream->resize(count);
+	// The sorted arrays have room for the neighbour sums to read a group of four past the end
+	std::vector<float>* sorted[] = { &sortedX, &sortedY, &sortedZ, &sortedVX, &sortedVY, &sortedVZ };
+	for (std::vector<float>* stream : sorted)
+		stream->assign(count + 3, 0.0f);
+	cells.resize(count);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		positionX[i] = settings.center.x + settings.extent.x * (random() * 2.0f - 1.0f);
+		positionY[i] = settings.center.y + settings.extent.y * (random() * 2.0f - 1.0f);
+		positionZ[i] = settings.center.z + settings.extent.z * (random() * 2.0f - 1.0f);
+
+		// Mostly level flight at a speed in the allowed range
+		float heading = random() * 6.2831853f;
+		float climb = (random() - 0.5f) * 0.5f;
+		float speed = settings.minSpeed + (settings.maxSpeed - settings.minSpeed) * random();
+		velocityX[i] = cosf(heading) * cosf(climb) * speed;
+		velocityY[i] = sinf(climb) * speed;
+		velocityZ[i] = sinf(heading) * cosf(climb) * speed;
+	}
+}
+
+// Counting sort of the boids by bucket into the sorted arrays, in their current
+// order within a bucket so the result does not depend on the threads
+void Flock::sortByCell(unsigned int threads)
+{
+	size_t count = size();
+	parallelFor(count, 4096, [this](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			cells[i] = cellOf(positionX[i], positionY[i], positionZ[i]);
+	}, threads);
+
+	std::fill(bucketStart.begin(), bucketStart.end(), 0);
+	for (size_t i = 0; i < count; i++)
+		bucketStart[cells[i] + 1]++;
+	for (size_t b = 1; b < bucketStart.size(); b++)
+		bucketStart[b] += bucketStart[b - 1];
+
+	// bucketStart[b + 1] is used as the write position of bucket b and ends up
+	// where bucket b + 1 starts
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t slot = bucketStart[cells[i]]++;
+		sortedX[slot] = positionX[i];
+		sortedY[slot] = positionY[i];
+		sortedZ[slot] = positionZ[i];
+		sortedVX[slot] = velocityX[i];
+		sortedVY[slot] = velocityY[i];
+		sortedVZ[slot] = velocityZ[i];
+	}
+	for (size_t b = bucketStart.size() - 1; b > 0; b--)
+		bucketStart[b] = bucketStart[b - 1];
+	bucketStart[0] = 0;
+}
+
+// Neighbour sums of one boid: relative positions and velocities of the boids
+// within the neighbour radius, and the push away from the ones too close. With
+// SSE each total is kept as four partial sums until every range is added
+struct NeighbourSums
+{
+	float offsetX = 0.0f, offsetY = 0.0f, offsetZ = 0.0f;
+	float velocityX = 0.0f, velocityY = 0.0f, velocityZ = 0.0f;
+	float pushX = 0.0f, pushY = 0.0f, pushZ = 0.0f;
+	float count = 0.0f;
+
+#ifdef FLOCK_SSE
+	enum { OFFSET_X, OFFSET_Y, OFFSET_Z, VELOCITY_X, VELOCITY_Y, VELOCITY_Z, PUSH_X, PUSH_Y, PUSH_Z, COUNT, TOTALS };
+	__m128 lanes[TOTALS];
+
+	NeighbourSums()
+	{
+		for (int k = 0; k < TOTALS; k++)
+			lanes[k] = _mm_setzero_ps();
+	}
+
+	void finish()
+	{
+		float* totals[TOTALS] = { &offsetX, &offsetY, &offsetZ, &velocityX, &velocityY, &velocityZ, &pushX, &pushY, &pushZ, &count };
+		for (int k = 0; k < TOTALS; k++)
+		{
+			float values[4];
+			_mm_storeu_ps(values, lanes[k]);
+			*totals[k] = (values[0] + values[1]) + (values[2] + values[3]);
+		}
+	}
+#else
+	void finish() {}
+#endif
+};
+
+// Add the neighbours among boids [begin, end) of the sorted arrays, which are
+// padded so the last group of four can read past the end
+static void sumNeighbours(const float* xs, const float* ys, const float* zs, const float* vxs, const float* vys, const float* vzs,
+	size_t begin, size_t end, float x, float y, float z, float radiusSquared, float separationSquared, NeighbourSums& sums)
+{
+#ifdef FLOCK_SSE
+	__m128 px = _mm_set1_ps(x), py = _mm_set1_ps(y), pz = _mm_set1_ps(z);
+	__m128 radius = _mm_set1_ps(radiusSquared), separation = _mm_set1_ps(separationSquared);
+	__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	__m128 firstLanes = _mm_castsi128_ps(_mm_set_epi32(3, 2, 1, 0));
+	__m128* lanes = sums.lanes;
+	for (size_t j = begin; j < end; j += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + j), px);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + j), py);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(zs + j), pz);
+		__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		// The boid itself, boids on top of it and lanes past the end are no neighbours
+		__m128 near = _mm_and_ps(_mm_cmplt_ps(distanceSquared, radius), _mm_cmpgt_ps(distanceSquared, zero));
+		if (end - j < 4)
+			near = _mm_and_ps(near, _mm_castsi128_ps(_mm_cmplt_epi32(_mm_castps_si128(firstLanes), _mm_set1_epi32((int)(end - j)))));
+		if (_mm_movemask_ps(near) == 0)
+			continue;
+
+		lanes[NeighbourSums::OFFSET_X] = _mm_add_ps(lanes[NeighbourSums::OFFSET_X], _mm_and_ps(near, dx));
+		lanes[NeighbourSums::OFFSET_Y] = _mm_add_ps(lanes[NeighbourSums::OFFSET_Y], _mm_and_ps(near, dy));
+		lanes[NeighbourSums::OFFSET_Z] = _mm_add_ps(lanes[NeighbourSums::OFFSET_Z], _mm_and_ps(near, dz));
+		lanes[NeighbourSums::VELOCITY_X] = _mm_add_ps(lanes[NeighbourSums::VELOCITY_X], _mm_and_ps(near, _mm_loadu_ps(vxs + j)));
+		lanes[NeighbourSums::VELOCITY_Y] = _mm_add_ps(lanes[NeighbourSums::VELOCITY_Y], _mm_and_ps(near, _mm_loadu_ps(vys + j)));
+		lanes[NeighbourSums::VELOCITY_Z] = _mm_add_ps(lanes[NeighbourSums::VELOCITY_Z], _mm_and_ps(near, _mm_loadu_ps(vzs + j)));
+		lanes[NeighbourSums::COUNT] = _mm_add_ps(lanes[NeighbourSums::COUNT], _mm_and_ps(near, one));
+
+		// Pushed away harder the closer they are, the lanes left out divide by one
+		__m128 close = _mm_and_ps(near, _mm_cmplt_ps(distanceSquared, separation));
+		if (_mm_movemask_ps(close) == 0)
+			continue;
+		__m128 inverse = _mm_and_ps(close, _mm_div_ps(one, _mm_or_ps(_mm_and_ps(close, distanceSquared), _mm_andnot_ps(close, one))));
+		lanes[NeighbourSums::PUSH_X] = _mm_sub_ps(lanes[NeighbourSums::PUSH_X], _mm_mul_ps(dx, inverse));
+		lanes[NeighbourSums::PUSH_Y] = _mm_sub_ps(lanes[NeighbourSums::PUSH_Y], _mm_mul_ps(dy, inverse));
+		lanes[NeighbourSums::PUSH_Z] = _mm_sub_ps(lanes[NeighbourSums::PUSH_Z], _mm_mul_ps(dz, inverse));
+	}
+#else
+	for (size_t j = begin; j < end; j++)
+	{
+		float dx = xs[j] - x, dy = ys[j] - y, dz = zs[j] - z;
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+		if (!(distanceSquared < radiusSquared && distanceSquared > 0.0f))
+			continue;
+
+		sums.offsetX += dx;
+		sums.offsetY += dy;
+		sums.offsetZ += dz;
+		sums.velocityX += vxs[j];
+		sums.velocityY += vys[j];
+		sums.velocityZ += vzs[j];
+		sums.count += 1.0f;
+		if (distanceSquared < separationSquared)
+		{
+			float inverse = 1.0f / distanceSquared;
+			sums.pushX -= dx * inverse;
+			sums.pushY -= dy * inverse;
+			sums.pushZ -= dz * inverse;
+		}
+	}
+#endif
+}
+
+// Steering back into the box along one axis, nothing while inside it
+static inline float boundsPull(float offset, float extent)
+{
+	if (offset > extent)
+		return extent - offset;
+	if (offset < -extent)
+		return -extent - offset;
+	return 0.0f;
+}
+
+// Ranges of sorted boids in the buckets the 27 cells around a cell fall in. The
+// nine rows of three cells are runs of buckets; runs that wrap around the table
+// are split and overlapping runs merged, so no boid is in two ranges. Returns the
+// number of ranges
+int Flock::neighbourRanges(int cx, int cy, int cz, uint32_t from[18], uint32_t to[18]) const
+{
+	uint32_t runStart[18], runEnd[18];
+	int runs = 0;
+	for (int dz = -1; dz <= 1; dz++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			uint32_t first = (rowHash(cy + dy, cz + dz) + (uint32_t)(cx - 1)) & bucketMask;
+			uint32_t last = first + 2;
+			if (last > bucketMask)
+			{
+				runStart[runs] = 0;
+				runEnd[runs++] = last - bucketMask - 1;
+				last = bucketMask;
+			}
+			runStart[runs] = first;
+			runEnd[runs++] = last;
+		}
+	}
+	// Pairing the sorted starts with the sorted ends covers the same buckets
+	std::sort(runStart, runStart + runs);
+	std::sort(runEnd, runEnd + runs);
+
+	int ranges = 0;
+	uint32_t covered = 0;
+	for (int r = 0; r < runs; r++)
+	{
+		uint32_t first = r > 0 ? std::max(runStart[r], covered + 1) : runStart[r];
+		covered = runEnd[r];
+		if (first > runEnd[r] || bucketStart[first] == bucketStart[runEnd[r] + 1])
+			continue;
+		from[ranges] = bucketStart[first];
+		to[ranges++] = bucketStart[runEnd[r] + 1];
+	}
+	return ranges;
+}
+
+void Flock::step(float seconds, unsigned int threads)
+{
+	if (positionX.empty())
+		return;
+	sortByCell(threads);
+
+	parallelFor(size(), STEP_RANGE, [this, seconds](size_t begin, size_t end)
+	{
+		float radiusSquared = settings.neighbourRadius * settings.neighbourRadius;
+		float separationSquared = settings.separationRadius * settings.separationRadius;
+
+		// Boids of one cell are next to each other and share their neighbour ranges
+		uint32_t from[18], to[18];
+		int ranges = 0;
+		int cellX = 0, cellY = 0, cellZ = 0;
+		bool found = false;
+
+		for (size_t i = begin; i < end; i++)
+		{
+			float x = sortedX[i], y = sortedY[i], z = sortedZ[i];
+			float vx = sortedVX[i], vy = sortedVY[i], vz = sortedVZ[i];
+
+			int cx = cellCoordinate(x, cellScale), cy = cellCoordinate(y, cellScale), cz = cellCoordinate(z, cellScale);
+			if (!found || cx != cellX || cy != cellY || cz != cellZ)
+			{
+				cellX = cx;
+				cellY = cy;
+				cellZ = cz;
+				found = true;
+				ranges = neighbourRanges(cx, cy, cz, from, to);
+			}
+
+			NeighbourSums sums;
+			for (int r = 0; r < ranges; r++)
+				sumNeighbours(&sortedX[0], &sortedY[0], &sortedZ[0], &sortedVX[0], &sortedVY[0], &sortedVZ[0],
+					from[r], to[r], x, y, z, radiusSquared, separationSquared, sums);
+			sums.finish();
+
+			float ax = 0.0f, ay = 0.0f, az = 0.0f;
+			if (sums.count > 0.0f)
+			{
+				float inverse = 1.0f / sums.count;
+				ax += (sums.velocityX * inverse - vx) * settings.alignmentWeight + sums.offsetX * inverse * settings.cohesionWeight;
+				ay += (sums.velocityY * inverse - vy) * settings.alignmentWeight + sums.offsetY * inverse * settings.cohesionWeight;
+				az += (sums.velocityZ * inverse - vz) * settings.alignmentWeight + sums.offsetZ * inverse * settings.cohesionWeight;
+				ax += sums.pushX * settings.separationWeight;
+				ay += sums.pushY * settings.separationWeight;
+				az += sums.pushZ * settings.separationWeight;
+			}
+			ax += boundsPull(x - settings.center.x, settings.extent.x) * settings.boundsWeight;
+			ay += boundsPull(y - settings.center.y, settings.extent.y) * settings.boundsWeight;
+			az += boundsPull(z - settings.center.z, settings.extent.z) * settings.boundsWeight;
+
+			float acceleration = sqrtf(ax * ax + ay * ay + az * az);
+			if (acceleration > settings.maxAcceleration)
+			{
+				float scale = settings.maxAcceleration / acceleration;
+				ax *= scale;
+				ay *= scale;
+				az *= scale;
+			}
+
+			vx += ax * seconds;
+			vy += ay * seconds;
+			vz += az * seconds;
+			float speed = sqrtf(vx * vx + vy * vy + vz * vz);
+			float clamped = std::min(std::max(speed, settings.minSpeed), settings.maxSpeed);
+			if (speed > 0.0f && clamped != speed)
+			{
+				float scale = clamped / speed;
+				vx *= scale;
+				vy *= scale;
+				vz *= scale;
+			}
+
+			// The state stays in sorted order, which is close to next step's order
+			positionX[i] = x + vx * seconds;
+			positionY[i] = y + vy * seconds;
+			positionZ[i] = z + vz * seconds;
+			velocityX[i] = vx;
+			velocityY[i] = vy;
+			velocityZ[i] = vz;
+		}
+	}, threads);
+}
+
+unsigned int Flock::advance(double time, double stepSeconds, unsigned int maxSteps, unsigned int threads)
+{
+	unsigned int steps = 0;
+	while (simulatedTime + stepSeconds <= time + 1e-9 && steps < maxSteps)
+	{
+		step((float)stepSeconds, threads);
+		simulatedTime += stepSeconds;
+		steps++;
+	}
+	if (simulatedTime + stepSeconds <= time)
+		simulatedTime = time;
+	return steps;
+}
+
+void Flock::writeTransforms(const glm::mat4& viewProjection, const glm::mat4& modelRotation, float scale, float radius,
+	std::vector<glm::mat4>& transforms, unsigned int threads)
+{
+	// Frustum planes from the rows of the matrix, normalized so the sphere test
+	// compares distances
+	glm::vec4 planes[6];
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	for (int k = 0; k < 3; k++)
+	{
+		planes[k * 2] = rows[3] + rows[k];
+		planes[k * 2 + 1] = rows[3] - rows[k];
+	}
+	for (int p = 0; p < 6; p++)
+		planes[p] = planes[p] * (1.0f / glm::length(glm::vec3(planes[p])));
+	float worldRadius = radius * scale;
+
+	size_t count = size();
+	size_t chunks = (count + TRANSFORM_CHUNK - 1) / TRANSFORM_CHUNK;
+	visible.resize(count);
+	chunkOffsets.assign(chunks + 1, 0);
+	parallelFor(chunks, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+		{
+			size_t inside = 0;
+			for (size_t i = c * TRANSFORM_CHUNK; i < std::min(count, (c + 1) * TRANSFORM_CHUNK); i++)
+			{
+				glm::vec4 center(positionX[i], positionY[i], positionZ[i], 1.0f);
+				bool in = true;
+				for (int p = 0; p < 6 && in; p++)
+					in = glm::dot(planes[p], center) > -worldRadius;
+				visible[i] = in;
+				inside += in;
+			}
+			chunkOffsets[c + 1] = inside;
+		}
+	}, threads);
+	for (size_t c = 0; c < chunks; c++)
+		chunkOffsets[c + 1] += chunkOffsets[c];
+
+	transforms.resize(chunkOffsets[chunks]);
+	parallelFor(chunks, 1, [&](size_t begin, size_t end)
+	{
+		const glm::vec3 up(0.0f, 1.0f, 0.0f);
+		for (size_t c = begin; c < end; c++)
+		{
+			glm::mat4* out = transforms.empty() ? NULL : &transforms[0] + chunkOffsets[c];
+			for (size_t i = c * TRANSFORM_CHUNK; i < std::min(count, (c + 1) * TRANSFORM_CHUNK); i++)
+			{
+				if (!visible[i])
+					continue;
+
+				// Model +z along the flight direction, +y as close to up as it allows
+				glm::vec3 forward = glm::normalize(glm::vec3(velocityX[i], velocityY[i], velocityZ[i]));
+				glm::vec3 side = glm::cross(up, forward);
+				float sideLength = glm::length(side);
+				side = sideLength > 1e-4f ? side / sideLength : glm::vec3(1.0f, 0.0f, 0.0f);
+				glm::vec3 top = glm::cross(forward, side);
+
+				glm::mat4 model(glm::vec4(side * scale, 0.0f), glm::vec4(top * scale, 0.0f), glm::vec4(forward * scale, 0.0f),
+					glm::vec4(positionX[i], positionY[i], positionZ[i], 1.0f));
+				*out++ = model * modelRotation;
+			}
+		}
+	}, threads);
+}
@@ -0,0 +1,89 @@
+#ifndef FLOCK_H
+#define FLOCK_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Neighbours are summed four at a time with SSE2 on x86 builds, one at a time
+// otherwise. Define FLOCK_NO_SIMD to force the scalar path
+#if !defined(FLOCK_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FLOCK_SSE
+#endif
+
+// Steering of the boids, distances in world units and times in seconds
+struct FlockSettings
+{
+	// Boids closer than this are neighbours, and the grid cells are this size
+	float neighbourRadius = 2.0f;
+	// Boids closer than this are pushed apart
+	float separationRadius = 0.6f;
+	float separationWeight = 2.5f;
+	float alignmentWeight = 1.0f;
+	float cohesionWeight = 0.5f;
+	float minSpeed = 3.0f;
+	float maxSpeed = 6.0f;
+	// Most the velocity changes per second
+	float maxAcceleration = 12.0f;
+	// Boids outside the box [center - extent, center + extent] turn back towards it
+	glm::vec3 center = glm::vec3(0.0f, 14.0f, -10.0f);
+	glm::vec3 extent = glm::vec3(40.0f, 8.0f, 40.0f);
+	float boundsWeight = 4.0f;
+};
+
+// Boids (separation, alignment and cohesion) over a uniform grid hashed into a
+// table, so finding the neighbours of a boid only looks at the 27 cells around
+// it. State is kept as one array per component, sorted by cell every step so the
+// neighbours of a cell lie next to each other in memory. Every boid's new state
+// depends only on the previous step, so the update is split over threads with the
+// same result on any number of them
+class Flock
+{
+public:
+	// Replace the flock with count boids placed at random in the box, flying in
+	// random directions. The same seed always gives the same flock
+	void spawn(unsigned int count, unsigned int seed, const FlockSettings& settings = FlockSettings());
+
+	// Advance by one step of seconds, threads = 0 uses every scheduler thread
+	void step(float seconds, unsigned int threads = 0);
+	// Take fixed steps until the flock reaches time, but at most maxSteps, dropping
+	// the rest so a long frame does not make the next one longer. Returns the steps taken
+	unsigned int advance(double time, double stepSeconds, unsigned int maxSteps = 4, unsigned int threads = 0);
+
+	size_t size() const { return positionX.size(); }
+	double time() const { return simulatedTime; }
+
+	// Model matrices of the boids whose bounding sphere, radius in model units, is
+	// inside the frustum of viewProjection. The model is turned from facing +z to
+	// the flight direction after modelRotation and scaled by scale
+	void writeTransforms(const glm::mat4& viewProjection, const glm::mat4& modelRotation, float scale, float radius,
+		std::vector<glm::mat4>& transforms, unsigned int threads = 0);
+
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> velocityX, velocityY, velocityZ;
+
+private:
+	// Bucket of the grid cell a position falls in
+	uint32_t cellOf(float x, float y, float z) const;
+	void sortByCell(unsigned int threads);
+	int neighbourRanges(int cx, int cy, int cz, uint32_t from[18], uint32_t to[18]) const;
+
+	FlockSettings settings;
+	double simulatedTime = 0.0;
+	float cellScale = 0.5f;
+	uint32_t bucketMask = 0;
+
+	// Bucket of every boid, then the first boid of every bucket once sorted
+	std::vector<uint32_t> cells;
+	std::vector<uint32_t> bucketStart;
+	// The state sorted by cell, and the next step's written from it
+	std::vector<float> sortedX, sortedY, sortedZ;
+	std::vector<float> sortedVX, sortedVY, sortedVZ;
+
+	// Frustum culling writes each fixed size chunk of boids at the offset of its chunk
+	std::vector<uint8_t> visible;
+	std::vector<size_t> chunkOffsets;
+};
+
+#endif
@@ -1,9 +1,11 @@
 #version 330 core
+// Features are #defined after the version line, see shaders::Permutations
 out vec3 color;
 
 in vec3 FragPos;  
 in vec3 Normal;  
 in vec2 UV;
+in float ViewDepth;
   
 uniform vec3 lightPos; 
 uniform vec3 viewPos;
@@ -11,6 +13,80 @@ uniform vec3 lightColor;
 
 uniform sampler2D texture1;
 
+// Material
+#ifdef SPECULAR
+uniform sampler2D specularMap;
+uniform vec3 specularColor;
+uniform float shininess;
+#endif
+
+#ifdef SHADOWS
+// Depth cube maps around the main light (see shadow.h): the static casters and the
+// moving ones. shadowParams has the face depth as x - y / distance, and the size
+// of a texel at unit distance
+uniform samplerCubeShadow staticShadow;
+uniform samplerCubeShadow dynamicShadow;
+uniform vec3 shadowParams;
+
+// Fraction of the main light reaching this fragment
+float shadow(vec3 norm)
+{
+    // Looked up a texel and a half off the surface, against acne
+    vec3 toFragment = FragPos - lightPos;
+    vec3 axes = abs(toFragment);
+    float distance = max(axes.x, max(axes.y, axes.z));
+    toFragment += norm * (1.5 * shadowParams.z * distance);
+    axes = abs(toFragment);
+    distance = max(axes.x, max(axes.y, axes.z));
+    float depth = shadowParams.x - shadowParams.y / (distance * 0.998);
+    return min(texture(staticShadow, vec4(toFragment, depth)), texture(dynamicShadow, vec4(toFragment, depth)));
+}
+#endif
+
+#ifdef POINT_LIGHTS
+// Point lights sorted into screen tiles and depth slices (see lightcluster.h).
+// Each light is two texels, position and radius then colour. Each cluster has
+// the first index and count of its lights. The bases are where this frame starts.
+// The grid size is defined by the program from LightClusters' constants
+#if !defined(CLUSTER_TILES_X) || !defined(CLUSTER_TILES_Y) || !defined(CLUSTER_SLICES)
+#error The cluster grid size is not defined
+#endif
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterBase;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepth;
+
+// Diffuse and specular light of the point lights reaching this fragment's cluster
+vec3 pointLights(vec3 norm, vec3 viewDir)
+{
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int slice = clamp(int(log(max(ViewDepth, 1e-4)) * clusterDepth.x + clusterDepth.y), 0, CLUSTER_SLICES - 1);
+    uvec2 range = texelFetch(clusterRanges, clusterBase.y + (slice * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int light = int(texelFetch(clusterIndices, clusterBase.z + int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(clusterLights, clusterBase.x + light * 2);
+        vec3 radiance = texelFetch(clusterLights, clusterBase.x + light * 2 + 1).rgb;
+
+        vec3 toLight = positionRadius.xyz - FragPos;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - distance / positionRadius.w, 0.0, 1.0);
+        vec3 lightDir = toLight / max(distance, 1e-4);
+
+        vec3 lit = vec3(max(dot(norm, lightDir), 0.0));
+#ifdef SPECULAR
+        lit += pow(max(dot(viewDir, reflect(-lightDir, norm)), 0.0), shininess) * specularColor * texture(specularMap, UV).rgb;
+#endif
+        result += lit * radiance * falloff * falloff;
+    }
+    return result;
+}
+#endif
+
 void main()
 {
     // Ambient
@@ -23,12 +99,21 @@ void main()
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = diff * lightColor;
     
-    // Specular
-    float specularStrength = 0.5f;
+    vec3 direct = diffuse;
     vec3 viewDir = normalize(viewPos - FragPos);
+#ifdef SPECULAR
+    // Specular
     vec3 reflectDir = reflect(-lightDir, norm);  
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;  
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    direct += specularColor * texture(specularMap, UV).rgb * spec * lightColor;  
+#endif
+#ifdef SHADOWS
+    direct *= shadow(norm);
+#endif
+    vec3 light = ambient + direct;
+#ifdef POINT_LIGHTS
+    light += pointLights(norm, viewDir);
+#endif
     vec3 myColor = texture(texture1, UV).rgb;
-    color = (ambient + diffuse + specular) * myColor;
+    color = light * myColor;
 } 
\ No newline at end of file
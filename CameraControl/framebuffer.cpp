@@ -0,0 +1,53 @@
+#include <iostream>
+
+#include "framebuffer.h"
+
+bool createFramebuffer(Framebuffer& target, int width, int height)
+{
+	destroyFramebuffer(target);
+
+	target.width = width;
+	target.height = height;
+
+	glGenTextures(1, &target.color);
+	glBindTexture(GL_TEXTURE_2D, target.color);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &target.depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &target.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::FRAMEBUFFER::INCOMPLETE 0x" << std::hex << status << std::dec << std::endl;
+		destroyFramebuffer(target);
+		return false;
+	}
+	return true;
+}
+
+void destroyFramebuffer(Framebuffer& target)
+{
+	if (target.fbo)
+		glDeleteFramebuffers(1, &target.fbo);
+	if (target.color)
+		glDeleteTextures(1, &target.color);
+	if (target.depth)
+		glDeleteRenderbuffers(1, &target.depth);
+
+	target = Framebuffer();
+}
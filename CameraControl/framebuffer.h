@@ -0,0 +1,22 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// An offscreen render target with a colour texture and a depth renderbuffer
+struct Framebuffer
+{
+	GLuint fbo = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+	int width = 0;
+	int height = 0;
+};
+
+// Create (or recreate) the render target at the given size,
+// returns false if the driver reports the framebuffer incomplete
+bool createFramebuffer(Framebuffer& target, int width, int height);
+void destroyFramebuffer(Framebuffer& target);
+
+#endif
@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <iostream>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+
+static bool hasExtension(const std::string& path, const char* extension)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string found = path.substr(dot + 1);
+	for (size_t i = 0; i < found.size(); i++)
+		found[i] = (char)tolower((unsigned char)found[i]);
+	return found == extension;
+}
+
+// 32 bit BGRA with the origin flag set so rows are stored top first
+static bool writeTGA(FILE* file, unsigned int width, unsigned int height, const unsigned char* rgba)
+{
+	unsigned char header[18] = {};
+	header[2] = 2;
+	header[12] = (unsigned char)(width & 255);
+	header[13] = (unsigned char)(width >> 8);
+	header[14] = (unsigned char)(height & 255);
+	header[15] = (unsigned char)(height >> 8);
+	header[16] = 32;
+	header[17] = 0x28;
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header))
+		return false;
+
+	std::vector<unsigned char> row(width * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const unsigned char* source = rgba + (size_t)y * width * 4;
+		for (unsigned int x = 0; x < width; x++)
+		{
+			row[x * 4] = source[x * 4 + 2];
+			row[x * 4 + 1] = source[x * 4 + 1];
+			row[x * 4 + 2] = source[x * 4];
+			row[x * 4 + 3] = source[x * 4 + 3];
+		}
+		if (fwrite(&row[0], 1, row.size(), file) != row.size())
+			return false;
+	}
+	return true;
+}
+
+static bool writePPM(FILE* file, unsigned int width, unsigned int height, const unsigned char* rgba)
+{
+	if (fprintf(file, "P6\n%u %u\n255\n", width, height) < 0)
+		return false;
+
+	std::vector<unsigned char> row(width * 3);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const unsigned char* source = rgba + (size_t)y * width * 4;
+		for (unsigned int x = 0; x < width; x++)
+		{
+			row[x * 3] = source[x * 4];
+			row[x * 3 + 1] = source[x * 4 + 1];
+			row[x * 3 + 2] = source[x * 4 + 2];
+		}
+		if (fwrite(&row[0], 1, row.size(), file) != row.size())
+			return false;
+	}
+	return true;
+}
+
+// Bits go out least significant first, the way deflate packs them
+struct BitWriter
+{
+	std::vector<unsigned char>& out;
+	uint32_t bits;
+	int count;
+
+	void put(uint32_t value, int length)
+	{
+		bits |= value << count;
+		count += length;
+		while (count >= 8)
+		{
+			out.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	// Huffman codes are defined most significant bit first
+	void putCode(uint32_t code, int length)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < length; i++)
+			reversed |= ((code >> i) & 1) << (length - 1 - i);
+		put(reversed, length);
+	}
+
+	void flush()
+	{
+		if (count > 0)
+			out.push_back((unsigned char)bits);
+		bits = 0;
+		count = 0;
+	}
+};
+
+// Literal or length symbol in deflate's fixed Huffman code
+static void putFixedSymbol(BitWriter& writer, unsigned int symbol)
+{
+	if (symbol < 144)
+		writer.putCode(0x30 + symbol, 8);
+	else if (symbol < 256)
+		writer.putCode(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		writer.putCode(symbol - 256, 7);
+	else
+		writer.putCode(0xc0 + symbol - 280, 8);
+}
+
+static const unsigned short LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const unsigned char DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// zlib stream of one deflate block with the fixed Huffman code. Matches are found
+// greedily through a hash of the next three bytes, the last position of each
+// hash only, which is enough for rendered images with their long flat runs
+static void deflate(const std::vector<unsigned char>& data, std::vector<unsigned char>& out)
+{
+	const int HASH_BITS = 15;
+	const size_t WINDOW = 32768;
+	const size_t MAX_MATCH = 258;
+
+	out.push_back(0x78);
+	out.push_back(0x01);
+	BitWriter writer = { out, 0, 0 };
+	writer.put(1, 1);	// last block
+	writer.put(1, 2);	// fixed Huffman code
+
+	std::vector<uint32_t> head((size_t)1 << HASH_BITS, UINT32_MAX);
+	size_t size = data.size();
+	size_t position = 0;
+	while (position < size)
+	{
+		size_t length = 0, distance = 0;
+		if (position + 3 <= size)
+		{
+			uint32_t hash = ((data[position] << 16 | data[position + 1] << 8 | data[position + 2]) * 2654435761u) >> (32 - HASH_BITS);
+			uint32_t candidate = head[hash];
+			head[hash] = (uint32_t)position;
+			if (candidate != UINT32_MAX && position - candidate <= WINDOW)
+			{
+				size_t limit = std::min(MAX_MATCH, size - position);
+				while (length < limit && data[candidate + length] == data[position + length])
+					length++;
+				distance = position - candidate;
+			}
+		}
+
+		if (length < 3)
+		{
+			putFixedSymbol(writer, data[position]);
+			position++;
+			continue;
+		}
+
+		int code = 28;
+		while (LENGTH_BASE[code] > length)
+			code--;
+		putFixedSymbol(writer, 257 + code);
+		writer.put((uint32_t)(length - LENGTH_BASE[code]), LENGTH_EXTRA[code]);
+		code = 29;
+		while (DISTANCE_BASE[code] > distance)
+			code--;
+		writer.putCode(code, 5);
+		writer.put((uint32_t)(distance - DISTANCE_BASE[code]), DISTANCE_EXTRA[code]);
+
+		// Later matches can start inside this one
+		size_t end = position + length;
+		for (position++; position < end && position + 3 <= size; position++)
+			head[((data[position] << 16 | data[position + 1] << 8 | data[position + 2]) * 2654435761u) >> (32 - HASH_BITS)] = (uint32_t)position;
+		position = end;
+	}
+	putFixedSymbol(writer, 256);
+	writer.flush();
+
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < size; i++)
+	{
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	uint32_t adler = b << 16 | a;
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back((unsigned char)(adler >> shift));
+}
+
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+	static uint32_t table[256];
+	static bool tableReady = false;
+	if (!tableReady)
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		tableReady = true;
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 255] ^ (crc >> 8);
+	return ~crc;
+}
+
+static bool writeChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+{
+	unsigned char length[4] = { (unsigned char)(data.size() >> 24), (unsigned char)(data.size() >> 16),
+		(unsigned char)(data.size() >> 8), (unsigned char)data.size() };
+	uint32_t crc = crc32((const unsigned char*)type, 4);
+	crc = crc32(data.data(), data.size(), crc);
+	unsigned char crcBytes[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc };
+	return fwrite(length, 1, 4, file) == 4 && fwrite(type, 1, 4, file) == 4
+		&& fwrite(data.data(), 1, data.size(), file) == data.size() && fwrite(crcBytes, 1, 4, file) == 4;
+}
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	return pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+}
+
+// 8 bit RGB. Every row gets the filter whose output has the smallest sum of
+// absolute values, the usual guess at which compresses best
+static bool writePNG(FILE* file, unsigned int width, unsigned int height, const unsigned char* rgba)
+{
+	static const unsigned char SIGNATURE[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	if (fwrite(SIGNATURE, 1, 8, file) != 8)
+		return false;
+
+	std::vector<unsigned char> header(13, 0);
+	for (int i = 0; i < 4; i++)
+	{
+		header[i] = (unsigned char)(width >> (24 - i * 8));
+		header[4 + i] = (unsigned char)(height >> (24 - i * 8));
+	}
+	header[8] = 8;	// bits per channel
+	header[9] = 2;	// RGB
+	if (!writeChunk(file, "IHDR", header))
+		return false;
+
+	size_t rowBytes = (size_t)width * 3;
+	std::vector<unsigned char> filtered;
+	filtered.reserve((rowBytes + 1) * height);
+	std::vector<unsigned char> previous(rowBytes, 0), current(rowBytes);
+	std::vector<unsigned char> candidates[5];
+	for (int f = 0; f < 5; f++)
+		candidates[f].resize(rowBytes);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		const unsigned char* source = rgba + (size_t)y * width * 4;
+		for (unsigned int x = 0; x < width; x++)
+			memcpy(&current[x * 3], source + x * 4, 3);
+
+		int best = 0;
+		long bestSum = -1;
+		for (int f = 0; f < 5; f++)
+		{
+			long sum = 0;
+			for (size_t i = 0; i < rowBytes; i++)
+			{
+				int left = i >= 3 ? current[i - 3] : 0;
+				int up = previous[i];
+				int upLeft = i >= 3 ? previous[i - 3] : 0;
+				int predicted = f == 0 ? 0 : f == 1 ? left : f == 2 ? up : f == 3 ? (left + up) / 2 : paeth(left, up, upLeft);
+				unsigned char value = (unsigned char)(current[i] - predicted);
+				candidates[f][i] = value;
+				sum += value < 128 ? value : 256 - value;
+			}
+			if (bestSum < 0 || sum < bestSum)
+			{
+				best = f;
+				bestSum = sum;
+			}
+		}
+		filtered.push_back((unsigned char)best);
+		filtered.insert(filtered.end(), candidates[best].begin(), candidates[best].end());
+		previous.swap(current);
+	}
+
+	std::vector<unsigned char> compressed;
+	deflate(filtered, compressed);
+	return writeChunk(file, "IDAT", compressed) && writeChunk(file, "IEND", std::vector<unsigned char>());
+}
+
+bool writeImage(const std::string& path, unsigned int width, unsigned int height, const unsigned char* rgba)
+{
+	bool png = hasExtension(path, "png");
+	bool tga = hasExtension(path, "tga");
+	if (!png && !tga && !hasExtension(path, "ppm"))
+	{
+		std::cout << "ERROR::IMAGE::UNKNOWN_FORMAT " << path << std::endl;
+		return false;
+	}
+	if (tga && (width > 65535 || height > 65535))
+		return false;
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "ERROR::IMAGE::NOT_WRITTEN " << path << std::endl;
+		return false;
+	}
+	bool written = png ? writePNG(file, width, height, rgba) : tga ? writeTGA(file, width, height, rgba) : writePPM(file, width, height, rgba);
+	written = fclose(file) == 0 && written;
+	if (!written)
+		std::cout << "ERROR::IMAGE::NOT_WRITTEN " << path << std::endl;
+	return written;
+}
+
+std::string numberedPath(const std::string& path, unsigned int number)
+{
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), "_%04u", number);
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return path + suffix;
+	return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+void convertToYUV420(unsigned int width, unsigned int height, const unsigned char* rgba, std::vector<unsigned char>& yuv)
+{
+	unsigned int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+	yuv.resize((size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+	unsigned char* luma = &yuv[0];
+	unsigned char* u = luma + (size_t)width * height;
+	unsigned char* v = u + (size_t)chromaWidth * chromaHeight;
+
+	// Weights scaled by 2^16
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		const unsigned char* p = rgba + i * 4;
+		luma[i] = (unsigned char)((19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768) >> 16);
+	}
+	for (unsigned int cy = 0; cy < chromaHeight; cy++)
+	{
+		for (unsigned int cx = 0; cx < chromaWidth; cx++)
+		{
+			int r = 0, g = 0, b = 0, count = 0;
+			for (unsigned int y = cy * 2; y < cy * 2 + 2 && y < height; y++)
+			{
+				for (unsigned int x = cx * 2; x < cx * 2 + 2 && x < width; x++)
+				{
+					const unsigned char* p = rgba + ((size_t)y * width + x) * 4;
+					r += p[0];
+					g += p[1];
+					b += p[2];
+					count++;
+				}
+			}
+			int cb = (-11059 * r - 21709 * g + 32768 * b) / count;
+			int cr = (32768 * r - 27439 * g - 5329 * b) / count;
+			size_t index = (size_t)cy * chromaWidth + cx;
+			u[index] = (unsigned char)std::min(255, std::max(0, 128 + ((cb + 32768) >> 16)));
+			v[index] = (unsigned char)std::min(255, std::max(0, 128 + ((cr + 32768) >> 16)));
+		}
+	}
+}
+
+bool Y4MWriter::open(const std::string& path, unsigned int width, unsigned int height, unsigned int fps)
+{
+	close();
+	file = fopen(path.c_str(), "wb");
+	if (!file || fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps) < 0)
+	{
+		std::cout << "ERROR::IMAGE::NOT_WRITTEN " << path << std::endl;
+		close();
+		return false;
+	}
+	frameWidth = width;
+	frameHeight = height;
+	return true;
+}
+
+bool Y4MWriter::writeFrame(const std::vector<unsigned char>& yuv)
+{
+	size_t chroma = (size_t)((frameWidth + 1) / 2) * ((frameHeight + 1) / 2);
+	if (!file || yuv.size() != (size_t)frameWidth * frameHeight + 2 * chroma)
+		return false;
+	return fwrite("FRAME\n", 1, 6, file) == 6 && fwrite(yuv.data(), 1, yuv.size(), file) == yuv.size();
+}
+
+void Y4MWriter::close()
+{
+	if (file)
+		fclose(file);
+	file = NULL;
+	frameWidth = frameHeight = 0;
+}
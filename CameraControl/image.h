@@ -0,0 +1,42 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Write 8 bit RGBA pixels, top row first, to an image file. The extension picks
+// the format: .png (deflate compressed, alpha dropped), .tga (uncompressed, alpha
+// kept) or .ppm (binary, alpha dropped). Returns false for other extensions or if
+// the file cannot be written
+bool writeImage(const std::string& path, unsigned int width, unsigned int height, const unsigned char* rgba);
+
+// The path of one image of a numbered series: out.png becomes out_0007.png
+std::string numberedPath(const std::string& path, unsigned int number);
+
+// Convert 8 bit RGBA, top row first, to planar YUV 4:2:0 with full range BT.601,
+// the layout of Y4M's C420jpeg frames. Each chroma sample averages 2x2 pixels
+void convertToYUV420(unsigned int width, unsigned int height, const unsigned char* rgba, std::vector<unsigned char>& yuv);
+
+// A Y4M video, raw frames that ffmpeg and most players read directly
+class Y4MWriter
+{
+public:
+	~Y4MWriter() { close(); }
+
+	bool open(const std::string& path, unsigned int width, unsigned int height, unsigned int fps);
+	// Append a frame converted by convertToYUV420 at the video's size
+	bool writeFrame(const std::vector<unsigned char>& yuv);
+	void close();
+
+	bool isOpen() const { return file != NULL; }
+	unsigned int width() const { return frameWidth; }
+	unsigned int height() const { return frameHeight; }
+
+private:
+	FILE* file = NULL;
+	unsigned int frameWidth = 0;
+	unsigned int frameHeight = 0;
+};
+
+#endif
@@ -0,0 +1,187 @@
+// Work stealing job scheduler with one queue per thread
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "jobs.h"
+
+namespace jobs
+{
+	struct Job
+	{
+		JobFunction function;
+		void* data;
+		size_t begin;
+		size_t end;
+		Counter* counter;
+	};
+
+	// The owner works on the back, thieves take from the front so they get the
+	// oldest and usually largest pieces of work
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<Job> jobs;
+	};
+
+	// Queue 0 belongs to the threads outside the pool, worker i owns queue i + 1
+	static std::vector<WorkQueue*> queues;
+	static std::vector<std::thread> workers;
+	static std::mutex startLock;
+	static std::atomic<bool> started(false);
+	static std::atomic<bool> stopping(false);
+
+	// Idle workers sleep until a job is queued
+	static std::atomic<int> queued(0);
+	static std::mutex sleepLock;
+	static std::condition_variable wake;
+
+	static thread_local unsigned int queueIndex = 0;
+
+	static bool popOwn(Job& job)
+	{
+		WorkQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (queue.jobs.empty())
+			return false;
+		job = queue.jobs.back();
+		queue.jobs.pop_back();
+		return true;
+	}
+
+	static bool steal(Job& job)
+	{
+		size_t count = queues.size();
+		for (size_t i = 1; i < count; i++)
+		{
+			WorkQueue& queue = *queues[(queueIndex + i) % count];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (queue.jobs.empty())
+				continue;
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	// Run one queued job if there is any
+	static bool runOne()
+	{
+		Job job;
+		if (!popOwn(job) && !steal(job))
+			return false;
+
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		job.function(job.data, job.begin, job.end);
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	static void workerLoop(unsigned int index)
+	{
+		queueIndex = index;
+		while (true)
+		{
+			if (runOne())
+				continue;
+
+			std::unique_lock<std::mutex> guard(sleepLock);
+			wake.wait(guard, []() { return queued.load() > 0 || stopping.load(); });
+			if (stopping.load() && queued.load() == 0)
+				return;
+		}
+	}
+
+	void init(unsigned int threads)
+	{
+		std::lock_guard<std::mutex> guard(startLock);
+		if (started.load())
+			return;
+
+		if (threads == 0)
+		{
+			unsigned int hardware = std::thread::hardware_concurrency();
+			threads = hardware > 1 ? hardware - 1 : 1;
+		}
+
+		stopping = false;
+		queues.push_back(new WorkQueue());
+		for (unsigned int i = 0; i < threads; i++)
+			queues.push_back(new WorkQueue());
+		for (unsigned int i = 0; i < threads; i++)
+			workers.emplace_back(workerLoop, i + 1);
+		started = true;
+	}
+
+	void shutdown()
+	{
+		std::lock_guard<std::mutex> guard(startLock);
+		if (!started.load())
+			return;
+
+		{
+			std::lock_guard<std::mutex> sleepGuard(sleepLock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+		workers.clear();
+
+		// Jobs queued by threads outside the pool after the workers left
+		while (runOne())
+			;
+
+		for (size_t i = 0; i < queues.size(); i++)
+			delete queues[i];
+		queues.clear();
+		started = false;
+	}
+
+	// Stops the workers at exit if shutdown was never called
+	static struct ShutdownAtExit
+	{
+		~ShutdownAtExit() { shutdown(); }
+	} shutdownAtExit;
+
+	unsigned int threadCount()
+	{
+		if (!started.load(std::memory_order_acquire))
+			init();
+		return (unsigned int)queues.size();
+	}
+
+	void run(JobFunction function, void* data, size_t begin, size_t end, Counter& counter)
+	{
+		if (!started.load(std::memory_order_acquire))
+			init();
+
+		Job job = { function, data, begin, end, &counter };
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			WorkQueue& queue = *queues[queueIndex];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			queue.jobs.push_back(job);
+		}
+		queued.fetch_add(1, std::memory_order_relaxed);
+
+		// Taking the lock makes sure a worker about to sleep sees the new job
+		{
+			std::lock_guard<std::mutex> guard(sleepLock);
+		}
+		wake.notify_one();
+	}
+
+	void wait(Counter& counter)
+	{
+		while (!counter.done())
+		{
+			if (!runOne())
+				std::this_thread::yield();
+		}
+	}
+}
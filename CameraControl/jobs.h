@@ -0,0 +1,41 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <stddef.h>
+
+// Work stealing job scheduler. Every worker thread owns a queue, it takes its own
+// newest job first and steals the oldest job of another queue when it runs dry.
+// Threads outside the pool share the first queue. Waiting on a counter runs jobs
+// instead of blocking, so any thread can wait on work it started
+namespace jobs
+{
+	// A job gets the data pointer and the range it was started with
+	typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+	// Number of jobs started against it that have not finished yet
+	struct Counter
+	{
+		std::atomic<int> pending;
+
+		Counter() : pending(0) {}
+		bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+	};
+
+	// Start the workers, threads = 0 uses one per hardware thread less the caller,
+	// but at least one. Starts on first use if not called
+	void init(unsigned int threads = 0);
+	// Finish the queued jobs and stop the workers
+	void shutdown();
+
+	// Workers plus the calling thread
+	unsigned int threadCount();
+
+	// Queue function(data, begin, end), counter is decremented once it has run
+	void run(JobFunction function, void* data, size_t begin, size_t end, Counter& counter);
+
+	// Run queued jobs until every job started against counter has finished
+	void wait(Counter& counter);
+}
+
+#endif
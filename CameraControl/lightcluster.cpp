@@ -0,0 +1,200 @@
+// Clustered light assignment
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "lightcluster.h"
+#include "parallel.h"
+#include "xorshift.h"
+
+void scatterLights(std::vector<PointLight>& lights, unsigned int count, unsigned int seed,
+	const glm::vec3& min, const glm::vec3& max)
+{
+	XorShift32 random(seed);
+
+	lights.reserve(lights.size() + count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		PointLight light;
+		light.position = min + (max - min) * glm::vec3(random(), random(), random());
+		light.radius = 1.5f + 1.5f * random();
+		// Warm lantern colours
+		light.color = glm::vec3(1.0f, 0.55f + 0.35f * random(), 0.2f + 0.3f * random());
+		light.intensity = 1.0f + random();
+		lights.push_back(light);
+	}
+}
+
+void LightClusters::setProjection(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	boundsProjection = projection;
+	bounded = true;
+	scaleX = projection[0][0];
+	scaleY = projection[1][1];
+	nearDepth = nearPlane;
+	farDepth = farPlane;
+	depthScale = SLICES / logf(farDepth / nearDepth);
+	depthBias = -logf(nearDepth) * depthScale;
+
+	boundsMin.resize(COUNT);
+	boundsMax.resize(COUNT);
+	for (int s = 0; s < SLICES; s++)
+	{
+		float d0 = nearDepth * powf(farDepth / nearDepth, (float)s / SLICES);
+		float d1 = nearDepth * powf(farDepth / nearDepth, (float)(s + 1) / SLICES);
+		for (int y = 0; y < TILES_Y; y++)
+		{
+			float ny0 = -1.0f + 2.0f * y / TILES_Y;
+			float ny1 = -1.0f + 2.0f * (y + 1) / TILES_Y;
+			for (int x = 0; x < TILES_X; x++)
+			{
+				float nx0 = -1.0f + 2.0f * x / TILES_X;
+				float nx1 = -1.0f + 2.0f * (x + 1) / TILES_X;
+
+				// The tile's edges at both ends of the slice, view space looks down -z
+				int cluster = (s * TILES_Y + y) * TILES_X + x;
+				boundsMin[cluster] = glm::vec3(std::min(nx0 * d0, nx0 * d1) / scaleX, std::min(ny0 * d0, ny0 * d1) / scaleY, -d1);
+				boundsMax[cluster] = glm::vec3(std::max(nx1 * d0, nx1 * d1) / scaleX, std::max(ny1 * d0, ny1 * d1) / scaleY, -d0);
+			}
+		}
+	}
+}
+
+int LightClusters::sliceOf(float depth) const
+{
+	if (depth <= nearDepth)
+		return 0;
+	return std::min(SLICES - 1, (int)(logf(depth) * depthScale + depthBias));
+}
+
+// Tile of a normalized device coordinate, clamped to the grid
+static int tileOf(float ndc, int tiles)
+{
+	int tile = (int)floorf((ndc * 0.5f + 0.5f) * tiles);
+	return std::max(0, std::min(tiles - 1, tile));
+}
+
+void LightClusters::build(const std::vector<PointLight>& lights, const glm::mat4& view, unsigned int threads)
+{
+	lightTexels.resize(lights.size() * 2);
+	spans.resize(lights.size());
+
+	// Find the block of clusters around each light
+	parallelFor(lights.size(), 256, [this, &lights, &view](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const PointLight& light = lights[i];
+			lightTexels[i * 2] = glm::vec4(light.position, light.radius);
+			lightTexels[i * 2 + 1] = glm::vec4(light.color * light.intensity, 0.0f);
+
+			LightSpan& span = spans[i];
+			span.center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+			span.radius = light.radius;
+
+			float depthNear = -span.center.z - light.radius;
+			float depthFar = -span.center.z + light.radius;
+			if (depthFar <= nearDepth || depthNear >= farDepth)
+			{
+				// Wholly behind the camera or beyond the far plane
+				span.s0 = 1;
+				span.s1 = 0;
+				continue;
+			}
+			span.s0 = sliceOf(depthNear);
+			span.s1 = sliceOf(depthFar);
+
+			// Project the light's bounding box, x / depth is largest at one of its depth ends
+			depthNear = std::max(depthNear, nearDepth);
+			float x0 = span.center.x - light.radius, x1 = span.center.x + light.radius;
+			float y0 = span.center.y - light.radius, y1 = span.center.y + light.radius;
+			span.x0 = tileOf(std::min(x0 / depthNear, x0 / depthFar) * scaleX, TILES_X);
+			span.x1 = tileOf(std::max(x1 / depthNear, x1 / depthFar) * scaleX, TILES_X);
+			span.y0 = tileOf(std::min(y0 / depthNear, y0 / depthFar) * scaleY, TILES_Y);
+			span.y1 = tileOf(std::max(y1 / depthNear, y1 / depthFar) * scaleY, TILES_Y);
+		}
+	}, threads);
+
+	// Each slice sorts its own clusters' lights, so threads never share a cluster
+	slicePairs.resize(SLICES);
+	sliceIndices.resize(SLICES);
+	ranges.resize(COUNT * 2);
+	parallelFor(SLICES, 1, [this](size_t begin, size_t end)
+	{
+		const int clustersPerSlice = TILES_X * TILES_Y;
+		for (size_t s = begin; s < end; s++)
+		{
+			std::vector<uint32_t>& pairs = slicePairs[s];
+			pairs.clear();
+			for (size_t i = 0; i < spans.size(); i++)
+			{
+				const LightSpan& span = spans[i];
+				if ((int)s < span.s0 || (int)s > span.s1)
+					continue;
+				for (int y = span.y0; y <= span.y1; y++)
+				{
+					for (int x = span.x0; x <= span.x1; x++)
+					{
+						// Keep the cluster only if the sphere reaches its box
+						int local = y * TILES_X + x;
+						int cluster = (int)s * clustersPerSlice + local;
+						glm::vec3 closest = glm::clamp(span.center, boundsMin[cluster], boundsMax[cluster]);
+						glm::vec3 offset = closest - span.center;
+						if (glm::dot(offset, offset) > span.radius * span.radius)
+							continue;
+						pairs.push_back((uint32_t)local);
+						pairs.push_back((uint32_t)i);
+					}
+				}
+			}
+
+			// Counting sort by cluster, ranges start relative to the slice
+			uint32_t* sliceRanges = &ranges[s * clustersPerSlice * 2];
+			for (int c = 0; c < clustersPerSlice; c++)
+				sliceRanges[c * 2 + 1] = 0;
+			for (size_t p = 0; p < pairs.size(); p += 2)
+				sliceRanges[pairs[p] * 2 + 1]++;
+			uint32_t first = 0;
+			for (int c = 0; c < clustersPerSlice; c++)
+			{
+				sliceRanges[c * 2] = first;
+				first += sliceRanges[c * 2 + 1];
+			}
+
+			std::vector<uint32_t>& sorted = sliceIndices[s];
+			sorted.resize(first);
+			for (size_t p = 0; p < pairs.size(); p += 2)
+			{
+				uint32_t* range = &sliceRanges[pairs[p] * 2];
+				sorted[range[0]++] = pairs[p + 1];
+			}
+			// Filling moved every start to the end of its cluster
+			for (int c = 0; c < clustersPerSlice; c++)
+				sliceRanges[c * 2] -= sliceRanges[c * 2 + 1];
+		}
+	}, threads);
+
+	// Put the slices one after the other
+	size_t total = 0;
+	for (int s = 0; s < SLICES; s++)
+		total += sliceIndices[s].size();
+	indices.resize(total);
+
+	maxLights = 0;
+	uint32_t base = 0;
+	for (int s = 0; s < SLICES; s++)
+	{
+		const std::vector<uint32_t>& sorted = sliceIndices[s];
+		if (!sorted.empty())
+			memcpy(&indices[base], &sorted[0], sorted.size() * sizeof(uint32_t));
+
+		uint32_t* sliceRanges = &ranges[s * TILES_X * TILES_Y * 2];
+		for (int c = 0; c < TILES_X * TILES_Y; c++)
+		{
+			sliceRanges[c * 2] += base;
+			maxLights = std::max(maxLights, sliceRanges[c * 2 + 1]);
+		}
+		base += (uint32_t)sorted.size();
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef LIGHTCLUSTER_H
+#define LIGHTCLUSTER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// A point light in world space, its reach fades out to nothing at radius
+struct PointLight
+{
+	glm::vec3 position;
+	float radius;
+	glm::vec3 color;
+	float intensity;
+};
+
+// Append count lanterns placed at random in the box [min, max]. The same seed
+// always places the same lights
+void scatterLights(std::vector<PointLight>& lights, unsigned int count, unsigned int seed,
+	const glm::vec3& min, const glm::vec3& max);
+
+// The view frustum cut into TILES_X by TILES_Y screen tiles and SLICES depth slices
+// spaced exponentially, each cluster listing the lights that reach into it. A
+// fragment only shades the lights of its own cluster, so its cost follows the
+// lights around it rather than the lights in the scene
+class LightClusters
+{
+public:
+	static const int TILES_X = 16;
+	static const int TILES_Y = 16;
+	static const int SLICES = 24;
+	static const int COUNT = TILES_X * TILES_Y * SLICES;
+
+	// Work out the cluster bounds for a symmetric perspective projection, only
+	// needed again when the projection changes
+	void setProjection(const glm::mat4& projection, float nearPlane, float farPlane);
+	bool hasProjection(const glm::mat4& projection) const { return bounded && projection == boundsProjection; }
+
+	// Assign the lights to the clusters seen from view, spread over threads by
+	// depth slice (0 uses every scheduler thread)
+	void build(const std::vector<PointLight>& lights, const glm::mat4& view, unsigned int threads = 0);
+
+	// Depth slice of a view depth d is log(d) * sliceScale + sliceBias
+	float sliceScale() const { return depthScale; }
+	float sliceBias() const { return depthBias; }
+
+	// Two texels per light, position and radius, then colour times intensity
+	std::vector<glm::vec4> lightTexels;
+	// First index and light count per cluster, x fastest then y then slice
+	std::vector<uint32_t> ranges;
+	// Light indices of every cluster one after the other
+	std::vector<uint32_t> indices;
+	// Most lights any cluster ended up with
+	unsigned int maxLights = 0;
+
+private:
+	// Clusters a light can touch: tiles [x0, x1] and [y0, y1], slices [s0, s1]
+	struct LightSpan
+	{
+		glm::vec3 center;
+		float radius;
+		int x0, x1, y0, y1, s0, s1;
+	};
+
+	int sliceOf(float depth) const;
+
+	// View space bounds of each cluster
+	std::vector<glm::vec3> boundsMin;
+	std::vector<glm::vec3> boundsMax;
+	glm::mat4 boundsProjection;
+	bool bounded = false;
+	float scaleX = 1.0f, scaleY = 1.0f;
+	float nearDepth = 0.1f, farDepth = 100.0f;
+	float depthScale = 0.0f, depthBias = 0.0f;
+
+	std::vector<LightSpan> spans;
+	// Per slice (cluster, light) pairs and the indices sorted out of them
+	std::vector<std::vector<uint32_t> > slicePairs;
+	std::vector<std::vector<uint32_t> > sliceIndices;
+};
+
+#endif
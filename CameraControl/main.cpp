@@ -1,6 +1,15 @@
 // Code adapted from www.learnopengl.com, www.glfw.org
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -14,15 +23,40 @@
 
 #include "shader.h"
 #include "OBJ-Loader.h"
-#include "texture.hpp"
+#include "meshbuffer.h"
+#include "meshsoa.h"
+#include "meshnormals.h"
+#include "material.h"
+#include "drawlist.h"
+#include "meshlet.h"
+#include "profiler.h"
+#include "framebuffer.h"
+#include "benchmark.h"
+#include "scene.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "simclock.h"
+#include "ringbuffer.h"
+#include "lightcluster.h"
+#include "softraster.h"
+#include "image.h"
+#include "pack.h"
+#include "dynres.h"
+#include "capture.h"
+#include "flock.h"
+#include "terrain.h"
+#include "shadow.h"
 
 // Function prototypes
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-void do_movement();
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void do_movement(double seconds);
+void updateCameraFront();
 
-// Window dimensions
+// Window dimensions when it opens, the framebuffer size follows resizes
 const GLuint WIDTH = 640, HEIGHT = 640;
+int framebufferWidth = WIDTH, framebufferHeight = HEIGHT;
 
 // Camera
 glm::vec3 cameraPos = glm::vec3(0.0f, 3.0f, 3.0f);
@@ -34,75 +68,305 @@ GLfloat lastX = WIDTH / 2.0;
 GLfloat lastY = HEIGHT / 2.0;
 bool keys[1024];
 
-// Deltatime
-GLfloat deltaTime = 0.0f;	// Time between current frame and last frame
-GLfloat lastFrame = 0.0f;  	// Time of last frame
+// Simulation steps per second, movement and animation advance in fixed steps
+double simRate = 60.0;
+// Camera position before the last simulation step, rendering interpolates from it
+glm::vec3 previousCameraPos = cameraPos;
 
 // Light attributes
 glm::vec3 lightPos(15.0f, 15.0f, 15.0f);
 
-GLfloat floorVector[] = {
-	// Position data,                    normals,          texture coords
-	-0.131034f, -0.003671f, -1.811131f, 0.0f, -0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-	6.722751f, -0.003671f, -1.811131f, 0.0f, -0.0f, 1.0f, 1.0f, 0.0f, 0.0f,
-	-0.131034f, -0.003671f, -8.664917f, 0.0f, -0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-	6.722751f, -0.003671f, -8.664917f, 0.0f, -0.0f, 1.0f, 1.0f, 1.0f, 0.0f
-};
-
-GLint floorIndices[] = {
-	0, 1, 2,
-	1, 1, 2,
-	3, 1, 2,
-	2, 1, 2,
+// Shadows of the main light (--no-shadows, --shadow-size texels). The cube map of
+// the static casters is only redrawn when the light moves, unless --no-shadow-cache,
+// the moving casters are drawn every frame. F7 turns the light about the scene
+bool shadowsEnabled = true;
+bool shadowCache = true;
+int shadowSize = 1024;
+// Range of the main light's shadows, enough for the objects around it. Terrain
+// further out is lit without shadows
+const GLfloat SHADOW_NEAR = 0.5f, SHADOW_FAR = 150.0f;
+const GLint STATIC_SHADOW_UNIT = 5;
+const GLint DYNAMIC_SHADOW_UNIT = 6;
+PointShadow shadow;
+GpuFrameTimer gpuShadowTimer;
+// Objects moved by an animation, indexed like the scene's objects
+std::vector<unsigned char> objectAnimated;
+// CPU milliseconds the shadow passes of the frame last submitted took to submit,
+// the cube faces they drew and the newest GPU time read back
+double frameShadowMs = 0.0;
+unsigned int frameShadowFaces = 0;
+double frameShadowGpuMs = 0.0;
+bool frameShadowGpuValid = false;
+
+// Point lights on top of the main light, shaded per cluster. --lights sets how many lanterns to scatter
+std::vector<PointLight> pointLights;
+unsigned int pointLightCount = 0;
+
+// Clip planes of the camera. The far plane reaches across the whole default
+// terrain, corner to corner, so the near plane is kept back from the eye to
+// leave the depth buffer some precision in the distance
+const GLfloat NEAR_PLANE = 0.5f, FAR_PLANE = 1500.0f;
+// The light clusters' slices stop well short of the far plane, where the
+// lanterns are. Lights further away than this are not shaded
+const GLfloat CLUSTER_FAR = 150.0f;
+
+// One vertex array per scene mesh
+std::vector<GLuint> VBOs, VAOs, EBOs;
+// Position only copies of the vertex buffers for the depth pre-pass. They share
+// the index buffers, so the culled meshlet ranges apply to both
+std::vector<GLuint> depthVBOs, depthVAOs;
+// Centre of each mesh's bounds, draws are ordered by its view depth
+std::vector<glm::vec3> meshCenters;
+// Distance from each mesh's origin to the farthest corner of its bounds
+std::vector<float> meshReach;
+
+// Programs compile while the first frames are drawn. The shading variants are stood
+// in for by the simple one until they are ready. The depth only program is for the
+// pre-pass, the overdraw one adds up shaded fragments
+shaders::Handle simpleShader, depthShader, overdrawShader;
+// The depth program's instanced variant, for the flock's shadows
+shaders::Handle flockShadowShader = -1;
+bool shadersReady = false;
+
+// Features the shading program is specialised for, bit i #defines name i. Each
+// material is drawn with the variant that leaves out what it does not use
+const unsigned int SHADER_SPECULAR = 1 << 0;
+const unsigned int SHADER_POINT_LIGHTS = 1 << 1;
+const unsigned int SHADER_INSTANCED = 1 << 2;
+const unsigned int SHADER_SHADOWS = 1 << 3;
+const char* const SHADER_FEATURE_NAMES[] = { "SPECULAR", "POINT_LIGHTS", "INSTANCED", "SHADOWS", NULL };
+shaders::Permutations shadingVariants;
+std::vector<shaders::Handle> materialShaders;
+
+// Every shader source loadScene compiles, for asset packs
+const char* const SHADER_FILES[] = { "vert.glsl", "frag.glsl", "simple_frag.glsl", "depth_vert.glsl",
+	"depth_frag.glsl", "overdraw_frag.glsl", "upscale_vert.glsl", "upscale_frag.glsl", NULL };
+
+// Lay down depth first so the shading pass only runs for the nearest fragment of
+// each pixel (--depth-prepass, F3). Without it draws are sorted front to back
+bool depthPrepass = false;
+// Show how many times each pixel is shaded instead of the scene (--overdraw, F4)
+bool showOverdraw = false;
+
+// Dynamic resolution (--frame-budget ms, F5): the scene is drawn to sceneTarget at
+// the scale of the window that holds the GPU frame time budget, then scaled up to
+// the window and sharpened by --sharpen (0 is plain bilinear)
+bool dynamicResolution = false;
+ResolutionController resolution;
+GpuFrameTimer gpuFrameTimer;
+Framebuffer sceneTarget;
+shaders::Handle upscaleShader;
+GLuint upscaleVAO = 0;
+float upscaleSharpness = 0.25f;
+// Pixels drawn in the frame last submitted, and the newest GPU frame time read
+// back with the pixels of its frame, if one came back during that submission
+double frameDrawnPixels = WIDTH * HEIGHT;
+double frameGpuMs = 0.0;
+double frameGpuPixels = 0.0;
+bool frameGpuValid = false;
+
+// Ravens flocking around the tower (--flock count). The flock is stepped while each
+// frame is built, and the ravens in view are drawn with one instanced draw of the
+// raven mesh, their model matrices streamed through a ring buffer
+Flock flock;
+unsigned int flockCount = 0;
+int flockMesh = -1;
+shaders::Handle flockShader = -1, flockOverdrawShader = -1;
+GLuint flockVAO = 0;
+RingBuffer flockInstances;
+// Where the frame's instance matrices start in the ring, the camera's and then those
+// of each shadow face, -1 for the lists that could not be written
+GLintptr flockOffsets[1 + PointShadow::FACES];
+bool flockUploaded = false;
+const float FLOCK_SCALE = 0.1f;
+// The raven model looks up, this levels it for flight
+const glm::mat4 FLOCK_MODEL_ROTATION = glm::rotate(glm::mat4(), glm::radians(30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+// Simulation time and the ravens drawn for the frame last submitted
+double frameFlockMs = 0.0;
+size_t frameFlockInstances = 0;
+
+// Frames read back to images or a video (--capture file, F6) without waiting on the
+// GPU. The benchmark records its measured frames, drawn at --bench-size
+FrameCapture frameCapture;
+std::string capturePath = "capture.y4m";
+int benchWidth = WIDTH, benchHeight = HEIGHT;
+
+// Samples the shading pass wrote, the queries are read back a few frames late
+const int SAMPLE_QUERY_COUNT = PROFILER_FRAME_LATENCY + 1;
+GLuint sampleQueries[SAMPLE_QUERY_COUNT];
+bool sampleQueryPending[SAMPLE_QUERY_COUNT] = {};
+int sampleQueryIndex = 0;
+unsigned long long frameShadedSamples = 0;
+bool frameShadedSamplesValid = false;
+
+// The loaded scene, its objects are drawn every frame. The floor is not an object
+// file but the generated terrain, --terrain sets its size
+Scene scene;
+int floorMesh = -1;
+Terrain terrain;
+TerrainSettings terrainSettings;
+// Terrain chunks and triangles drawn in the frame last submitted
+unsigned int frameTerrainChunks = 0;
+unsigned int frameTerrainTriangles = 0;
+
+// Materials and the one each mesh is drawn with, indexed like the VAOs
+MaterialRegistry materials;
+std::vector<unsigned int> meshMaterial;
+std::vector<std::string> meshDrawNames;
+
+// Binds of the frame last submitted
+StateCache stateCache;
+StateChangeCounts frameStateChanges;
+unsigned int frameUnsortedStateChanges = 0;
+// World matrices rebuilt for the frame last submitted, only the ones below a moving node
+size_t frameTransformUpdates = 0;
+// Light indices over all clusters, and the most any cluster had, in the frame last submitted
+size_t frameLightReferences = 0;
+unsigned int frameMaxClusterLights = 0;
+
+// Per draw uniforms are written to a ring buffer once per frame, the draws
+// only bind their slice to the Object block
+const GLuint OBJECT_BLOCK_BINDING = 0;
+RingBuffer frameUniforms;
+GLint uniformAlignment = 256;
+std::vector<GLintptr> objectOffsets;
+
+// The light lists of every frame go to a ring buffer read through three buffer
+// textures, the shader gets where this frame's part starts in each
+const GLint CLUSTER_LIGHT_UNIT = 2;
+const GLint CLUSTER_RANGE_UNIT = 3;
+const GLint CLUSTER_INDEX_UNIT = 4;
+RingBuffer clusterData;
+GLuint clusterTextures[3];
+GLuint clusterTextureBuffer = 0;
+
+// Everything the GL thread needs to submit one frame. A job builds it from the
+// scene while the GL thread submits the frames before it
+struct FrameData
+{
+	double time;
+	glm::vec3 cameraPos;
+	// Shading program of each material at launch, the simple one until its variant
+	// is ready, and each program in there once
+	std::vector<GLuint> materialPrograms;
+	std::vector<GLuint> programs;
+	glm::mat4 view;
+	glm::mat4 projection;
+	// Size it is drawn at, smaller than the window when scaled up afterwards
+	int width;
+	int height;
+	bool scaled;
+
+	// Draws in state order, with the meshlet ranges of each that survived culling
+	DrawList drawList;
+	std::vector<MeshletDrawList> visible;
+	unsigned int unsortedStateChanges;
+	size_t transformUpdates;
+	// Model matrices of the ravens in view, the milliseconds stepping the flock
+	// took and the instanced program, 0 until it is ready
+	std::vector<glm::mat4> flockTransforms;
+	double flockMs;
+	GLuint flockProgram;
+	// The light at launch and whether this frame redraws the static shadow casters.
+	// The meshlets of the shadow casters in each cube face, indexed like the draws
+	// and only filled for the casters drawn, and the ravens in each face
+	glm::vec3 lightPos;
+	bool shadowStatic;
+	std::vector<MeshletDrawList> shadowVisible[PointShadow::FACES];
+	std::vector<glm::mat4> flockShadowTransforms[PointShadow::FACES];
+	// Draw indices front to back for the depth pre-pass, when it is on
+	bool depthPrepass;
+	std::vector<unsigned int> depthOrder;
+	// Point lights sorted into the froxels of this frame's view
+	LightClusters clusters;
+
+	// Held from launch until the frame is built, the GL thread waits on it
+	jobs::Counter prepared;
+	// The scene can only be animated by one frame at a time, a frame launched while
+	// this one is being built is started by this frame's job when it is done
+	bool building = false;
+	FrameData* next = NULL;
+	jobs::Counter job;
 };
 
-GLuint VBOs[5], VAOs[5], EBOs[5];
-
-std::vector<GLfloat> loadVertices(objl::Loader loader) {
-	std::vector<GLfloat> vertices;
-
-	for (int y = 0; y < loader.LoadedMeshes.size(); y++) {
+// Frames built ahead of the one being submitted is the depth less one, set with --pipeline.
+// Every frame ahead adds a frame of input latency
+const int MAX_PIPELINE_DEPTH = 4;
+int pipelineDepth = 2;
+FrameData frames[MAX_PIPELINE_DEPTH];
+FrameData* lastLaunched = NULL;
+std::mutex pipelineLock;
 
-		for (int i = 0; i < loader.LoadedVertices.size(); i++) {
-			vertices.push_back(loader.LoadedVertices[i].Position.X);
-			vertices.push_back(loader.LoadedVertices[i].Position.Y);
-			vertices.push_back(loader.LoadedVertices[i].Position.Z);
+// Time taken by each load stage, reported by the benchmark mode
+std::vector<std::pair<std::string, double> > loadTimings;
 
-			vertices.push_back(loader.LoadedVertices[i].Normal.X);
-			vertices.push_back(loader.LoadedVertices[i].Normal.Y);
-			vertices.push_back(loader.LoadedVertices[i].Normal.Z);
+// Meshlet partition of every loaded object, indexed like the VAOs
+std::vector<MeshletData> objectMeshlets;
 
-			vertices.push_back(loader.LoadedVertices[i].TextureCoordinate.X);
-			vertices.push_back(1 - (loader.LoadedVertices[i].TextureCoordinate.Y)); // Inverted coordinates due to opengl
-			vertices.push_back(0); // Unused value
-		}
+// Copy the positions out of interleaved vertices (9 floats each) into the mesh's
+// depth pass vertex array, which draws with the mesh's index buffer
+void setUpDepthStream(int index, const GLfloat* vertices, size_t vertexCount)
+{
+	std::vector<GLfloat> positions(vertexCount * 3);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		positions[i * 3] = vertices[i * 9];
+		positions[i * 3 + 1] = vertices[i * 9 + 1];
+		positions[i * 3 + 2] = vertices[i * 9 + 2];
 	}
 
-	return vertices;
-}
-
-std::vector<GLuint> loadIndices(objl::Loader loader) {
-	std::vector<GLuint> indices;
+	glBindVertexArray(depthVAOs[index]);
+	glBindBuffer(GL_ARRAY_BUFFER, depthVBOs[index]);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLfloat), &positions[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[index]);
 
-	for (int y = 0; y < loader.LoadedMeshes.size(); y++) {
-		for (int j = 0; j < loader.LoadedIndices.size(); j++) {
-			indices.push_back(loader.LoadedIndices[j]);
-		}
-	}
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
 
-	return indices;
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
 }
 
-std::vector<GLuint> setUpObject(std::string location, int index) {
+void setUpObject(std::string location, int index) {
 	// Read the .obj file
 	objl::Loader loader;
-	if (!loader.LoadFile(location)) {
+	if (!loadObject(loader, location)) {
 		std::cout << "Obj file not found";
 		glfwTerminate();
 	}
 
-	std::vector<GLfloat> vertices = loadVertices(loader);
-	std::vector<GLuint> indices = loadIndices(loader);
+	// Objects are drawn with a single material, the one of their first mesh
+	meshMaterial[index] = materials.resolve(loader.LoadedMeshes.empty() ? objl::Material() : loader.LoadedMeshes[0].MeshMaterial, location);
+
+	// Split into attribute streams for the SIMD kernels, the loader is done
+	// with after this so free it before the GPU layout is built
+	MeshSoA mesh;
+	loadMeshSoA(loader, mesh);
+	std::vector<objl::Vertex>().swap(loader.LoadedVertices);
+	std::vector<GLuint>().swap(loader.LoadedIndices);
+
+	// Files without normals only get flat ones from the loader
+	if (loader.GeneratedNormals) {
+		NormalSettings settings;
+		settings.tangents = false;
+		generateSmoothNormals(mesh, settings);
+		weldVertices(mesh);
+	}
+
+	MeshBounds bounds;
+	computeBounds(mesh, bounds);
+	meshCenters[index] = glm::vec3(bounds.min[0] + bounds.max[0], bounds.min[1] + bounds.max[1], bounds.min[2] + bounds.max[2]) * 0.5f;
+	meshReach[index] = glm::length(glm::max(glm::abs(glm::vec3(bounds.min[0], bounds.min[1], bounds.min[2])),
+		glm::abs(glm::vec3(bounds.max[0], bounds.max[1], bounds.max[2]))));
+
+	std::vector<GLfloat> vertices;
+	interleaveVertices(mesh, vertices);
+
+	// Split into meshlets, the index buffer is uploaded in meshlet order
+	// so every visible meshlet can be drawn as a contiguous range
+	objectMeshlets[index] = buildMeshlets(&vertices[0], 9, mesh.vertexCount, mesh.indices);
+	mesh = MeshSoA();
+	const std::vector<GLuint>& meshletIndices = objectMeshlets[index].indices;
 
 	// ================================
 	// buffer setup
@@ -114,6 +378,61 @@ std::vector<GLuint> setUpObject(std::string location, int index) {
 	glBindBuffer(GL_ARRAY_BUFFER, VBOs[index]);
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
 
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[index]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshletIndices.size() * sizeof(GLuint), &meshletIndices[0], GL_STATIC_DRAW);
+
+	// Vertex attributes stay the same
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+
+	// Normal attribute
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+
+	// Texture coords attribute
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	setUpDepthStream(index, &vertices[0], vertices.size() / 9);
+}
+
+// Draw the index ranges of an object's meshlets that survived culling,
+// returns the number of triangles submitted
+unsigned int drawMeshlets(GLuint vertexArray, const MeshletDrawList& visible)
+{
+	if (visible.counts.empty())
+		return 0;
+
+	stateCache.bindVertexArray(vertexArray);
+	if (visible.baseVertices.empty())
+		glMultiDrawElements(GL_TRIANGLES, &visible.counts[0], GL_UNSIGNED_INT,
+			&visible.offsets[0], (GLsizei)visible.counts.size());
+	else
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, &visible.counts[0], GL_UNSIGNED_INT,
+			&visible.offsets[0], (GLsizei)visible.counts.size(), &visible.baseVertices[0]);
+
+	return visible.visibleTriangles;
+}
+
+// Generate the terrain and upload it as mesh index: the vertices of every chunk, and
+// the index patterns its chunks are drawn with
+void setUpFloor(int index)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	terrain.generate(terrainSettings);
+	const std::vector<GLfloat>& vertices = terrain.vertices();
+	const std::vector<GLuint>& indices = terrain.indices();
+	std::cout << "terrain: " << terrain.chunkCount() << " chunks, " << vertices.size() / 9 << " vertices, "
+		<< terrain.levels() << " detail levels, generated in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+
+	glBindVertexArray(VAOs[index]);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[index]);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
+
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[index]);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
 
@@ -132,17 +451,1349 @@ std::vector<GLuint> setUpObject(std::string location, int index) {
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 
-	return indices;
+	glm::vec3 low = terrain.boundsMin(), high = terrain.boundsMax();
+	meshCenters[index] = (low + high) * 0.5f;
+	meshReach[index] = glm::length(glm::max(glm::abs(low), glm::abs(high)));
+	setUpDepthStream(index, &vertices[0], vertices.size() / 9);
+}
+
+// Pick up the programs that finished compiling, and say so once all of them have
+void pollShaders()
+{
+	if (shadersReady || !shaders::poll())
+		return;
+	shadersReady = true;
+	std::cout << "Shaders ready after " << shaders::readyMs() << " ms"
+		<< (shaders::isParallel() ? ", compiled in parallel" : "") << std::endl;
+}
+
+// Instanced variants have no Object block
+void bindObjectBlock(GLuint program)
+{
+	GLuint block = glGetUniformBlockIndex(program, "Object");
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, block, OBJECT_BLOCK_BINDING);
+}
+
+// Constant uniforms and bindings of the shading programs, set once each has linked
+void setUpShadingProgram(GLuint program)
+{
+	MaterialRegistry::setSamplerUnits(program);
+	glUniform3f(glGetUniformLocation(program, "lightColor"), 1.0f, 1.0f, 1.0f);
+	glUniform1i(glGetUniformLocation(program, "staticShadow"), STATIC_SHADOW_UNIT);
+	glUniform1i(glGetUniformLocation(program, "dynamicShadow"), DYNAMIC_SHADOW_UNIT);
+	glUniform3f(glGetUniformLocation(program, "shadowParams"), shadow.depthScale(), shadow.depthBias(), 2.0f / std::max(1, shadow.size()));
+	glUniform1i(glGetUniformLocation(program, "clusterLights"), CLUSTER_LIGHT_UNIT);
+	glUniform1i(glGetUniformLocation(program, "clusterRanges"), CLUSTER_RANGE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "clusterIndices"), CLUSTER_INDEX_UNIT);
+	bindObjectBlock(program);
+}
+
+// The depth and overdraw programs only need the per draw block
+void setUpPassProgram(GLuint program)
+{
+	bindObjectBlock(program);
+}
+
+void setUpUpscaleProgram(GLuint program)
+{
+	glUniform1i(glGetUniformLocation(program, "source"), 0);
+}
+
+// The shading features a material needs, point lights are on for all or none
+unsigned int shaderFeatures(unsigned int material)
+{
+	unsigned int features = 0;
+	if (materials.hasSpecular(material))
+		features |= SHADER_SPECULAR;
+	if (pointLightCount > 0)
+		features |= SHADER_POINT_LIGHTS;
+	if (shadowsEnabled)
+		features |= SHADER_SHADOWS;
+	return features;
+}
+
+// Load the scene file and its textures, objects and shaders, timing each stage
+void loadScene(const std::string& sceneFile)
+{
+	double stageStart = glfwGetTime();
+	auto endStage = [&stageStart](const std::string& name)
+	{
+		double now = glfwGetTime();
+		loadTimings.push_back(std::make_pair(name, (now - stageStart) * 1000.0));
+		stageStart = now;
+	};
+
+	if (!scene.load(sceneFile))
+	{
+		std::cout << "Scene " << sceneFile << " not found, using the default scene" << std::endl;
+		scene.makeDefault();
+	}
+	endStage("scene");
+
+	size_t meshCount = scene.meshes.size();
+	VAOs.resize(meshCount);
+	VBOs.resize(meshCount);
+	EBOs.resize(meshCount);
+	glGenVertexArrays((GLsizei)meshCount, &VAOs[0]);
+	glGenBuffers((GLsizei)meshCount, &VBOs[0]);
+	glGenBuffers((GLsizei)meshCount, &EBOs[0]);
+	depthVAOs.resize(meshCount);
+	depthVBOs.resize(meshCount);
+	glGenVertexArrays((GLsizei)meshCount, &depthVAOs[0]);
+	glGenBuffers((GLsizei)meshCount, &depthVBOs[0]);
+	meshCenters.assign(meshCount, glm::vec3(0.0f));
+	meshReach.assign(meshCount, 0.0f);
+	meshMaterial.assign(meshCount, 0);
+	meshDrawNames.resize(meshCount);
+	objectMeshlets.resize(meshCount);
+
+	// Load textures. The MTL files the objects reference are not shipped, the
+	// scene's materials stand in for them under the names the objects use
+	for (size_t i = 0; i < scene.materials.size(); i++)
+	{
+		materials.addFallback(scene.materials[i].name, scene.materials[i].diffuse, !scene.materials[i].matte);
+		endStage(scene.materials[i].diffuse.substr(scene.materials[i].diffuse.find_last_of('/') + 1));
+	}
+
+	// Set up objects and buffers
+	for (size_t i = 0; i < meshCount; i++)
+	{
+		const SceneMesh& mesh = scene.meshes[i];
+		meshDrawNames[i] = "Draw " + mesh.name;
+		if (mesh.path == "@floor")
+		{
+			floorMesh = (int)i;
+			setUpFloor((int)i);
+		}
+		else
+			setUpObject(mesh.path, (int)i);
+
+		if (!mesh.material.empty())
+		{
+			int id = materials.find(mesh.material);
+			meshMaterial[i] = id >= 0 ? (unsigned int)id : materials.addFallback(mesh.material, "");
+		}
+		endStage(mesh.path.substr(mesh.path.find_last_of('/') + 1));
+	}
+
+	// Moving objects are left out of the cached shadow map
+	objectAnimated.resize(scene.objects.size());
+	for (size_t i = 0; i < scene.objects.size(); i++)
+		objectAnimated[i] = scene.isAnimated(scene.objects[i].node) ? 1 : 0;
+	if (shadowsEnabled && !shadow.create(shadowSize, SHADOW_NEAR, SHADOW_FAR))
+	{
+		shadow.destroy();
+		shadowsEnabled = false;
+	}
+
+	//++++++++++Build and compile shader program+++++++++++++++++++++
+	// Everything is submitted before anything is waited for, only the simple
+	// program has to be ready to draw the first frame
+	simpleShader = shaders::submit("vert.glsl", "simple_frag.glsl", setUpShadingProgram);
+	// The cluster grid comes from LightClusters, the shader must index it the same way
+	std::string clusterDefines = "#define CLUSTER_TILES_X " + std::to_string(LightClusters::TILES_X) + "\n"
+		+ "#define CLUSTER_TILES_Y " + std::to_string(LightClusters::TILES_Y) + "\n"
+		+ "#define CLUSTER_SLICES " + std::to_string(LightClusters::SLICES) + "\n";
+	shadingVariants.init("vert.glsl", "frag.glsl", SHADER_FEATURE_NAMES, setUpShadingProgram, simpleShader, clusterDefines);
+	materialShaders.resize(materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+		materialShaders[i] = shadingVariants.get(shaderFeatures((unsigned int)i));
+	depthShader = shaders::submit("depth_vert.glsl", "depth_frag.glsl", setUpPassProgram);
+	overdrawShader = shaders::submit("vert.glsl", "overdraw_frag.glsl", setUpPassProgram);
+	if (flockCount > 0)
+	{
+		for (size_t i = 0; i < meshCount && flockMesh < 0; i++)
+			if (scene.meshes[i].name == "raven")
+				flockMesh = (int)i;
+		if (flockMesh < 0)
+			std::cout << "ERROR::FLOCK::NO_RAVEN_MESH " << sceneFile << std::endl;
+		else
+		{
+			flockShader = shadingVariants.get(shaderFeatures(meshMaterial[flockMesh]) | SHADER_INSTANCED);
+			flockOverdrawShader = shaders::submit("vert.glsl", "overdraw_frag.glsl", setUpPassProgram, -1, "#define INSTANCED\n");
+			if (shadowsEnabled)
+				flockShadowShader = shaders::submit("depth_vert.glsl", "depth_frag.glsl", setUpPassProgram, -1, "#define INSTANCED\n");
+		}
+	}
+	upscaleShader = shaders::submit("upscale_vert.glsl", "upscale_frag.glsl", setUpUpscaleProgram);
+	shaders::finish(simpleShader);
+	endStage("shaders");
+
+	glGenQueries(SAMPLE_QUERY_COUNT, sampleQueries);
+	gpuFrameTimer.create();
+	gpuShadowTimer.create();
+	// The upscale pass makes its triangle from the vertex index, but still needs a vertex array bound
+	glGenVertexArrays(1, &upscaleVAO);
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	// Three sections, the GPU may still read the two frames before the one being written
+	frameUniforms.create(GL_UNIFORM_BUFFER, scene.objects.size() * sizeof(glm::mat4), 3);
+}
+
+// Spawn the flock over the watchtower and the fir tree, and a vertex array that
+// draws the raven mesh with a model matrix per instance
+void setUpFlock()
+{
+	if (flockMesh < 0)
+		return;
+
+	FlockSettings settings;
+	settings.center = glm::vec3(0.0f, 14.0f, -10.0f);
+	settings.extent = glm::vec3(40.0f, 8.0f, 40.0f);
+	flock.spawn(flockCount, 1, settings);
+
+	glGenVertexArrays(1, &flockVAO);
+	glBindVertexArray(flockVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBOs[flockMesh]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[flockMesh]);
+	for (int attribute = 0; attribute < 3; attribute++)
+	{
+		const GLint sizes[] = { 3, 3, 2 };
+		const size_t offsets[] = { 0, 3, 6 };
+		glVertexAttribPointer(attribute, sizes[attribute], GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(offsets[attribute] * sizeof(GLfloat)));
+		glEnableVertexAttribArray(attribute);
+	}
+	// The instance matrix takes four attributes, one per column. They point into
+	// the ring buffer section of each frame when it is drawn
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(3 + column);
+		glVertexAttribDivisor(3 + column, 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	flockInstances.create(GL_ARRAY_BUFFER, flockCount * sizeof(glm::mat4), 3);
+}
+
+// Scatter the lanterns around the watchtower and create the buffer textures the
+// fragment shader reads the light clusters from
+void setUpLights()
+{
+	scatterLights(pointLights, pointLightCount, 1, glm::vec3(-40.0f, 0.5f, -60.0f), glm::vec3(40.0f, 8.0f, 20.0f));
+
+	glGenTextures(3, clusterTextures);
+	clusterData.create(GL_TEXTURE_BUFFER, pointLights.size() * 2 * sizeof(glm::vec4) + LightClusters::COUNT * 4 * sizeof(GLuint));
+}
+
+// Copy a frame's light clusters to the ring buffer and bind them, base gets where
+// the frame's part starts in each buffer texture
+void uploadLights(const FrameData& frame, GLint base[3])
+{
+	const LightClusters& clusters = frame.clusters;
+	size_t lightBytes = clusters.lightTexels.size() * sizeof(glm::vec4);
+	size_t rangeBytes = clusters.ranges.size() * sizeof(GLuint);
+	size_t indexBytes = clusters.indices.size() * sizeof(GLuint);
+
+	// Every part starts on a whole RGBA32F texel, so its offset is a whole texel of each format
+	clusterData.reserve(lightBytes + rangeBytes + indexBytes + 3 * sizeof(glm::vec4));
+	clusterData.beginFrame();
+	GLintptr lightOffset = 0, rangeOffset = 0, indexOffset = 0;
+	void* lights = clusterData.allocate(lightBytes, sizeof(glm::vec4), lightOffset);
+	void* ranges = clusterData.allocate(rangeBytes, sizeof(glm::vec4), rangeOffset);
+	void* indices = clusterData.allocate(indexBytes, sizeof(glm::vec4), indexOffset);
+	if (lights && lightBytes)
+		memcpy(lights, &clusters.lightTexels[0], lightBytes);
+	if (ranges)
+		memcpy(ranges, &clusters.ranges[0], rangeBytes);
+	if (indices && indexBytes)
+		memcpy(indices, &clusters.indices[0], indexBytes);
+	clusterData.finishWrites();
+
+	// Growing the ring replaces its buffer, the textures have to follow
+	if (clusterTextureBuffer != clusterData.buffer())
+	{
+		clusterTextureBuffer = clusterData.buffer();
+		const GLenum formats[] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+		for (int i = 0; i < 3; i++)
+		{
+			glBindTexture(GL_TEXTURE_BUFFER, clusterTextures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, formats[i], clusterTextureBuffer);
+		}
+	}
+
+	const GLint units[] = { CLUSTER_LIGHT_UNIT, CLUSTER_RANGE_UNIT, CLUSTER_INDEX_UNIT };
+	for (int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_BUFFER, clusterTextures[i]);
+	}
+
+	base[0] = (GLint)(lightOffset / sizeof(glm::vec4));
+	base[1] = (GLint)(rangeOffset / (2 * sizeof(GLuint)));
+	base[2] = (GLint)(indexOffset / sizeof(GLuint));
+}
+
+// Per frame uniforms of a shading program
+void setFrameUniforms(GLuint program, const FrameData& frame, const GLint clusterBase[3])
+{
+	glUseProgram(program);
+	glUniform3f(glGetUniformLocation(program, "lightPos"), frame.lightPos.x, frame.lightPos.y, frame.lightPos.z);
+	glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(frame.view));
+	glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(frame.projection));
+	glUniform3f(glGetUniformLocation(program, "viewPos"), frame.cameraPos.x, frame.cameraPos.y, frame.cameraPos.z);
+	glUniform3i(glGetUniformLocation(program, "clusterBase"), clusterBase[0], clusterBase[1], clusterBase[2]);
+	glUniform2f(glGetUniformLocation(program, "clusterTileSize"),
+		(GLfloat)frame.width / LightClusters::TILES_X, (GLfloat)frame.height / LightClusters::TILES_Y);
+	glUniform2f(glGetUniformLocation(program, "clusterDepth"), frame.clusters.sliceScale(), frame.clusters.sliceBias());
+}
+
+// Draw the visible part of a mesh from one of the per mesh vertex array lists,
+// returns the number of triangles submitted. The terrain's chunks come in the same
+// list as the meshlets of the objects
+unsigned int drawMesh(const DrawItem& item, const MeshletDrawList& visible, const std::vector<GLuint>& vertexArrays)
+{
+	return drawMeshlets(vertexArrays[item.mesh], visible);
+}
+
+// Bind the state of one draw (skipping what is already bound) and draw it with
+// the item's program and material, or with overdrawProgram if it is not 0.
+// Returns the number of triangles submitted
+unsigned int submitDraw(const DrawItem& item, const MeshletDrawList& visible, GLintptr objectOffset, GLuint overdrawProgram)
+{
+	PROFILE_GPU_SCOPE(item.name);
+
+	// The overdraw view needs no material
+	GLuint program = overdrawProgram ? overdrawProgram : item.program;
+	stateCache.useProgram(program);
+	if (!overdrawProgram && stateCache.bindMaterial(item.material))
+		materials.apply(item.material, stateCache.materialUniforms());
+	glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, frameUniforms.buffer(), objectOffset, sizeof(glm::mat4));
+
+	return drawMesh(item, visible, VAOs);
+}
+
+// Lay down the depth of every draw front to back with the colour writes off, using
+// only the positions. The shading pass after it tests for equal depth
+void submitDepthPass(const FrameData& frame, GLuint depthProgram)
+{
+	PROFILE_GPU_SCOPE("Depth pre-pass");
+
+	stateCache.useProgram(depthProgram);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	for (size_t i = 0; i < frame.depthOrder.size(); i++)
+	{
+		unsigned int index = frame.depthOrder[i];
+		glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, frameUniforms.buffer(), objectOffsets[index], sizeof(glm::mat4));
+		drawMesh(frame.drawList.items[index], frame.visible[index], depthVAOs);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Count the samples written between the two calls. The count of a frame is read
+// SAMPLE_QUERY_COUNT frames later if it is ready by then, so the CPU never waits
+void beginSampleQuery()
+{
+	GLuint query = sampleQueries[sampleQueryIndex];
+	if (sampleQueryPending[sampleQueryIndex])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		frameShadedSamplesValid = available != 0;
+		if (available)
+		{
+			GLuint64 samples = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &samples);
+			frameShadedSamples = samples;
+		}
+	}
+	glBeginQuery(GL_SAMPLES_PASSED, query);
+	sampleQueryPending[sampleQueryIndex] = true;
+}
+
+void endSampleQuery()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	sampleQueryIndex = (sampleQueryIndex + 1) % SAMPLE_QUERY_COUNT;
+}
+
+// Job building a frame: animate the scene and the flock, collect and sort the draws
+// and cull their meshlets. Only reads what the GL thread never writes after loading.
+// Jobs never wait for another frame, a thread waiting inside one could pick up the next
+void prepareFrame(void* data, size_t, size_t)
+{
+	FrameData& frame = *(FrameData*)data;
+
+	// Only the subtrees of animated nodes change, every other world matrix stays as it was
+	frame.transformUpdates = scene.animate(frame.time);
+	glm::mat4 viewProjection = frame.projection * frame.view;
+
+	// The flock takes the same fixed steps as the simulation, culled to the view
+	frame.flockTransforms.clear();
+	frame.flockMs = 0.0;
+	if (flockMesh >= 0)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		flock.advance(frame.time, 1.0 / simRate);
+		frame.flockMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		flock.writeTransforms(viewProjection, FLOCK_MODEL_ROTATION, FLOCK_SCALE, meshReach[flockMesh], frame.flockTransforms);
+	}
+
+	// Collect the draws
+	DrawList& drawList = frame.drawList;
+	drawList.clear();
+	drawList.items.reserve(scene.objects.size());
+	for (size_t i = 0; i < scene.objects.size(); i++)
+	{
+		const SceneObject& object = scene.objects[i];
+		DrawItem item;
+		item.material = meshMaterial[object.mesh];
+		item.program = frame.materialPrograms[item.material];
+		item.mesh = (int)object.mesh;
+		item.model = scene.world(object);
+		item.depth = -(frame.view * item.model * glm::vec4(meshCenters[object.mesh], 1.0f)).z;
+		item.name = meshDrawNames[object.mesh].c_str();
+		item.dynamic = objectAnimated[i] != 0;
+
+		// The depth pre-pass takes care of overdraw, then state order is all that
+		// matters. Without it the nearest draws go first
+		unsigned int depthBits = depthSortBits(item.depth, NEAR_PLANE, FAR_PLANE);
+		if (frame.depthPrepass)
+			item.key = makeDrawKey(item.program, item.material, item.mesh, depthBits);
+		else
+			item.key = makeDepthFirstKey(depthBits, item.program, item.material, item.mesh);
+		drawList.add(item);
+	}
+
+	frame.unsortedStateChanges = drawList.countStateChanges();
+	drawList.sort();
+
+	frame.depthOrder.clear();
+	if (frame.depthPrepass)
+	{
+		frame.depthOrder.resize(drawList.items.size());
+		for (size_t i = 0; i < frame.depthOrder.size(); i++)
+			frame.depthOrder[i] = (unsigned int)i;
+		std::sort(frame.depthOrder.begin(), frame.depthOrder.end(), [&drawList](unsigned int a, unsigned int b)
+		{
+			return drawList.items[a].depth < drawList.items[b].depth;
+		});
+	}
+
+	// Cull in state order so the submission loop walks both lists together
+	frame.visible.resize(drawList.items.size());
+	parallelFor(drawList.items.size(), 64, [&frame, &viewProjection](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const DrawItem& item = frame.drawList.items[i];
+			if (item.mesh == floorMesh)
+				terrain.select(item.model, viewProjection, frame.cameraPos, frame.visible[i]);
+			else
+				cullMeshlets(objectMeshlets[item.mesh], item.model, viewProjection, frame.cameraPos, frame.visible[i]);
+		}
+	});
+
+	// Shadow casters in each cube face: the moving ones every frame, the others only
+	// when the static map is redrawn. Meshlets facing away from the light are left out
+	if (shadowsEnabled)
+	{
+		for (int face = 0; face < PointShadow::FACES; face++)
+		{
+			glm::mat4 faceViewProjection = shadow.faceViewProjection(frame.lightPos, face);
+			std::vector<MeshletDrawList>& visible = frame.shadowVisible[face];
+			visible.resize(drawList.items.size());
+			parallelFor(drawList.items.size(), 64, [&frame, &visible, &faceViewProjection](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					const DrawItem& item = frame.drawList.items[i];
+					if (!item.dynamic && !frame.shadowStatic)
+						visible[i].counts.clear();
+					else if (item.mesh == floorMesh)
+						terrain.select(item.model, faceViewProjection, frame.lightPos, visible[i]);
+					else
+						cullMeshlets(objectMeshlets[item.mesh], item.model, faceViewProjection, frame.lightPos, visible[i]);
+				}
+			});
+
+			frame.flockShadowTransforms[face].clear();
+			if (flockMesh >= 0)
+				flock.writeTransforms(faceViewProjection, FLOCK_MODEL_ROTATION, FLOCK_SCALE, meshReach[flockMesh], frame.flockShadowTransforms[face]);
+		}
+	}
+
+	if (!frame.clusters.hasProjection(frame.projection))
+		frame.clusters.setProjection(frame.projection, NEAR_PLANE, CLUSTER_FAR);
+	frame.clusters.build(pointLights, frame.view);
+
+	// Hand the scene to the frame launched after this one
+	{
+		std::lock_guard<std::mutex> guard(pipelineLock);
+		frame.building = false;
+		if (frame.next)
+			jobs::run(prepareFrame, frame.next, 0, 0, frame.next->job);
+		frame.next = NULL;
+	}
+	frame.prepared.pending.fetch_sub(1, std::memory_order_release);
+}
+
+// Snapshot the camera at the given position and start building a frame for the given time
+void launchFrame(FrameData& frame, double time, const glm::vec3& position)
+{
+	frame.time = time;
+	frame.cameraPos = position;
+	frame.lightPos = lightPos;
+	frame.shadowStatic = shadowsEnabled && shadow.claimStaticRedraw(lightPos, shadowCache);
+	frame.depthPrepass = depthPrepass;
+	frame.materialPrograms.resize(materialShaders.size());
+	frame.programs.clear();
+	for (size_t i = 0; i < materialShaders.size(); i++)
+	{
+		GLuint program = shaders::program(materialShaders[i]);
+		frame.materialPrograms[i] = program;
+		if (std::find(frame.programs.begin(), frame.programs.end(), program) == frame.programs.end())
+			frame.programs.push_back(program);
+	}
+	frame.flockProgram = flockMesh >= 0 && shaders::isReady(flockShader) ? shaders::program(flockShader) : 0;
+	if (frame.flockProgram && std::find(frame.programs.begin(), frame.programs.end(), frame.flockProgram) == frame.programs.end())
+		frame.programs.push_back(frame.flockProgram);
+	frame.scaled = dynamicResolution;
+	float scale = frame.scaled ? resolution.scale() : 1.0f;
+	frame.width = std::max(1, (int)(framebufferWidth * scale + 0.5f));
+	frame.height = std::max(1, (int)(framebufferHeight * scale + 0.5f));
+	frame.view = glm::lookAt(position, position + cameraFront, cameraUp);
+	frame.projection = glm::perspective(45.0f, (GLfloat)frame.width / (GLfloat)frame.height, NEAR_PLANE, FAR_PLANE);
+
+	frame.prepared.pending.fetch_add(1, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> guard(pipelineLock);
+	frame.building = true;
+	if (lastLaunched && lastLaunched != &frame && lastLaunched->building)
+		lastLaunched->next = &frame;
+	else
+		jobs::run(prepareFrame, &frame, 0, 0, frame.job);
+	lastLaunched = &frame;
+}
+
+// Wait for every frame still being built
+void finishFrames()
+{
+	for (int i = 0; i < MAX_PIPELINE_DEPTH; i++)
+	{
+		jobs::wait(frames[i].prepared);
+		jobs::wait(frames[i].job);
+	}
+}
+
+// Write the frame's instance matrices of the flock to the ring buffer, the camera's
+// and then those of each shadow face
+void uploadFlock(const FrameData& frame)
+{
+	const std::vector<glm::mat4>* lists[1 + PointShadow::FACES] = { &frame.flockTransforms };
+	size_t bytes = frame.flockTransforms.size() * sizeof(glm::mat4);
+	for (int face = 0; face < PointShadow::FACES; face++)
+	{
+		lists[1 + face] = &frame.flockShadowTransforms[face];
+		bytes += frame.flockShadowTransforms[face].size() * sizeof(glm::mat4);
+	}
+	flockUploaded = bytes > 0;
+	if (!flockUploaded)
+		return;
+
+	flockInstances.reserve(bytes + sizeof(glm::vec4) * (1 + PointShadow::FACES));
+	flockInstances.beginFrame();
+	for (int i = 0; i < 1 + PointShadow::FACES; i++)
+	{
+		flockOffsets[i] = -1;
+		if (lists[i]->empty())
+			continue;
+		size_t listBytes = lists[i]->size() * sizeof(glm::mat4);
+		void* instances = flockInstances.allocate(listBytes, sizeof(glm::vec4), flockOffsets[i]);
+		if (instances)
+			memcpy(instances, &(*lists[i])[0], listBytes);
+		else
+			flockOffsets[i] = -1;
+	}
+	flockInstances.finishWrites();
+}
+
+// One instanced draw of the raven mesh with the bound program, count instances
+// from offset in the ring. Returns the number of triangles submitted
+unsigned int drawFlockInstances(GLintptr offset, size_t count)
+{
+	if (!flockUploaded || offset < 0 || count == 0)
+		return 0;
+
+	stateCache.bindVertexArray(flockVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, flockInstances.buffer());
+	for (int column = 0; column < 4; column++)
+		glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(offset + column * sizeof(glm::vec4)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLsizei indexCount = (GLsizei)objectMeshlets[flockMesh].indices.size();
+	glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)count);
+	return (unsigned int)(indexCount / 3 * count);
+}
+
+// Draw the ravens of the flock in view with one instanced draw, with the overdraw
+// program if it is not 0. Returns the number of triangles submitted
+unsigned int submitFlock(const FrameData& frame, GLuint overdrawProgram)
+{
+	GLuint program = overdrawProgram ? overdrawProgram : frame.flockProgram;
+	if (!program || frame.flockTransforms.empty())
+		return 0;
+	PROFILE_GPU_SCOPE("Draw flock");
+
+	unsigned int material = meshMaterial[flockMesh];
+	stateCache.useProgram(program);
+	if (!overdrawProgram && stateCache.bindMaterial(material))
+		materials.apply(material, stateCache.materialUniforms());
+	return drawFlockInstances(flockOffsets[0], frame.flockTransforms.size());
+}
+
+// Draw the shadow casters into the cube faces around the light: the static ones
+// when this frame redraws them, the moving ones into the faces they reach. Binds
+// framebuffer again afterwards, with the viewport at width by height, and the
+// shadow maps to their units
+void submitShadows(const FrameData& frame, GLuint framebuffer, int width, int height)
+{
+	PROFILE_GPU_SCOPE("Shadows");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	gpuShadowTimer.begin(0.0);
+
+	// The pre-pass's depth program draws the faces. Until it is ready nothing is
+	// drawn, and the static map waits for it
+	GLuint program = shaders::isReady(depthShader) ? shaders::program(depthShader) : 0;
+	GLuint flockProgram = flockMesh >= 0 && shaders::isReady(flockShadowShader) ? shaders::program(flockShadowShader) : 0;
+	const std::vector<DrawItem>& items = frame.drawList.items;
+	const glm::mat4 identity(1.0f);
+	frameShadowFaces = 0;
+
+	if (!program && frame.shadowStatic)
+		shadow.invalidate();
+	if (program)
+	{
+		// The face's view projection goes in as the view
+		GLuint programs[] = { program, flockProgram };
+		for (GLuint pass : programs)
+		{
+			if (!pass)
+				continue;
+			stateCache.useProgram(pass);
+			glUniformMatrix4fv(glGetUniformLocation(pass, "projection"), 1, GL_FALSE, glm::value_ptr(identity));
+		}
+
+		unsigned int dynamicFaces = 0;
+		for (int face = 0; face < PointShadow::FACES; face++)
+		{
+			bool casters = flockProgram && !frame.flockShadowTransforms[face].empty();
+			for (size_t i = 0; i < items.size() && !casters; i++)
+				casters = items[i].dynamic && !frame.shadowVisible[face][i].counts.empty();
+			if (casters)
+				dynamicFaces |= 1u << face;
+		}
+		shadow.clearStaleFaces(dynamicFaces);
+
+		for (int face = 0; face < PointShadow::FACES; face++)
+		{
+			glm::mat4 faceViewProjection = shadow.faceViewProjection(frame.lightPos, face);
+			for (int dynamic = 0; dynamic < 2; dynamic++)
+			{
+				if (dynamic ? !(dynamicFaces & (1u << face)) : !frame.shadowStatic)
+					continue;
+				shadow.beginFace(dynamic != 0, face);
+				frameShadowFaces++;
+
+				stateCache.useProgram(program);
+				glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(faceViewProjection));
+				for (size_t i = 0; i < items.size(); i++)
+				{
+					if (items[i].dynamic != (dynamic != 0) || frame.shadowVisible[face][i].counts.empty())
+						continue;
+					glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, frameUniforms.buffer(), objectOffsets[i], sizeof(glm::mat4));
+					drawMesh(items[i], frame.shadowVisible[face][i], depthVAOs);
+				}
+				if (dynamic && flockProgram && !frame.flockShadowTransforms[face].empty())
+				{
+					stateCache.useProgram(flockProgram);
+					glUniformMatrix4fv(glGetUniformLocation(flockProgram, "view"), 1, GL_FALSE, glm::value_ptr(faceViewProjection));
+					drawFlockInstances(flockOffsets[1 + face], frame.flockShadowTransforms[face].size());
+				}
+			}
+		}
+
+		// Give the pre-pass its camera back
+		stateCache.useProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(frame.view));
+		glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(frame.projection));
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	glActiveTexture(GL_TEXTURE0 + STATIC_SHADOW_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, shadow.staticTexture());
+	glActiveTexture(GL_TEXTURE0 + DYNAMIC_SHADOW_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, shadow.dynamicTexture());
+	glActiveTexture(GL_TEXTURE0);
+
+	gpuShadowTimer.end();
+	double pixels = 0.0;
+	frameShadowGpuValid = gpuShadowTimer.result(frameShadowGpuMs, pixels);
+	frameShadowMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Draw a prepared frame into framebuffer, which is bound with the viewport at width
+// by height. Returns the number of triangles submitted
+unsigned int submitFrame(FrameData& frame, GLuint framebuffer, int width, int height)
+{
+	unsigned int triangles = 0;
+
+	{
+		PROFILE_SCOPE("Wait for frame");
+		jobs::wait(frame.prepared);
+	}
+
+	// Programs still compiling are left out: no pre-pass, no overdraw view
+	GLuint depthProgram = frame.depthPrepass ? shaders::program(depthShader) : 0;
+	GLuint overdrawProgram = showOverdraw ? shaders::program(overdrawShader) : 0;
+	GLuint flockOverdrawProgram = showOverdraw && flockMesh >= 0 && shaders::isReady(flockOverdrawShader) ? shaders::program(flockOverdrawShader) : 0;
+
+	/* Render here */
+	{
+		PROFILE_GPU_SCOPE("Clear");
+		if (overdrawProgram)
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		else
+			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	}
+
+	// Per frame uniforms, the light clusters are needed by every shading program
+	GLint clusterBase[3];
+	{
+		PROFILE_SCOPE("Upload lights");
+		uploadLights(frame, clusterBase);
+	}
+	for (size_t i = 0; i < frame.programs.size(); i++)
+		setFrameUniforms(frame.programs[i], frame, clusterBase);
+	const GLuint passPrograms[] = { depthProgram, overdrawProgram, flockOverdrawProgram };
+	for (GLuint program : passPrograms)
+	{
+		if (!program)
+			continue;
+		glUseProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(frame.view));
+		glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(frame.projection));
+	}
+	stateCache.reset();
+
+	// Write the model matrices of every draw before the first one is issued
+	const std::vector<DrawItem>& items = frame.drawList.items;
+	{
+		PROFILE_SCOPE("Write uniforms");
+		size_t stride = (sizeof(glm::mat4) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+		frameUniforms.reserve(items.size() * stride);
+		frameUniforms.beginFrame();
+		objectOffsets.resize(items.size());
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			void* slice = frameUniforms.allocate(sizeof(glm::mat4), uniformAlignment, objectOffsets[i]);
+			if (slice)
+				memcpy(slice, glm::value_ptr(items[i].model), sizeof(glm::mat4));
+		}
+		frameUniforms.finishWrites();
+	}
+	if (flockMesh >= 0)
+		uploadFlock(frame);
+	if (shadowsEnabled)
+		submitShadows(frame, framebuffer, width, height);
+
+	// With the depth laid down only the fragments matching it are shaded
+	if (depthProgram)
+	{
+		submitDepthPass(frame, depthProgram);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+	if (overdrawProgram)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	}
+
+	// Submit in state order
+	beginSampleQuery();
+	for (size_t i = 0; i < items.size(); i++)
+		triangles += submitDraw(items[i], frame.visible[i], objectOffsets[i], overdrawProgram);
+	// The flock is left out of the pre-pass and depth tested as usual. In the
+	// overdraw view it waits for its own overdraw program
+	if (!overdrawProgram || flockOverdrawProgram)
+	{
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+		triangles += submitFlock(frame, flockOverdrawProgram);
+	}
+	endSampleQuery();
+	frameUniforms.endFrame();
+	if (flockUploaded)
+		flockInstances.endFrame();
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	clusterData.endFrame();
+
+	frameStateChanges = stateCache.counts;
+	frameUnsortedStateChanges = frame.unsortedStateChanges;
+	frameTransformUpdates = frame.transformUpdates;
+	frameFlockMs = frame.flockMs;
+	frameFlockInstances = frame.flockTransforms.size();
+	frameTerrainChunks = frameTerrainTriangles = 0;
+	for (size_t i = 0; i < frame.drawList.items.size(); i++)
+	{
+		if (frame.drawList.items[i].mesh != floorMesh)
+			continue;
+		frameTerrainChunks += frame.visible[i].visibleMeshlets;
+		frameTerrainTriangles += frame.visible[i].visibleTriangles;
+	}
+	frameLightReferences = frame.clusters.indices.size();
+	frameMaxClusterLights = frame.clusters.maxLights;
+
+	return triangles;
+}
+
+// Scale the part of the scene target a frame was drawn to up into the bound
+// framebuffer. A plain linear blit stands in while the upscale program compiles
+void upscaleFrame(const FrameData& frame, int width, int height)
+{
+	PROFILE_GPU_SCOPE("Upscale");
+
+	int sourceWidth = std::min(frame.width, sceneTarget.width);
+	int sourceHeight = std::min(frame.height, sceneTarget.height);
+	GLuint program = shaders::program(upscaleShader);
+	if (!program)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneTarget.fbo);
+		glBlitFramebuffer(0, 0, sourceWidth, sourceHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		return;
+	}
+
+	// Drawn at full size there is nothing to sharpen
+	bool smaller = sourceWidth < width || sourceHeight < height;
+	GLfloat targetWidth = (GLfloat)sceneTarget.width, targetHeight = (GLfloat)sceneTarget.height;
+	glUseProgram(program);
+	glUniform2f(glGetUniformLocation(program, "sourceScale"), sourceWidth / targetWidth, sourceHeight / targetHeight);
+	glUniform2f(glGetUniformLocation(program, "texelSize"), 1.0f / targetWidth, 1.0f / targetHeight);
+	glUniform2f(glGetUniformLocation(program, "sourceMax"), (sourceWidth - 0.5f) / targetWidth, (sourceHeight - 0.5f) / targetHeight);
+	glUniform1f(glGetUniformLocation(program, "sharpness"), smaller ? upscaleSharpness : 0.0f);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, sceneTarget.color);
+
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(upscaleVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+}
+
+// Draw a prepared frame into output, a framebuffer of the given size. A scaled
+// frame is drawn to the scene target at its own size first, and the GPU time read
+// back steers the scale of the frames launched next. Returns the triangles submitted
+unsigned int drawFrame(FrameData& frame, GLuint output, int width, int height)
+{
+	// The scene target follows the size of the output
+	bool scaled = frame.scaled;
+	if (scaled && (sceneTarget.width != width || sceneTarget.height != height) && !createFramebuffer(sceneTarget, width, height))
+		scaled = dynamicResolution = false;
+
+	// Frames launched before a resize are drawn at their own size, within the target
+	int drawWidth = scaled ? std::min(frame.width, width) : width;
+	int drawHeight = scaled ? std::min(frame.height, height) : height;
+	frameDrawnPixels = (double)drawWidth * drawHeight;
+	gpuFrameTimer.begin(frameDrawnPixels);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, scaled ? sceneTarget.fbo : output);
+	glViewport(0, 0, drawWidth, drawHeight);
+	unsigned int triangles = submitFrame(frame, scaled ? sceneTarget.fbo : output, drawWidth, drawHeight);
+	if (scaled)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, output);
+		glViewport(0, 0, width, height);
+		upscaleFrame(frame, width, height);
+	}
+
+	gpuFrameTimer.end();
+	frameGpuValid = gpuFrameTimer.result(frameGpuMs, frameGpuPixels);
+	if (frameGpuValid && dynamicResolution)
+		resolution.update(frameGpuMs, frameGpuPixels, (double)width * height);
+
+	if (frameCapture.isActive())
+		frameCapture.capture(output, width, height);
+	return triangles;
+}
+
+// Replay a camera path on a fixed timestep into an offscreen target and report
+// frame time percentiles. Frames are fenced with glFinish so each sample
+// includes the GPU work of that frame. With capture the measured frames are
+// recorded to --capture, their readback included in the frame times
+int runBenchmark(int frameCount, const std::string& pathFile, const std::string& outFile, bool capture)
+{
+	CameraPath path;
+	if (pathFile.empty() || !path.load(pathFile))
+	{
+		if (!pathFile.empty())
+			std::cout << "Camera path " << pathFile << " not found, using the default path" << std::endl;
+		path.makeDefault();
+	}
+
+	Framebuffer target;
+	if (!createFramebuffer(target, benchWidth, benchHeight))
+		return -1;
+
+	// Measure the real programs, not the ones standing in for them
+	shaders::finish();
+	pollShaders();
+
+	BenchReport report;
+	const GLubyte* renderer = glGetString(GL_RENDERER);
+	report.renderer = renderer ? (const char*)renderer : "unknown";
+	report.width = target.width;
+	report.height = target.height;
+	report.warmupFrames = 30;
+	report.loadMs = loadTimings;
+	report.pipelineDepth = pipelineDepth;
+	report.jobThreads = jobs::threadCount();
+	report.persistentMapping = frameUniforms.isPersistent();
+	report.pointLights = (unsigned int)pointLights.size();
+	report.shaderReadyMs = shaders::readyMs();
+	report.parallelShaderCompile = shaders::isParallel();
+	report.shaderVariants = shadingVariants.size();
+	report.depthPrepass = depthPrepass;
+	report.frameBudgetMs = dynamicResolution ? resolution.budget() : 0.0;
+	report.flockBoids = (unsigned int)flock.size();
+	report.terrainChunks = floorMesh >= 0 ? terrain.chunkCount() : 0;
+	report.shadows = shadowsEnabled;
+	report.shadowCache = shadowCache;
+	report.shadowSize = shadowsEnabled ? shadow.size() : 0;
+	unsigned int redrawsBefore = 0;
+	unsigned long long stallsBefore = 0;
+	report.frameMs.reserve(frameCount);
+
+	// Frames are sized for the target, not the hidden window
+	framebufferWidth = target.width;
+	framebufferHeight = target.height;
+
+	// Start building a frame from the camera path, frames are numbered from the first warmup frame
+	auto launch = [&](int frame)
+	{
+		double simTime = frame * BENCH_TIMESTEP;
+		path.evaluate(simTime, cameraPos, yaw, pitch);
+		updateCameraFront();
+		launchFrame(frames[frame % pipelineDepth], simTime, cameraPos);
+	};
+	for (int ahead = 0; ahead < pipelineDepth - 1; ahead++)
+		launch(ahead);
+
+	for (int frame = -report.warmupFrames; frame < frameCount; frame++)
+	{
+		int number = frame + report.warmupFrames;
+		if (frame == 0)
+		{
+			stallsBefore = frameUniforms.stalls();
+			redrawsBefore = shadow.staticRedraws();
+			if (capture)
+				frameCapture.start(capturePath, (unsigned int)(1.0 / BENCH_TIMESTEP + 0.5));
+		}
+
+		double start = glfwGetTime();
+		profiler::beginFrame();
+
+		launch(number + pipelineDepth - 1);
+		FrameData& drawn = frames[number % pipelineDepth];
+		unsigned int triangles = drawFrame(drawn, target.fbo, target.width, target.height);
+		glFinish();
+
+		profiler::endFrame();
+		double end = glfwGetTime();
+
+		if (frame >= 0)
+		{
+			report.frameMs.push_back((end - start) * 1000.0);
+			report.triangles += triangles;
+			report.stateChanges += frameStateChanges.total();
+			report.redundantStateChanges += frameStateChanges.redundant;
+			report.unsortedStateChanges += frameUnsortedStateChanges;
+			report.transformUpdates += frameTransformUpdates;
+			report.flockMs += frameFlockMs;
+			report.flockInstances += frameFlockInstances;
+			report.terrainChunksDrawn += frameTerrainChunks;
+			report.terrainTriangles += frameTerrainTriangles;
+			report.shadowMs += frameShadowMs;
+			report.shadowFaces += frameShadowFaces;
+			if (frameShadowGpuValid)
+			{
+				report.shadowGpuMs += frameShadowGpuMs;
+				report.shadowGpuFrames++;
+			}
+			report.lightReferences += frameLightReferences;
+			report.maxClusterLights = std::max(report.maxClusterLights, frameMaxClusterLights);
+			if (frameShadedSamplesValid)
+			{
+				report.shadedSamples += frameShadedSamples;
+				report.shadedSampleFrames++;
+			}
+			double scale = (double)drawn.width / target.width;
+			report.resolutionScaleSum += scale;
+			report.drawnPixels += frameDrawnPixels;
+			report.minResolutionScale = std::min(report.minResolutionScale, scale);
+			if (frameGpuValid)
+			{
+				report.gpuMs += frameGpuMs;
+				report.gpuMsFrames++;
+			}
+		}
+
+		// Keep the window system responsive, input is ignored
+		glfwPollEvents();
+	}
+	finishFrames();
+	report.uniformStalls = frameUniforms.stalls() - stallsBefore;
+	report.shadowStaticRedraws = shadow.staticRedraws() - redrawsBefore;
+	if (frameCapture.isActive())
+	{
+		report.captureFrames = frameCapture.framesCaptured();
+		report.captureDropped = frameCapture.framesDropped();
+		report.captureMs = frameCapture.renderThreadMs();
+		frameCapture.stop();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	destroyFramebuffer(target);
+
+	return report.write(outFile) ? 0 : -1;
+}
+
+// Render the camera path on the CPU and write each frame to an image, without a
+// window or GL context. With more than one frame, out.tga becomes out_0000.tga,
+// out_0001.tga and so on. Only the main light is drawn, not the --lights lanterns
+int runSoftware(int frameCount, const std::string& sceneFile, const std::string& pathFile, const std::string& outFile)
+{
+	if (!scene.load(sceneFile))
+	{
+		std::cout << "Scene " << sceneFile << " not found, using the default scene" << std::endl;
+		scene.makeDefault();
+	}
+
+	// The same meshes and materials loadScene gives the GPU, each texture loaded once.
+	// The terrain's indices are picked for the camera every frame
+	std::unordered_map<std::string, SoftTexture> textures;
+	std::vector<SoftMesh> meshes(scene.meshes.size());
+	std::vector<SoftMaterial> meshMaterials(scene.meshes.size());
+	for (size_t i = 0; i < scene.meshes.size(); i++)
+	{
+		const SceneMesh& mesh = scene.meshes[i];
+		std::string materialName = mesh.material;
+		if (mesh.path == "@floor")
+		{
+			floorMesh = (int)i;
+			terrain.generate(terrainSettings);
+			meshes[i].vertices = terrain.vertices();
+		}
+		else
+		{
+			objl::Loader loader;
+			if (!loadObject(loader, mesh.path))
+			{
+				std::cout << "Obj file not found " << mesh.path << std::endl;
+				continue;
+			}
+			if (materialName.empty() && !loader.LoadedMeshes.empty())
+				materialName = loader.LoadedMeshes[0].MeshMaterial.name;
+			meshes[i].vertices = loadVertices(loader);
+			meshes[i].indices = loadIndices(std::move(loader));
+		}
+
+		// The scene's materials stand in for the MTL files that are not shipped
+		SoftMaterial& material = meshMaterials[i];
+		material.specularColor = MATERIAL_DEFAULT_SPECULAR;
+		material.shininess = MATERIAL_DEFAULT_SHININESS;
+		for (size_t m = 0; m < scene.materials.size(); m++)
+		{
+			const SceneMaterial& sceneMaterial = scene.materials[m];
+			if (sceneMaterial.name != materialName)
+				continue;
+			if (sceneMaterial.matte)
+				material.specularColor = glm::vec3(0.0f);
+			if (!textures.count(sceneMaterial.diffuse) && !loadSoftTexture(sceneMaterial.diffuse.c_str(), textures[sceneMaterial.diffuse]))
+				std::cout << sceneMaterial.diffuse << " could not be opened" << std::endl;
+			const SoftTexture& texture = textures[sceneMaterial.diffuse];
+			material.diffuse = texture.rgba.empty() ? NULL : &texture;
+		}
+	}
+
+	CameraPath path;
+	if (pathFile.empty() || !path.load(pathFile))
+	{
+		if (!pathFile.empty())
+			std::cout << "Camera path " << pathFile << " not found, using the default path" << std::endl;
+		path.makeDefault();
+	}
+
+	SoftRasterizer rasterizer;
+	rasterizer.resize(WIDTH, HEIGHT);
+	rasterizer.setLight(lightPos, glm::vec3(1.0f));
+	rasterizer.setClearColor(glm::vec3(0.2f, 0.3f, 0.3f));
+	glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WIDTH / (GLfloat)HEIGHT, NEAR_PLANE, FAR_PLANE);
+
+	bool written = true;
+	double totalMs = 0.0;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		double time = frame * BENCH_TIMESTEP;
+		path.evaluate(time, cameraPos, yaw, pitch);
+		updateCameraFront();
+		scene.animate(time);
+
+		glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+		rasterizer.setCamera(view, projection, cameraPos);
+		for (size_t i = 0; i < scene.objects.size(); i++)
+		{
+			const SceneObject& object = scene.objects[i];
+			if ((int)object.mesh == floorMesh)
+			{
+				MeshletDrawList chunks;
+				terrain.select(scene.world(object), projection * view, cameraPos, chunks);
+				meshes[object.mesh].indices.clear();
+				terrain.expand(chunks, meshes[object.mesh].indices);
+			}
+			rasterizer.draw(meshes[object.mesh], scene.world(object), meshMaterials[object.mesh]);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		rasterizer.render();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		totalMs += ms;
+
+		std::string name = frameCount > 1 ? numberedPath(outFile, frame) : outFile;
+		written = writeImage(name, rasterizer.width(), rasterizer.height(), &rasterizer.pixels()[0]) && written;
+		std::cout << name << ": " << ms << " ms, " << rasterizer.triangles() << " triangles" << std::endl;
+	}
+	if (frameCount > 0)
+		std::cout << frameCount << " frames on " << jobs::threadCount() << " threads, "
+			<< totalMs / frameCount << " ms per frame" << std::endl;
+
+	jobs::shutdown();
+	return written ? 0 : -1;
+}
+
+// Pack the scene file and everything it loads, so a run with --pack needs no other file
+int makePack(const std::string& sceneFile, const std::string& packFile, bool compress)
+{
+	Scene source;
+	if (!source.load(sceneFile))
+	{
+		std::cout << "ERROR::SCENE::NOT_FOUND " << sceneFile << std::endl;
+		return -1;
+	}
+
+	std::vector<std::string> files(1, sceneFile);
+	for (size_t i = 0; i < source.materials.size(); i++)
+	{
+		if (!source.materials[i].diffuse.empty())
+			files.push_back(source.materials[i].diffuse);
+	}
+	for (size_t i = 0; i < source.meshes.size(); i++)
+	{
+		if (source.meshes[i].path != "@floor")
+			files.push_back(source.meshes[i].path);
+	}
+	for (size_t i = 0; SHADER_FILES[i] != NULL; i++)
+		files.push_back(SHADER_FILES[i]);
+
+	return pack::write(packFile, files, compress) ? 0 : -1;
+}
+
+// Open the pack given on the command line, otherwise assets.pack in the working
+// directory or next to the executable. No pack leaves every asset loose
+void openPack(const std::string& packFile, const char* executable)
+{
+	auto start = std::chrono::steady_clock::now();
+	bool opened = false;
+	if (!packFile.empty())
+	{
+		opened = pack::open(packFile);
+		if (!opened)
+			std::cout << "ERROR::PACK::NOT_FOUND " << packFile << std::endl;
+	}
+	else
+	{
+		std::string directory = executable;
+		size_t slash = directory.find_last_of("/\\");
+		directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+		opened = pack::open("assets.pack") || (!directory.empty() && pack::open(directory + "assets.pack"));
+	}
+
+	if (opened)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		loadTimings.push_back(std::make_pair(std::string("pack"), elapsed.count()));
+	}
+}
+
+// Stop the workers and free every GL object while the context is still current.
+// Both the benchmark and the interactive exit call this before glfwTerminate
+void destroyResources()
+{
+	jobs::shutdown();
+	shaders::shutdown();
+	profiler::shutdown();
+	glDeleteVertexArrays((GLsizei)VAOs.size(), VAOs.data());
+	glDeleteBuffers((GLsizei)VBOs.size(), VBOs.data());
+	glDeleteBuffers((GLsizei)EBOs.size(), EBOs.data());
+	frameUniforms.destroy();
+	clusterData.destroy();
+	glDeleteVertexArrays((GLsizei)depthVAOs.size(), depthVAOs.data());
+	glDeleteBuffers((GLsizei)depthVBOs.size(), depthVBOs.data());
+	glDeleteQueries(SAMPLE_QUERY_COUNT, sampleQueries);
+	glDeleteTextures(3, clusterTextures);
+	gpuFrameTimer.destroy();
+	glDeleteVertexArrays(1, &upscaleVAO);
+	glDeleteVertexArrays(1, &flockVAO);
+	flockInstances.destroy();
+	shadow.destroy();
+	gpuShadowTimer.destroy();
+	destroyFramebuffer(sceneTarget);
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
+	// Command line: --bench [frames] [--bench-out file.json|-] [--camera-path file] [--egl]
+	//	[--scene file] [--bake-scene file.sceneb] [--pipeline depth] [--sim-rate hz] [--lights count]
+	//	[--depth-prepass] [--overdraw] [--software [frames]] [--software-out file.png|file.tga|file.ppm]
+	//	[--pack file] [--make-pack file [--pack-compress]] [--frame-budget ms] [--min-scale s] [--sharpen amount]
+	//	[--capture file.y4m|file.png] [--bench-size WxH] [--flock count] [--terrain size]
+	//	[--no-shadows] [--no-shadow-cache] [--shadow-size texels]
+	bool bench = false;
+	bool software = false;
+	int softwareFrames = 1;
+	std::string softwareOut = "software.tga";
+	bool useEGL = false;
+	int benchFrames = 600;
+	std::string benchOut = "benchmark.json";
+	std::string cameraPathFile;
+	std::string sceneFile = "scenes/default.scene";
+	std::string bakeFile;
+	std::string packFile;
+	std::string makePackFile;
+	bool packCompress = false;
+	double frameBudget = 1000.0 / 60.0;
+	float minScale = 0.5f;
+	bool capture = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--bench")
+		{
+			bench = true;
+			if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+				benchFrames = atoi(argv[++i]);
+		}
+		else if (arg == "--software")
+		{
+			software = true;
+			if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0]))
+				softwareFrames = atoi(argv[++i]);
+		}
+		else if (arg == "--software-out" && i + 1 < argc)
+			softwareOut = argv[++i];
+		else if (arg == "--bench-out" && i + 1 < argc)
+			benchOut = argv[++i];
+		else if (arg == "--camera-path" && i + 1 < argc)
+			cameraPathFile = argv[++i];
+		else if (arg == "--egl")
+			useEGL = true;
+		else if (arg == "--scene" && i + 1 < argc)
+			sceneFile = argv[++i];
+		else if (arg == "--bake-scene" && i + 1 < argc)
+			bakeFile = argv[++i];
+		else if (arg == "--pack" && i + 1 < argc)
+			packFile = argv[++i];
+		else if (arg == "--make-pack" && i + 1 < argc)
+			makePackFile = argv[++i];
+		else if (arg == "--pack-compress")
+			packCompress = true;
+		else if (arg == "--frame-budget" && i + 1 < argc)
+		{
+			dynamicResolution = true;
+			frameBudget = std::max(0.1, atof(argv[++i]));
+		}
+		else if (arg == "--min-scale" && i + 1 < argc)
+			minScale = (float)std::max(0.1, std::min(1.0, atof(argv[++i])));
+		else if (arg == "--capture" && i + 1 < argc)
+		{
+			capture = true;
+			capturePath = argv[++i];
+		}
+		else if (arg == "--bench-size" && i + 1 < argc)
+		{
+			int width = 0, height = 0;
+			if (sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0)
+			{
+				benchWidth = width;
+				benchHeight = height;
+			}
+		}
+		else if (arg == "--sharpen" && i + 1 < argc)
+			upscaleSharpness = (float)std::max(0.0, atof(argv[++i]));
+		else if (arg == "--pipeline" && i + 1 < argc)
+			pipelineDepth = std::max(1, std::min(MAX_PIPELINE_DEPTH, atoi(argv[++i])));
+		else if (arg == "--depth-prepass")
+			depthPrepass = true;
+		else if (arg == "--overdraw")
+			showOverdraw = true;
+		else if (arg == "--flock" && i + 1 < argc)
+			flockCount = (unsigned int)std::max(0, atoi(argv[++i]));
+		else if (arg == "--terrain" && i + 1 < argc)
+			terrainSettings.size = std::max(terrainSettings.chunkSize, (float)atof(argv[++i]));
+		else if (arg == "--no-shadows")
+			shadowsEnabled = false;
+		else if (arg == "--no-shadow-cache")
+			shadowCache = false;
+		else if (arg == "--shadow-size" && i + 1 < argc)
+			shadowSize = std::max(16, atoi(argv[++i]));
+		else if (arg == "--lights" && i + 1 < argc)
+			pointLightCount = (unsigned int)std::max(0, atoi(argv[++i]));
+		else if (arg == "--sim-rate" && i + 1 < argc)
+			simRate = std::max(1.0, atof(argv[++i]));
+	}
+
+	// Convert the scene to the binary form and stop, no window is needed
+	if (!bakeFile.empty())
+	{
+		Scene source;
+		if (!source.load(sceneFile))
+		{
+			std::cout << "ERROR::SCENE::NOT_FOUND " << sceneFile << std::endl;
+			return -1;
+		}
+		return source.saveBinary(bakeFile) ? 0 : -1;
+	}
+
+	// Gather the scene's assets into one file and stop
+	if (!makePackFile.empty())
+		return makePack(sceneFile, makePackFile, packCompress);
+
+	openPack(packFile, argv[0]);
+
+	// Render on the CPU for machines without a GPU, no window is needed either
+	if (software)
+		return runSoftware(softwareFrames, sceneFile, cameraPathFile, softwareOut);
+
 	//++++create a glfw window+++++++++++++++++++++++++++++++++++++++
 	GLFWwindow* window;
 
 	if (!glfwInit()) //Initialize the library
 		return -1;
 
+	// The benchmark renders offscreen, so the window is never shown. EGL lets
+	// Mesa (llvmpipe) run without a visible display server
+	if (bench)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	if (useEGL)
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+
 	window = glfwCreateWindow(WIDTH, HEIGHT, "OpenGL Window", NULL, NULL);
 	if (!window)
 	{
@@ -151,180 +1802,136 @@ int main(void)
 	}
 
 	glfwMakeContextCurrent(window);//Make the window's context current
-								   
-	glfwSetKeyCallback(window, key_callback);// Set the required callback functions
 
-	glfwSetCursorPosCallback(window, mouse_callback);
+	if (!bench)
+	{
+		glfwSetKeyCallback(window, key_callback);// Set the required callback functions
+
+		glfwSetCursorPosCallback(window, mouse_callback);
+
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+		// GLFW Options
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
+	else
+	{
+		// Never wait for vsync while measuring
+		glfwSwapInterval(0);
+	}
 
-	// GLFW Options
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	
 	//++++Initialize GLEW to setup the OpenGL Function pointers+++++++
 	glewExperimental = GL_TRUE;
 	glewInit();
 
+	profiler::init();
+
 	//++++Define the viewport dimensions++++++++++++++++++++++++++++
-	glViewport(0, 0, HEIGHT, HEIGHT);
+	// On high DPI screens the framebuffer has more pixels than the window has units
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	glViewport(0, 0, framebufferWidth, framebufferHeight);
+	resolution.configure(frameBudget, minScale);
 
 	// Setup OpenGL options
 	glEnable(GL_DEPTH_TEST);
 
-	glGenVertexArrays(4, VAOs);
-	glGenBuffers(4, VBOs);
-	glGenBuffers(4, EBOs);
-
-	// Load textures
-	GLuint WatchTexture = loadDDS("textures/watchtower.dds", 0);
-	GLuint FirTexture = loadDDS("textures/fir.dds", 1);
-	GLuint FloorTexture = loadDDS("textures/floor1.dds", 2);
-	GLuint RavenTexture = loadDDS("textures/raven.dds", 3);
-	
-	// Set up objects and buffers
-	std::vector<GLuint> indices = setUpObject("objects/watchtower.obj", 0);
-	std::vector<GLuint> indices1 = setUpObject("objects/fir.obj", 1);
-	// missing 2 because it is used for the ground
-	std::vector<GLuint> indices2 = setUpObject("objects/raven.obj", 3);
-
-	// ================================
-	// buffer setup shape 3 ground
-	// ===============================
-
-	glBindVertexArray(VAOs[2]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(floorVector), floorVector, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBOs[2]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(floorVector), floorVector, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOs[2]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(floorIndices), floorIndices, GL_STATIC_DRAW);
-
-	// Vertex attributes stay the same
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// Normal attribute
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(1);
+	loadScene(sceneFile);
+	setUpLights();
+	setUpFlock();
+	jobs::init();
 
-	// Texture coords attribute
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-	glEnableVertexAttribArray(2);
+	if (bench)
+	{
+		int result = runBenchmark(benchFrames, cameraPathFile, benchOut, capture);
+		destroyResources();
+		glfwTerminate();
+		return result;
+	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	// The simulation steps at a fixed rate whatever the frame rate, frames are
+	// drawn between the last two steps
+	SimClock clock(1.0 / simRate);
+	double lastTime = glfwGetTime();
 
-	//++++++++++Build and compile shader program+++++++++++++++++++++
-	GLuint shaderProgram = initShader("vert.glsl","frag.glsl");
+	if (capture)
+		frameCapture.start(capturePath);
 
-	// use shader
-	glUseProgram(shaderProgram);
-	GLint lightColorLoc = glGetUniformLocation(shaderProgram, "lightColor");
-	GLint lightPosLoc = glGetUniformLocation(shaderProgram, "lightPos");
-	GLint viewPosLoc = glGetUniformLocation(shaderProgram, "viewPos");
-	glUniform3f(lightColorLoc, 1.0f, 1.0f, 1.0f);
-	glUniform3f(lightPosLoc, lightPos.x, lightPos.y, lightPos.z);
-	glUniform3f(viewPosLoc, cameraPos.x, cameraPos.y, cameraPos.z);
+	// The frames after the first are built while the ones before them are drawn
+	unsigned long long frameNumber = 0;
+	for (int ahead = 0; ahead < pipelineDepth - 1; ahead++)
+		launchFrame(frames[ahead], clock.renderTime(), cameraPos);
 
 	//++++++++++++++++++++++++++++++++++++++++++++++
 	/* Loop until the user closes the window */
+	std::string lastSummary;
 	while (!glfwWindowShouldClose(window))
 	{
-		// Calculate deltatime of current frame
-		GLfloat currentFrame = (GLfloat) glfwGetTime();
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-		do_movement();
+		// Nothing to draw into while minimised
+		if (framebufferWidth == 0 || framebufferHeight == 0)
+		{
+			glfwWaitEvents();
+			lastTime = glfwGetTime();
+			continue;
+		}
 
-		/* Render here */
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		profiler::beginFrame();
+
+		double now = glfwGetTime();
+		int steps = clock.advance(now - lastTime);
+		lastTime = now;
+		{
+			PROFILE_SCOPE("Simulation");
+			for (int step = 0; step < steps; step++)
+			{
+				previousCameraPos = cameraPos;
+				do_movement(clock.step());
+			}
+		}
 
-		// ==================
-		// draw watchtower
-		// ==================
-
-		glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), WatchTexture - 1); // Load texture into shader
-		// Create transformations
-		glm::mat4 model;
-		glm::mat4 view;
-		glm::mat4 projection;
-		glm::mat4 transform;
-		
-		view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-		projection = glm::perspective(45.0f, (GLfloat)WIDTH / (GLfloat)HEIGHT, 0.1f, 100.0f);
-
-		// Get their uniform location
-		GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-		GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-		GLint projLoc = glGetUniformLocation(shaderProgram, "projection");
-		GLint transformLoc = glGetUniformLocation(shaderProgram, "transform");
-
-		// Pass them to the shaders
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-		glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-		glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-		glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transform));
-
-		// draw object
-		glBindVertexArray(VAOs[0]);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-		glBindVertexArray(0);
-
-		// ==================
-		// draw tree
-		// ==================
-		
-		glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), FirTexture - 1); // Load texture into shader
-		model = glm::translate(model, glm::vec3(2.0f, 0.0f, -7.0f));
-		model = glm::scale(model, glm::vec3(1.5f, 1.5f, 1.5f));
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-		glBindVertexArray(VAOs[1]);
-		glDrawElements(GL_TRIANGLES, indices1.size(), GL_UNSIGNED_INT, 0);
-
-		glBindVertexArray(0);
-
-		// ==================
-		// draw floor
-		// ==================
-
-		glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), FloorTexture - 1); // Load texture into shader
-		model = glm::translate(model, glm::vec3(-10.0f, 0.46f, 40.0f));
-		model = glm::scale(model, glm::vec3(10.0f, 10.0f, 10.0f));
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-		glBindVertexArray(VAOs[2]);
-		glDrawElements(GL_TRIANGLES, sizeof(floorIndices), GL_UNSIGNED_INT, 0);
-
-		glBindVertexArray(0);
-
-		// ==================
-		// draw bird
-		// ==================
-
-		glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), RavenTexture - 1); // Load texture into shader
-		// Handles orbiting about watchtower and angle of bird
-		model = glm::translate(model, glm::vec3(0.85f, 0.35f, -3.55f));
-		model = glm::rotate(model, (GLfloat)glfwGetTime() * 1.0f, glm::vec3(0.0f, 1.0f, 0.0f)); 
-		model = glm::translate(model, glm::vec3(0.15f, 0.0f, -0.45f));
-		model = glm::rotate(model, (GLfloat)(3.14 / 4), glm::vec3(1.0f, 0.0f, 0.0f));
-		model = glm::rotate(model, (GLfloat)(3.14 / 2), glm::vec3(0.0f, -1.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(0.02f, 0.02f, 0.02f));
-
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-		glBindVertexArray(VAOs[3]);
-		glDrawElements(GL_TRIANGLES, indices2.size(), GL_UNSIGNED_INT, 0);
-
-		glBindVertexArray(0);
+		pollShaders();
+		glm::vec3 renderPos = glm::mix(previousCameraPos, cameraPos, (float)clock.alpha());
+		launchFrame(frames[(frameNumber + pipelineDepth - 1) % pipelineDepth], clock.renderTime(), renderPos);
+		drawFrame(frames[frameNumber % pipelineDepth], 0, framebufferWidth, framebufferHeight);
+		frameNumber++;
 
 		/* Swap front and back buffers */
-		glfwSwapBuffers(window);
+		{
+			PROFILE_SCOPE("Swap");
+			glfwSwapBuffers(window);
+		}
+
+		profiler::endFrame();
+
+		// Show the rolling profile summary and the state changes in the title bar
+		std::string summary = profiler::frameSummary();
+		if (!summary.empty())
+		{
+			summary += " | binds " + std::to_string(frameStateChanges.total()) +
+				" (unsorted " + std::to_string(frameUnsortedStateChanges) +
+				", redundant skipped " + std::to_string(frameStateChanges.redundant) + ")";
+			char overdraw[32];
+			snprintf(overdraw, sizeof(overdraw), "%.2f", (double)frameShadedSamples / frameDrawnPixels);
+			summary += std::string(" | shaded ") + overdraw + "/px" + (depthPrepass ? " (pre-pass)" : "");
+			if (dynamicResolution)
+			{
+				char scale[64];
+				snprintf(scale, sizeof(scale), " | %.0f%% res, GPU %.1f/%.1f ms", resolution.scale() * 100.0f, frameGpuMs, resolution.budget());
+				summary += scale;
+			}
+		}
+		if (summary != lastSummary)
+		{
+			lastSummary = summary;
+			glfwSetWindowTitle(window, ("OpenGL Window | " + lastSummary).c_str());
+		}
 
 		/* Poll for and process events */
 		glfwPollEvents();
 	}
+	finishFrames();
+	frameCapture.stop();
 	// Properly de-allocate all resources once they've outlived their purpose
-	glDeleteVertexArrays(1, VAOs);
-	glDeleteBuffers(1, VBOs);
+	destroyResources();
 
 	glfwTerminate();
 	return 0;
@@ -335,6 +1942,30 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
+	// F1 toggles the profiler, F2 records a trace of the next 120 frames
+	if (key == GLFW_KEY_F1 && action == GLFW_PRESS)
+		profiler::setEnabled(!profiler::isEnabled());
+	if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+		profiler::captureTrace(120, "profile_trace.json");
+	// F3 toggles the depth pre-pass, F4 the overdraw view
+	if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+		depthPrepass = !depthPrepass;
+	if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+		showOverdraw = !showOverdraw;
+	// F5 toggles dynamic resolution
+	if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+		dynamicResolution = !dynamicResolution;
+	// F6 starts and stops recording to the --capture file, capture.y4m by default
+	if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+	{
+		if (frameCapture.isActive())
+			frameCapture.stop();
+		else
+			frameCapture.start(capturePath);
+	}
+	// F7 turns the light 30 degrees about the scene, which redraws the static shadows
+	if (key == GLFW_KEY_F7 && action == GLFW_PRESS)
+		lightPos = glm::vec3(glm::rotate(glm::mat4(1.0f), glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(lightPos, 1.0f));
 	if (key >= 0 && key < 1024)
 	{
 		if (action == GLFW_PRESS)
@@ -346,10 +1977,11 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 
 
-void do_movement()
+// Advance the camera by one simulation step
+void do_movement(double seconds)
 {
 	// Camera controls
-	GLfloat cameraSpeed = 5.0f * deltaTime;
+	GLfloat cameraSpeed = (GLfloat)(5.0 * seconds);
 	if (keys[GLFW_KEY_W])
 		cameraPos += cameraSpeed * cameraFront;
 	if (keys[GLFW_KEY_S])
@@ -360,6 +1992,13 @@ void do_movement()
 		cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 }
 
+// Frames launched from now on are sized for the new framebuffer
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+	framebufferWidth = width;
+	framebufferHeight = height;
+}
+
 bool firstMouse = true;
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
@@ -388,6 +2027,12 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 	if (pitch < -89.0f)
 		pitch = -89.0f;
 
+	updateCameraFront();
+}
+
+// Rebuild the view direction from the yaw and pitch angles
+void updateCameraFront()
+{
 	glm::vec3 front;
 	front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
 	front.y = sin(glm::radians(pitch));
@@ -0,0 +1,172 @@
+// Material registry: hashed names, MTL texture map resolution and binding
+
+#include <stdio.h>
+
+#include "material.h"
+#include "OBJ-Loader.h"
+#include "texture.hpp"
+
+static bool fileExists(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	fclose(file);
+	return true;
+}
+
+// Find the DDS file for a texture map. MTL files usually name the source image
+// (often with a Windows path), the converted DDS lives in textures/ under the same name
+static std::string findTexture(const std::string& mapPath, const std::string& objectPath)
+{
+	if (mapPath.empty())
+		return "";
+
+	std::string path = mapPath;
+	for (size_t i = 0; i < path.size(); i++)
+		if (path[i] == '\\')
+			path[i] = '/';
+
+	size_t slash = objectPath.find_last_of('/');
+	std::string objectDir = slash == std::string::npos ? "" : objectPath.substr(0, slash + 1);
+
+	std::string base = path.substr(path.find_last_of('/') + 1);
+	size_t dot = base.find_last_of('.');
+	if (dot != std::string::npos)
+		base = base.substr(0, dot);
+
+	const std::string candidates[] = { objectDir + path, "textures/" + base + ".dds" };
+	for (const std::string& candidate : candidates)
+	{
+		size_t length = candidate.size();
+		if (length > 4 && candidate.compare(length - 4, 4, ".dds") == 0 && fileExists(candidate))
+			return candidate;
+	}
+
+	std::cout << "ERROR::MATERIAL::TEXTURE_NOT_FOUND " << mapPath << std::endl;
+	return "";
+}
+
+MaterialRegistry::MaterialRegistry()
+	: white(0)
+{
+}
+
+unsigned int MaterialRegistry::hashName(const std::string& name)
+{
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < name.size(); i++)
+		hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+	return hash;
+}
+
+int MaterialRegistry::find(const std::string& name) const
+{
+	std::unordered_map<unsigned int, std::vector<unsigned int> >::const_iterator bucket = byHash.find(hashName(name));
+	if (bucket == byHash.end())
+		return -1;
+
+	// Names that collide share a bucket
+	for (size_t i = 0; i < bucket->second.size(); i++)
+		if (materials[bucket->second[i]].name == name)
+			return (int)bucket->second[i];
+	return -1;
+}
+
+unsigned int MaterialRegistry::add(const RenderMaterial& material)
+{
+	int existing = find(material.name);
+	if (existing >= 0)
+	{
+		materials[existing] = material;
+		return (unsigned int)existing;
+	}
+
+	unsigned int id = (unsigned int)materials.size();
+	materials.push_back(material);
+	materials.back().nameHash = hashName(material.name);
+	byHash[materials.back().nameHash].push_back(id);
+	return id;
+}
+
+GLuint MaterialRegistry::texture(const std::string& path)
+{
+	if (white == 0)
+		white = createSolidTexture(255, 255, 255);
+	if (path.empty())
+		return white;
+
+	std::unordered_map<std::string, GLuint>::const_iterator found = textures.find(path);
+	if (found != textures.end())
+		return found->second;
+
+	GLuint id = loadDDS(path.c_str());
+	if (id == 0)
+		id = white;
+	textures[path] = id;
+	return id;
+}
+
+unsigned int MaterialRegistry::addFallback(const std::string& name, const std::string& diffusePath, bool specular)
+{
+	RenderMaterial material;
+	material.name = name;
+	material.diffuseTexture = texture(diffusePath);
+	material.specularTexture = texture("");
+	material.specularColor = specular ? MATERIAL_DEFAULT_SPECULAR : glm::vec3(0.0f);
+	material.shininess = MATERIAL_DEFAULT_SHININESS;
+	return add(material);
+}
+
+unsigned int MaterialRegistry::resolve(const objl::Material& material, const std::string& objectPath)
+{
+	std::string name = material.name.empty() ? "default" : material.name;
+
+	// No MTL data for this material, use what was registered for it if anything
+	bool hasData = !material.map_Kd.empty() || !material.map_Ks.empty() || material.Ns > 0.0f;
+	int existing = find(name);
+	if (!hasData)
+		return existing >= 0 ? (unsigned int)existing : addFallback(name, "");
+
+	RenderMaterial resolved;
+	resolved.name = name;
+	resolved.diffuseTexture = texture(findTexture(material.map_Kd, objectPath));
+	resolved.specularTexture = texture(findTexture(material.map_Ks, objectPath));
+
+	// A diffuse map that could not be found keeps a fallback's texture
+	if (resolved.diffuseTexture == white && existing >= 0)
+		resolved.diffuseTexture = materials[existing].diffuseTexture;
+
+	glm::vec3 ks(material.Ks.X, material.Ks.Y, material.Ks.Z);
+	resolved.specularColor = ks == glm::vec3(0.0f) ? MATERIAL_DEFAULT_SPECULAR : ks;
+	resolved.shininess = material.Ns >= 1.0f ? material.Ns : MATERIAL_DEFAULT_SHININESS;
+	return add(resolved);
+}
+
+MaterialUniforms MaterialUniforms::locate(GLuint program)
+{
+	MaterialUniforms uniforms;
+	uniforms.specularColor = glGetUniformLocation(program, "specularColor");
+	uniforms.shininess = glGetUniformLocation(program, "shininess");
+	return uniforms;
+}
+
+void MaterialRegistry::apply(unsigned int id, const MaterialUniforms& uniforms) const
+{
+	const RenderMaterial& material = materials[id];
+
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_DIFFUSE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, material.diffuseTexture);
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_SPECULAR_UNIT);
+	glBindTexture(GL_TEXTURE_2D, material.specularTexture);
+
+	glUniform3f(uniforms.specularColor, material.specularColor.x, material.specularColor.y, material.specularColor.z);
+	glUniform1f(uniforms.shininess, material.shininess);
+}
+
+void MaterialRegistry::setSamplerUnits(GLuint program)
+{
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "texture1"), MATERIAL_DIFFUSE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "specularMap"), MATERIAL_SPECULAR_UNIT);
+}
@@ -0,0 +1,90 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+namespace objl
+{
+	struct Material;
+}
+
+// Texture units the material samplers live on
+const GLint MATERIAL_DIFFUSE_UNIT = 0;
+const GLint MATERIAL_SPECULAR_UNIT = 1;
+
+// Defaults that match the lighting the shader used before materials existed
+const glm::vec3 MATERIAL_DEFAULT_SPECULAR(0.5f, 0.5f, 0.5f);
+const float MATERIAL_DEFAULT_SHININESS = 32.0f;
+
+// Locations of the per-material uniforms in one program, -1 where it has none
+struct MaterialUniforms
+{
+	GLint specularColor;
+	GLint shininess;
+
+	static MaterialUniforms locate(GLuint program);
+};
+
+// Everything a draw needs from a material, textures are shared between materials
+struct RenderMaterial
+{
+	std::string name;
+	unsigned int nameHash;
+	GLuint diffuseTexture;
+	GLuint specularTexture;
+	glm::vec3 specularColor;
+	float shininess;
+};
+
+// Material names hashed to small ids, with MTL texture maps resolved to the DDS
+// files in textures/. Each texture file is only loaded once
+class MaterialRegistry
+{
+public:
+	MaterialRegistry();
+
+	// FNV-1a hash of a material name
+	static unsigned int hashName(const std::string& name);
+
+	// Register a material with a known diffuse texture, for models whose MTL
+	// file is missing. Later calls with the same name replace the texture
+	unsigned int addFallback(const std::string& name, const std::string& diffusePath, bool specular = true);
+
+	// Id for a material read by the OBJ loader. Texture maps are looked for next
+	// to the model and as textures/<name>.dds, a material without any texture
+	// data falls back to one registered under the same name
+	unsigned int resolve(const objl::Material& material, const std::string& objectPath);
+
+	// Id of a registered name, or -1
+	int find(const std::string& name) const;
+
+	const RenderMaterial& get(unsigned int id) const { return materials[id]; }
+	size_t size() const { return materials.size(); }
+
+	// True if the material has a specular highlight at all
+	bool hasSpecular(unsigned int id) const { return materials[id].specularColor != glm::vec3(0.0f); }
+
+	// Bind the textures and set the material uniforms of the bound program
+	void apply(unsigned int id, const MaterialUniforms& uniforms) const;
+
+	// Point the material samplers of program at their texture units
+	static void setSamplerUnits(GLuint program);
+
+private:
+	unsigned int add(const RenderMaterial& material);
+	GLuint texture(const std::string& path);
+
+	std::vector<RenderMaterial> materials;
+	std::unordered_map<unsigned int, std::vector<unsigned int> > byHash;
+	std::unordered_map<std::string, GLuint> textures;
+	GLuint white;
+};
+
+#endif
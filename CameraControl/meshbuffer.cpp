@@ -0,0 +1,64 @@
+// Conversion of loaded OBJ data into the vertex layout used by the GPU buffers
+
+#include "meshbuffer.h"
+#include "pack.h"
+
+bool loadObject(objl::Loader& loader, const std::string& path) {
+	pack::Asset file;
+	if (pack::load(path, file))
+		return loader.LoadFromMemory(file.data, file.size, path);
+	return loader.LoadFile(path);
+}
+
+std::vector<float> loadVertices(const objl::Loader& loader) {
+	std::vector<float> vertices;
+	vertices.reserve(loader.LoadedVertices.size() * 9);
+
+	// Every mesh is a range of the loader's vertex list, so one pass covers them all
+	for (size_t i = 0; i < loader.LoadedVertices.size(); i++) {
+		const objl::Vertex& vertex = loader.LoadedVertices[i];
+
+		vertices.push_back(vertex.Position.X);
+		vertices.push_back(vertex.Position.Y);
+		vertices.push_back(vertex.Position.Z);
+
+		vertices.push_back(vertex.Normal.X);
+		vertices.push_back(vertex.Normal.Y);
+		vertices.push_back(vertex.Normal.Z);
+
+		vertices.push_back(vertex.TextureCoordinate.X);
+		vertices.push_back(1 - (vertex.TextureCoordinate.Y)); // Inverted coordinates due to opengl
+		vertices.push_back(0); // Unused value
+	}
+
+	return vertices;
+}
+
+void loadMeshSoA(const objl::Loader& loader, MeshSoA& mesh) {
+	mesh.resize(loader.LoadedVertices.size());
+
+	for (size_t i = 0; i < loader.LoadedVertices.size(); i++) {
+		const objl::Vertex& vertex = loader.LoadedVertices[i];
+
+		mesh.positionX[i] = vertex.Position.X;
+		mesh.positionY[i] = vertex.Position.Y;
+		mesh.positionZ[i] = vertex.Position.Z;
+
+		mesh.normalX[i] = vertex.Normal.X;
+		mesh.normalY[i] = vertex.Normal.Y;
+		mesh.normalZ[i] = vertex.Normal.Z;
+
+		mesh.texCoordU[i] = vertex.TextureCoordinate.X;
+		mesh.texCoordV[i] = vertex.TextureCoordinate.Y;
+	}
+
+	mesh.indices = loader.LoadedIndices;
+}
+
+std::vector<unsigned int> loadIndices(const objl::Loader& loader) {
+	return loader.LoadedIndices;
+}
+
+std::vector<unsigned int> loadIndices(objl::Loader&& loader) {
+	return std::move(loader.LoadedIndices);
+}
@@ -0,0 +1,26 @@
+#ifndef MESHBUFFER_H
+#define MESHBUFFER_H
+
+#include <vector>
+
+#include "OBJ-Loader.h"
+#include "meshsoa.h"
+
+// Load an .obj file from the open asset pack, or from disk when the pack does not hold it
+bool loadObject(objl::Loader& loader, const std::string& path);
+
+// Interleave the loaded vertices as 9 floats each:
+// position (3), normal (3), texture coordinate (2, V flipped for OpenGL), padding (1)
+std::vector<float> loadVertices(const objl::Loader& loader);
+
+// Split the loaded vertices into attribute streams and copy the index list,
+// the streams feed the SIMD kernels in meshsoa.h and interleaveVertices
+void loadMeshSoA(const objl::Loader& loader, MeshSoA& mesh);
+
+// Copy the loaded index list
+std::vector<unsigned int> loadIndices(const objl::Loader& loader);
+
+// Take over the loaded index list without copying, the loader is left without indices
+std::vector<unsigned int> loadIndices(objl::Loader&& loader);
+
+#endif
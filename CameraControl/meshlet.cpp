@@ -0,0 +1,227 @@
+// Meshlet partitioning and culling, bounds follow the approach used by meshoptimizer
+
+#include <math.h>
+#include <stdint.h>
+
+#include "meshlet.h"
+
+static const unsigned int NO_SLOT = 0xFFFFFFFF;
+
+static glm::vec3 fetchPosition(const float* positions, size_t stride, unsigned int index)
+{
+	const float* p = positions + index * stride;
+	return glm::vec3(p[0], p[1], p[2]);
+}
+
+// Calculate the bounding sphere and normal cone of the triangles in a meshlet
+static void computeBounds(Meshlet& meshlet, const unsigned int* indices,
+	const float* positions, size_t stride)
+{
+	unsigned int indexCount = meshlet.triangleCount * 3;
+
+	// Bounding sphere around the centre of the box, this is not minimal
+	// but it is cheap and stable
+	glm::vec3 minP = fetchPosition(positions, stride, indices[0]);
+	glm::vec3 maxP = minP;
+	for (unsigned int i = 1; i < indexCount; i++)
+	{
+		glm::vec3 p = fetchPosition(positions, stride, indices[i]);
+		minP = glm::min(minP, p);
+		maxP = glm::max(maxP, p);
+	}
+	meshlet.center = (minP + maxP) * 0.5f;
+
+	float radiusSq = 0.0f;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		glm::vec3 d = fetchPosition(positions, stride, indices[i]) - meshlet.center;
+		radiusSq = fmaxf(radiusSq, glm::dot(d, d));
+	}
+	meshlet.radius = sqrtf(radiusSq);
+
+	// Normal cone, disabled (cutoff above 1) unless proven useful below
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 2.0f;
+
+	std::vector<glm::vec3> normals(meshlet.triangleCount);
+	glm::vec3 axis(0.0f);
+	for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+	{
+		glm::vec3 p0 = fetchPosition(positions, stride, indices[t * 3 + 0]);
+		glm::vec3 p1 = fetchPosition(positions, stride, indices[t * 3 + 1]);
+		glm::vec3 p2 = fetchPosition(positions, stride, indices[t * 3 + 2]);
+
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(n);
+		normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+		axis += normals[t];
+	}
+
+	float axisLength = glm::length(axis);
+	if (axisLength == 0.0f)
+		return;
+	axis /= axisLength;
+
+	float minDot = 1.0f;
+	for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+	{
+		// Degenerate triangles can never be seen, so they do not widen the cone
+		if (normals[t] == glm::vec3(0.0f))
+			continue;
+		minDot = fminf(minDot, glm::dot(axis, normals[t]));
+	}
+
+	// Cones wider than ~85 degrees almost never cull anything
+	if (minDot <= 0.1f)
+		return;
+
+	// Move the apex back along the axis so every triangle lies in front of it
+	float maxT = 0.0f;
+	for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+	{
+		if (normals[t] == glm::vec3(0.0f))
+			continue;
+		glm::vec3 p0 = fetchPosition(positions, stride, indices[t * 3]);
+		float dc = glm::dot(meshlet.center - p0, normals[t]);
+		float dn = glm::dot(axis, normals[t]);
+		maxT = fmaxf(maxT, dc / dn);
+	}
+
+	meshlet.coneApex = meshlet.center - axis * maxT;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+MeshletData buildMeshlets(const float* positions, size_t stride, size_t vertexCount,
+	const std::vector<unsigned int>& indices,
+	unsigned int maxVertices, unsigned int maxTriangles)
+{
+	MeshletData data;
+	data.indices.reserve(indices.size());
+
+	// Slot of every mesh vertex in the current meshlet, NO_SLOT if unused
+	std::vector<unsigned int> slots(vertexCount, NO_SLOT);
+	std::vector<unsigned int> used;
+	used.reserve(maxVertices);
+
+	Meshlet current = Meshlet();
+
+	auto flush = [&]()
+	{
+		if (current.triangleCount == 0)
+			return;
+
+		current.vertexCount = (unsigned int)used.size();
+		computeBounds(current, &data.indices[current.indexOffset], positions, stride);
+		data.meshlets.push_back(current);
+
+		for (unsigned int i = 0; i < used.size(); i++)
+			slots[used[i]] = NO_SLOT;
+		used.clear();
+
+		current = Meshlet();
+		current.indexOffset = (unsigned int)data.indices.size();
+	};
+
+	// Greedy scan in index order, the loader emits faces in file order
+	// which keeps neighbouring triangles together
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = indices[i + 0];
+		unsigned int b = indices[i + 1];
+		unsigned int c = indices[i + 2];
+
+		unsigned int newVertices = (slots[a] == NO_SLOT) + (slots[b] == NO_SLOT && b != a)
+			+ (slots[c] == NO_SLOT && c != a && c != b);
+
+		if (used.size() + newVertices > maxVertices || current.triangleCount + 1 > maxTriangles)
+			flush();
+
+		unsigned int corners[3] = { a, b, c };
+		for (int k = 0; k < 3; k++)
+		{
+			if (slots[corners[k]] == NO_SLOT)
+			{
+				slots[corners[k]] = (unsigned int)used.size();
+				used.push_back(corners[k]);
+			}
+			data.indices.push_back(corners[k]);
+		}
+		current.triangleCount++;
+	}
+	flush();
+
+	return data;
+}
+
+void cullMeshlets(const MeshletData& data, const glm::mat4& model,
+	const glm::mat4& viewProjection, const glm::vec3& cameraPos,
+	MeshletDrawList& out)
+{
+	out.counts.clear();
+	out.offsets.clear();
+	out.baseVertices.clear();
+	out.visibleMeshlets = 0;
+	out.visibleTriangles = 0;
+	out.frustumCulled = 0;
+	out.coneCulled = 0;
+
+	// Extract the clip planes from the combined matrix (Gribb & Hartmann)
+	glm::mat4 mvp = viewProjection * model;
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2]
+	};
+
+	// The planes are in object space, normalising them keeps the sphere
+	// test in object space units so the radius needs no scaling
+	for (int i = 0; i < 6; i++)
+		planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+
+	glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+
+	unsigned int runEnd = NO_SLOT;
+
+	for (size_t m = 0; m < data.meshlets.size(); m++)
+	{
+		const Meshlet& meshlet = data.meshlets[m];
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = glm::dot(glm::vec3(planes[p]), meshlet.center) + planes[p].w < -meshlet.radius;
+
+		if (outside)
+		{
+			out.frustumCulled++;
+			continue;
+		}
+
+		if (glm::dot(glm::normalize(meshlet.coneApex - localCamera), meshlet.coneAxis) >= meshlet.coneCutoff)
+		{
+			out.coneCulled++;
+			continue;
+		}
+
+		out.visibleMeshlets++;
+		out.visibleTriangles += meshlet.triangleCount;
+
+		// Extend the previous range when the meshlets are adjacent
+		unsigned int count = meshlet.triangleCount * 3;
+		if (runEnd == meshlet.indexOffset)
+		{
+			out.counts.back() += count;
+		}
+		else
+		{
+			out.counts.push_back(count);
+			out.offsets.push_back((const void*)(uintptr_t)(meshlet.indexOffset * sizeof(unsigned int)));
+		}
+		runEnd = meshlet.indexOffset + count;
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Default meshlet limits, sized to match common mesh shader hardware limits
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// A small cluster of triangles with culling bounds (all in object space)
+struct Meshlet
+{
+	unsigned int indexOffset;	// First index of this meshlet in MeshletData::indices
+	unsigned int triangleCount;
+	unsigned int vertexCount;	// Unique vertices referenced by the meshlet
+
+	// Bounding sphere
+	glm::vec3 center;
+	float radius;
+
+	// Normal cone, the meshlet is back facing when
+	// dot(normalize(coneApex - camera), coneAxis) >= coneCutoff
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+// A mesh partitioned into meshlets. indices holds the original
+// index buffer reordered so every meshlet is a contiguous range
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> indices;
+};
+
+// Draw ranges produced by the culler, ready for glMultiDrawElements
+struct MeshletDrawList
+{
+	std::vector<int> counts;
+	std::vector<const void*> offsets;
+	// Added to the indices of each range, empty when they index the mesh directly
+	std::vector<int> baseVertices;
+
+	unsigned int visibleMeshlets = 0;
+	unsigned int visibleTriangles = 0;
+	unsigned int frustumCulled = 0;
+	unsigned int coneCulled = 0;
+};
+
+// Split an indexed triangle list into meshlets. positions points at the first
+// X component and stride is the distance in floats between two vertices
+MeshletData buildMeshlets(const float* positions, size_t stride, size_t vertexCount,
+	const std::vector<unsigned int>& indices,
+	unsigned int maxVertices = MESHLET_MAX_VERTICES,
+	unsigned int maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// Reject meshlets that are outside the view frustum or entirely back facing.
+// Visible meshlets are merged into as few index ranges as possible.
+// The model matrix is expected to have uniform scale
+void cullMeshlets(const MeshletData& data, const glm::mat4& model,
+	const glm::mat4& viewProjection, const glm::vec3& cameraPos,
+	MeshletDrawList& out);
+
+#endif
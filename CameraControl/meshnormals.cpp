@@ -0,0 +1,340 @@
+// Angle weighted smooth normals and tangents with a crease angle, see
+// "Computing Vertex Normals from Polygonal Facets" (Thuermer and Wuethrich)
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "meshnormals.h"
+#include "parallel.h"
+
+static const unsigned int NO_VERTEX = 0xFFFFFFFF;
+
+// Triangles per parallel range, small ranges are not worth a thread
+static const size_t MIN_RANGE = 4096;
+
+static inline uint32_t floatBits(float value)
+{
+	// -0 and +0 are the same position
+	if (value == 0.0f)
+		value = 0.0f;
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline uint32_t hashWords(const uint32_t* words, int count)
+{
+	uint32_t h = 2166136261u;
+	for (int i = 0; i < count; i++)
+	{
+		h = (h ^ words[i]) * 16777619u;
+		h ^= h >> 15;
+	}
+	return h;
+}
+
+static size_t tableSize(size_t count)
+{
+	size_t size = 16;
+	while (size < count * 2)
+		size *= 2;
+	return size;
+}
+
+// Open addressing table of vertex indices, keyed by whatever words the
+// caller builds for a vertex. groupOf[v] is the first vertex with v's key
+template <class KeyFunction>
+static void groupVertices(size_t vertexCount, int words, const KeyFunction& key, std::vector<unsigned int>& groupOf)
+{
+	std::vector<unsigned int> table(tableSize(vertexCount), NO_VERTEX);
+	size_t mask = table.size() - 1;
+	groupOf.resize(vertexCount);
+
+	uint32_t a[16], b[16];
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		key(v, a);
+		size_t slot = hashWords(a, words) & mask;
+		while (true)
+		{
+			unsigned int other = table[slot];
+			if (other == NO_VERTEX)
+			{
+				table[slot] = (unsigned int)v;
+				groupOf[v] = (unsigned int)v;
+				break;
+			}
+			key(other, b);
+			if (memcmp(a, b, words * sizeof(uint32_t)) == 0)
+			{
+				groupOf[v] = other;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+}
+
+// Angle between the edges leaving corner p towards a and b
+static inline float cornerAngle(const float* p, const float* a, const float* b)
+{
+	float ux = a[0] - p[0], uy = a[1] - p[1], uz = a[2] - p[2];
+	float vx = b[0] - p[0], vy = b[1] - p[1], vz = b[2] - p[2];
+	float lengths = sqrtf((ux * ux + uy * uy + uz * uz) * (vx * vx + vy * vy + vz * vz));
+	if (lengths <= 0.0f)
+		return 0.0f;
+	float c = (ux * vx + uy * vy + uz * vz) / lengths;
+	return acosf(c < -1.0f ? -1.0f : (c > 1.0f ? 1.0f : c));
+}
+
+void generateSmoothNormals(MeshSoA& mesh, const NormalSettings& settings)
+{
+	size_t vertexCount = mesh.vertexCount;
+	size_t triangles = mesh.indices.size() / 3;
+	const unsigned int* indices = mesh.indices.data();
+	if (vertexCount == 0 || triangles == 0)
+		return;
+
+	// Corners sharing a position, the loader gives every face its own vertices
+	std::vector<unsigned int> groupOf;
+	groupVertices(vertexCount, 3, [&](size_t v, uint32_t* key)
+	{
+		key[0] = floatBits(mesh.positionX[v]);
+		key[1] = floatBits(mesh.positionY[v]);
+		key[2] = floatBits(mesh.positionZ[v]);
+	}, groupOf);
+
+	// Per triangle unit normal, corner angles and (if wanted) unit tangent,
+	// bitangent and UV handedness
+	std::vector<float> faceNormals(triangles * 3);
+	std::vector<float> angles(triangles * 3);
+	std::vector<float> faceTangents(settings.tangents ? triangles * 7 : 0);
+
+	parallelFor(triangles, MIN_RANGE, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			float p[3][3], uv[3][2];
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				p[c][0] = mesh.positionX[v];
+				p[c][1] = mesh.positionY[v];
+				p[c][2] = mesh.positionZ[v];
+				uv[c][0] = mesh.texCoordU[v];
+				uv[c][1] = mesh.texCoordV[v];
+			}
+
+			float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+			float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			float scale = length > 0.0f ? 1.0f / length : 0.0f;
+			for (int k = 0; k < 3; k++)
+				faceNormals[t * 3 + k] = n[k] * scale;
+
+			angles[t * 3 + 0] = cornerAngle(p[0], p[1], p[2]);
+			angles[t * 3 + 1] = cornerAngle(p[1], p[2], p[0]);
+			angles[t * 3 + 2] = cornerAngle(p[2], p[0], p[1]);
+
+			if (settings.tangents)
+			{
+				float du1 = uv[1][0] - uv[0][0], dv1 = uv[1][1] - uv[0][1];
+				float du2 = uv[2][0] - uv[0][0], dv2 = uv[2][1] - uv[0][1];
+				float det = du1 * dv2 - du2 * dv1;
+				float tangent[3], bitangent[3];
+				for (int k = 0; k < 3; k++)
+				{
+					tangent[k] = e1[k] * dv2 - e2[k] * dv1;
+					bitangent[k] = e2[k] * du1 - e1[k] * du2;
+				}
+				float tl = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+				float bl = sqrtf(bitangent[0] * bitangent[0] + bitangent[1] * bitangent[1] + bitangent[2] * bitangent[2]);
+				float sign = det < 0.0f ? -1.0f : 1.0f;
+
+				// Dividing by the UV determinant only matters for the direction once
+				// normalised. Its sign also keeps mirrored UV islands apart below
+				float* out = &faceTangents[t * 7];
+				for (int k = 0; k < 3; k++)
+				{
+					out[k] = tl > 0.0f ? tangent[k] * sign / tl : 0.0f;
+					out[3 + k] = bl > 0.0f ? bitangent[k] * sign / bl : 0.0f;
+				}
+				out[6] = sign;
+			}
+		}
+	}, settings.threads);
+
+	// Corners of every position group, in triangle order. The first triangle a
+	// vertex belongs to decides which side of a crease it is on
+	std::vector<unsigned int> groupStart(vertexCount + 1, 0);
+	std::vector<unsigned int> firstTriangle(vertexCount, NO_VERTEX);
+	for (size_t i = 0; i < triangles * 3; i++)
+		groupStart[groupOf[indices[i]] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		groupStart[v + 1] += groupStart[v];
+
+	std::vector<unsigned int> groupCorners(triangles * 3);
+	std::vector<unsigned int> fill(groupStart.begin(), groupStart.end() - 1);
+	for (size_t i = 0; i < triangles * 3; i++)
+	{
+		unsigned int v = indices[i];
+		groupCorners[fill[groupOf[v]]++] = (unsigned int)i;
+		if (firstTriangle[v] == NO_VERTEX)
+			firstTriangle[v] = (unsigned int)(i / 3);
+	}
+
+	float creaseCos = cosf(settings.creaseAngle * 3.14159265f / 180.0f) - 1e-6f;
+	if (settings.tangents)
+		mesh.resize(vertexCount, true);
+
+	// Work one position group at a time, its faces are copied together first so
+	// the pairwise crease tests below stay in cache
+	parallelFor(vertexCount, MIN_RANGE, [&](size_t begin, size_t end)
+	{
+		const int stride = 11;	// normal (3), angle, tangent (3), bitangent (3), UV sign
+		std::vector<float> faces;
+
+		for (size_t group = begin; group < end; group++)
+		{
+			unsigned int first = groupStart[group];
+			unsigned int count = groupStart[group + 1] - first;
+			if (count == 0)
+				continue;
+
+			faces.resize(count * stride);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				unsigned int corner = groupCorners[first + i];
+				unsigned int t = corner / 3;
+				float* face = &faces[i * stride];
+				face[0] = faceNormals[t * 3 + 0];
+				face[1] = faceNormals[t * 3 + 1];
+				face[2] = faceNormals[t * 3 + 2];
+				face[3] = angles[corner];
+				if (settings.tangents)
+				{
+					for (int k = 0; k < 7; k++)
+						face[4 + k] = faceTangents[t * 7 + k];
+				}
+			}
+
+			for (unsigned int a = 0; a < count; a++)
+			{
+				// A vertex used by several triangles of one polygon is done at its first
+				unsigned int corner = groupCorners[first + a];
+				unsigned int v = indices[corner];
+				if (firstTriangle[v] != corner / 3)
+					continue;
+				const float* own = &faces[a * stride];
+
+				double n[3] = { 0.0, 0.0, 0.0 };
+				double tangent[3] = { 0.0, 0.0, 0.0 };
+				double bitangent[3] = { 0.0, 0.0, 0.0 };
+				for (unsigned int b = 0; b < count; b++)
+				{
+					const float* other = &faces[b * stride];
+					if (own[0] * other[0] + own[1] * other[1] + own[2] * other[2] < creaseCos)
+						continue;
+
+					float weight = other[3];
+					for (int k = 0; k < 3; k++)
+						n[k] += other[k] * weight;
+
+					// Tangents are only shared between faces with the same UV handedness
+					if (settings.tangents && other[10] == own[10])
+					{
+						for (int k = 0; k < 3; k++)
+						{
+							tangent[k] += other[4 + k] * weight;
+							bitangent[k] += other[7 + k] * weight;
+						}
+					}
+				}
+
+				double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				float normal[3];
+				for (int k = 0; k < 3; k++)
+					normal[k] = length > 0.0 ? (float)(n[k] / length) : own[k];
+				mesh.normalX[v] = normal[0];
+				mesh.normalY[v] = normal[1];
+				mesh.normalZ[v] = normal[2];
+
+				if (settings.tangents)
+				{
+					// Gram-Schmidt against the smoothed normal
+					double d = tangent[0] * normal[0] + tangent[1] * normal[1] + tangent[2] * normal[2];
+					for (int k = 0; k < 3; k++)
+						tangent[k] -= normal[k] * d;
+					double tl = sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+					float t[3];
+					for (int k = 0; k < 3; k++)
+						t[k] = tl > 0.0 ? (float)(tangent[k] / tl) : 0.0f;
+
+					// W says whether the bitangent is cross(N, T) or its mirror
+					float c[3] = { normal[1] * t[2] - normal[2] * t[1], normal[2] * t[0] - normal[0] * t[2], normal[0] * t[1] - normal[1] * t[0] };
+					double handedness = c[0] * bitangent[0] + c[1] * bitangent[1] + c[2] * bitangent[2];
+
+					mesh.tangentX[v] = t[0];
+					mesh.tangentY[v] = t[1];
+					mesh.tangentZ[v] = t[2];
+					mesh.tangentW[v] = handedness < 0.0 ? -1.0f : 1.0f;
+				}
+			}
+		}
+	}, settings.threads);
+}
+
+size_t weldVertices(MeshSoA& mesh)
+{
+	bool tangents = !mesh.tangentX.empty();
+	std::vector<unsigned int> groupOf;
+	groupVertices(mesh.vertexCount, tangents ? 12 : 8, [&](size_t v, uint32_t* key)
+	{
+		key[0] = floatBits(mesh.positionX[v]);
+		key[1] = floatBits(mesh.positionY[v]);
+		key[2] = floatBits(mesh.positionZ[v]);
+		key[3] = floatBits(mesh.normalX[v]);
+		key[4] = floatBits(mesh.normalY[v]);
+		key[5] = floatBits(mesh.normalZ[v]);
+		key[6] = floatBits(mesh.texCoordU[v]);
+		key[7] = floatBits(mesh.texCoordV[v]);
+		if (tangents)
+		{
+			key[8] = floatBits(mesh.tangentX[v]);
+			key[9] = floatBits(mesh.tangentY[v]);
+			key[10] = floatBits(mesh.tangentZ[v]);
+			key[11] = floatBits(mesh.tangentW[v]);
+		}
+	}, groupOf);
+
+	// Survivors move down in order, everything else points at its survivor
+	std::vector<unsigned int> remap(mesh.vertexCount);
+	size_t kept = 0;
+	FloatStream* streams[] = {
+		&mesh.positionX, &mesh.positionY, &mesh.positionZ,
+		&mesh.normalX, &mesh.normalY, &mesh.normalZ,
+		&mesh.texCoordU, &mesh.texCoordV,
+		&mesh.tangentX, &mesh.tangentY, &mesh.tangentZ, &mesh.tangentW
+	};
+	int streamCount = tangents ? 12 : 8;
+
+	for (size_t v = 0; v < mesh.vertexCount; v++)
+	{
+		if (groupOf[v] != v)
+		{
+			remap[v] = remap[groupOf[v]];
+			continue;
+		}
+		for (int s = 0; s < streamCount; s++)
+			(*streams[s])[kept] = (*streams[s])[v];
+		remap[v] = (unsigned int)kept++;
+	}
+
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+		mesh.indices[i] = remap[mesh.indices[i]];
+
+	mesh.resize(kept);
+	return kept;
+}
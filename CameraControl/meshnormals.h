@@ -0,0 +1,24 @@
+#ifndef MESHNORMALS_H
+#define MESHNORMALS_H
+
+#include "meshsoa.h"
+
+struct NormalSettings
+{
+	float creaseAngle = 60.0f;	// Degrees, faces meeting at a sharper angle keep a hard edge
+	bool tangents = true;		// Also rebuild tangentX/Y/Z/W
+	unsigned int threads = 0;	// 0 uses every hardware thread
+};
+
+// Rebuild the normals (and tangents) of an indexed triangle mesh. Corners at the
+// same position are smoothed together, weighted by the angle of each triangle at
+// that corner, unless their faces meet at more than the crease angle.
+// Work is split over triangle and vertex ranges but every sum is taken in
+// triangle order, so the result is the same for any thread count
+void generateSmoothNormals(MeshSoA& mesh, const NormalSettings& settings = NormalSettings());
+
+// Merge vertices whose attributes are bit for bit identical and remap the
+// indices, survivors keep their first occurrence order. Returns the new vertex count
+size_t weldVertices(MeshSoA& mesh);
+
+#endif
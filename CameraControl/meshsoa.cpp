@@ -0,0 +1,556 @@
+// Struct of arrays mesh kernels. Every kernel is written once against a small
+// lane type and instantiated with the widest lanes compiled in, the scalar lane
+// type then finishes the elements that do not fill a whole register
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+#include "meshsoa.h"
+
+#if defined(MESHSOA_AVX2)
+#include <immintrin.h>
+#elif defined(MESHSOA_SSE)
+#include <emmintrin.h>
+#endif
+
+// ================================
+// lane types
+// ===============================
+
+struct ScalarLanes
+{
+	enum { Width = 1 };
+	typedef unsigned int Index;
+
+	float v;
+
+	static ScalarLanes make(float x) { ScalarLanes r; r.v = x; return r; }
+	static ScalarLanes set(float x) { return make(x); }
+	static ScalarLanes load(const float* p) { return make(*p); }
+	void store(float* p) const { *p = v; }
+
+	// Vertex index of one corner of the triangles starting at triangle
+	static Index corner(const unsigned int* indices, size_t triangle, unsigned int c) { return indices[triangle * 3 + c]; }
+	static ScalarLanes gather(const float* base, Index index) { return make(base[index]); }
+
+	void lanes(float* out) const { out[0] = v; }
+};
+
+inline ScalarLanes operator+(ScalarLanes a, ScalarLanes b) { return ScalarLanes::make(a.v + b.v); }
+inline ScalarLanes operator-(ScalarLanes a, ScalarLanes b) { return ScalarLanes::make(a.v - b.v); }
+inline ScalarLanes operator*(ScalarLanes a, ScalarLanes b) { return ScalarLanes::make(a.v * b.v); }
+inline ScalarLanes minLanes(ScalarLanes a, ScalarLanes b) { return ScalarLanes::make(a.v < b.v ? a.v : b.v); }
+inline ScalarLanes maxLanes(ScalarLanes a, ScalarLanes b) { return ScalarLanes::make(a.v > b.v ? a.v : b.v); }
+inline ScalarLanes sqrtLanes(ScalarLanes a) { return ScalarLanes::make(sqrtf(a.v)); }
+inline ScalarLanes recipOrZero(ScalarLanes a) { return ScalarLanes::make(a.v != 0.0f ? 1.0f / a.v : 0.0f); }
+inline ScalarLanes selectNegative(ScalarLanes c, ScalarLanes a, ScalarLanes b) { return c.v < 0.0f ? a : b; }
+
+#if defined(MESHSOA_AVX2)
+
+struct WideLanes
+{
+	enum { Width = 8 };
+	typedef __m256i Index;
+
+	__m256 v;
+
+	static WideLanes make(__m256 x) { WideLanes r; r.v = x; return r; }
+	static WideLanes set(float x) { return make(_mm256_set1_ps(x)); }
+	static WideLanes load(const float* p) { return make(_mm256_load_ps(p)); }
+	void store(float* p) const { _mm256_store_ps(p, v); }
+
+	static Index corner(const unsigned int* indices, size_t triangle, unsigned int c)
+	{
+		__m256i offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+		__m256i first = _mm256_set1_epi32((int)(triangle * 3 + c));
+		return _mm256_i32gather_epi32((const int*)indices, _mm256_add_epi32(first, offsets), 4);
+	}
+	static WideLanes gather(const float* base, Index index) { return make(_mm256_i32gather_ps(base, index, 4)); }
+
+	void lanes(float* out) const { _mm256_storeu_ps(out, v); }
+};
+
+inline WideLanes operator+(WideLanes a, WideLanes b) { return WideLanes::make(_mm256_add_ps(a.v, b.v)); }
+inline WideLanes operator-(WideLanes a, WideLanes b) { return WideLanes::make(_mm256_sub_ps(a.v, b.v)); }
+inline WideLanes operator*(WideLanes a, WideLanes b) { return WideLanes::make(_mm256_mul_ps(a.v, b.v)); }
+inline WideLanes minLanes(WideLanes a, WideLanes b) { return WideLanes::make(_mm256_min_ps(a.v, b.v)); }
+inline WideLanes maxLanes(WideLanes a, WideLanes b) { return WideLanes::make(_mm256_max_ps(a.v, b.v)); }
+inline WideLanes sqrtLanes(WideLanes a) { return WideLanes::make(_mm256_sqrt_ps(a.v)); }
+inline WideLanes recipOrZero(WideLanes a)
+{
+	__m256 nonZero = _mm256_cmp_ps(a.v, _mm256_setzero_ps(), _CMP_NEQ_OQ);
+	return WideLanes::make(_mm256_and_ps(nonZero, _mm256_div_ps(_mm256_set1_ps(1.0f), a.v)));
+}
+inline WideLanes selectNegative(WideLanes c, WideLanes a, WideLanes b)
+{
+	__m256 negative = _mm256_cmp_ps(c.v, _mm256_setzero_ps(), _CMP_LT_OQ);
+	return WideLanes::make(_mm256_blendv_ps(b.v, a.v, negative));
+}
+
+#elif defined(MESHSOA_SSE)
+
+struct WideLanes
+{
+	enum { Width = 4 };
+	struct Index
+	{
+		unsigned int i[4];
+	};
+
+	__m128 v;
+
+	static WideLanes make(__m128 x) { WideLanes r; r.v = x; return r; }
+	static WideLanes set(float x) { return make(_mm_set1_ps(x)); }
+	static WideLanes load(const float* p) { return make(_mm_load_ps(p)); }
+	void store(float* p) const { _mm_store_ps(p, v); }
+
+	// SSE has no gather, the four loads are done one by one
+	static Index corner(const unsigned int* indices, size_t triangle, unsigned int c)
+	{
+		const unsigned int* first = indices + triangle * 3 + c;
+		Index index = { { first[0], first[3], first[6], first[9] } };
+		return index;
+	}
+	static WideLanes gather(const float* base, const Index& index)
+	{
+		return make(_mm_setr_ps(base[index.i[0]], base[index.i[1]], base[index.i[2]], base[index.i[3]]));
+	}
+
+	void lanes(float* out) const { _mm_storeu_ps(out, v); }
+};
+
+inline WideLanes operator+(WideLanes a, WideLanes b) { return WideLanes::make(_mm_add_ps(a.v, b.v)); }
+inline WideLanes operator-(WideLanes a, WideLanes b) { return WideLanes::make(_mm_sub_ps(a.v, b.v)); }
+inline WideLanes operator*(WideLanes a, WideLanes b) { return WideLanes::make(_mm_mul_ps(a.v, b.v)); }
+inline WideLanes minLanes(WideLanes a, WideLanes b) { return WideLanes::make(_mm_min_ps(a.v, b.v)); }
+inline WideLanes maxLanes(WideLanes a, WideLanes b) { return WideLanes::make(_mm_max_ps(a.v, b.v)); }
+inline WideLanes sqrtLanes(WideLanes a) { return WideLanes::make(_mm_sqrt_ps(a.v)); }
+inline WideLanes recipOrZero(WideLanes a)
+{
+	__m128 nonZero = _mm_cmpneq_ps(a.v, _mm_setzero_ps());
+	return WideLanes::make(_mm_and_ps(nonZero, _mm_div_ps(_mm_set1_ps(1.0f), a.v)));
+}
+inline WideLanes selectNegative(WideLanes c, WideLanes a, WideLanes b)
+{
+	__m128 negative = _mm_cmplt_ps(c.v, _mm_setzero_ps());
+	return WideLanes::make(_mm_or_ps(_mm_and_ps(negative, a.v), _mm_andnot_ps(negative, b.v)));
+}
+
+#else
+
+typedef ScalarLanes WideLanes;
+
+#endif
+
+const char* meshSoaKernels()
+{
+#if defined(MESHSOA_AVX2)
+	return "avx2";
+#elif defined(MESHSOA_SSE)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+// ================================
+// kernels
+// ===============================
+
+// Each kernel handles whole groups of L::Width elements from first and returns
+// where it stopped, the public functions run the rest with ScalarLanes
+
+template <class L>
+static size_t minMaxKernel(const float* values, size_t first, size_t count, float& outMin, float& outMax)
+{
+	if (first + L::Width > count)
+		return first;
+
+	L low = L::load(values + first);
+	L high = low;
+	size_t i = first + L::Width;
+	for (; i + L::Width <= count; i += L::Width)
+	{
+		L x = L::load(values + i);
+		low = minLanes(low, x);
+		high = maxLanes(high, x);
+	}
+
+	float lows[8], highs[8];
+	low.lanes(lows);
+	high.lanes(highs);
+	for (int lane = 0; lane < L::Width; lane++)
+	{
+		outMin = fminf(outMin, lows[lane]);
+		outMax = fmaxf(outMax, highs[lane]);
+	}
+	return i;
+}
+
+template <class L>
+static size_t faceNormalKernel(const MeshSoA& mesh, float* outX, float* outY, float* outZ, size_t t, size_t count)
+{
+	const unsigned int* indices = mesh.indices.data();
+	const float* px = mesh.positionX.data();
+	const float* py = mesh.positionY.data();
+	const float* pz = mesh.positionZ.data();
+
+	for (; t + L::Width <= count; t += L::Width)
+	{
+		typename L::Index i0 = L::corner(indices, t, 0);
+		typename L::Index i1 = L::corner(indices, t, 1);
+		typename L::Index i2 = L::corner(indices, t, 2);
+
+		L p0x = L::gather(px, i0), p0y = L::gather(py, i0), p0z = L::gather(pz, i0);
+		L e1x = L::gather(px, i1) - p0x, e1y = L::gather(py, i1) - p0y, e1z = L::gather(pz, i1) - p0z;
+		L e2x = L::gather(px, i2) - p0x, e2y = L::gather(py, i2) - p0y, e2z = L::gather(pz, i2) - p0z;
+
+		(e1y * e2z - e1z * e2y).store(outX + t);
+		(e1z * e2x - e1x * e2z).store(outY + t);
+		(e1x * e2y - e1y * e2x).store(outZ + t);
+	}
+	return t;
+}
+
+template <class L>
+static size_t normalizeKernel(float* x, float* y, float* z, size_t i, size_t count)
+{
+	for (; i + L::Width <= count; i += L::Width)
+	{
+		L vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+		L scale = recipOrZero(sqrtLanes(vx * vx + vy * vy + vz * vz));
+		(vx * scale).store(x + i);
+		(vy * scale).store(y + i);
+		(vz * scale).store(z + i);
+	}
+	return i;
+}
+
+// Unnormalised tangent and bitangent of each triangle from its UV gradients
+template <class L>
+static size_t faceTangentKernel(const MeshSoA& mesh, float* tx, float* ty, float* tz,
+	float* bx, float* by, float* bz, size_t t, size_t count)
+{
+	const unsigned int* indices = mesh.indices.data();
+	const float* px = mesh.positionX.data();
+	const float* py = mesh.positionY.data();
+	const float* pz = mesh.positionZ.data();
+	const float* u = mesh.texCoordU.data();
+	const float* v = mesh.texCoordV.data();
+
+	for (; t + L::Width <= count; t += L::Width)
+	{
+		typename L::Index i0 = L::corner(indices, t, 0);
+		typename L::Index i1 = L::corner(indices, t, 1);
+		typename L::Index i2 = L::corner(indices, t, 2);
+
+		L p0x = L::gather(px, i0), p0y = L::gather(py, i0), p0z = L::gather(pz, i0);
+		L e1x = L::gather(px, i1) - p0x, e1y = L::gather(py, i1) - p0y, e1z = L::gather(pz, i1) - p0z;
+		L e2x = L::gather(px, i2) - p0x, e2y = L::gather(py, i2) - p0y, e2z = L::gather(pz, i2) - p0z;
+
+		L u0 = L::gather(u, i0), v0 = L::gather(v, i0);
+		L du1 = L::gather(u, i1) - u0, dv1 = L::gather(v, i1) - v0;
+		L du2 = L::gather(u, i2) - u0, dv2 = L::gather(v, i2) - v0;
+
+		// Degenerate UVs give a zero tangent rather than infinities
+		L r = recipOrZero(du1 * dv2 - du2 * dv1);
+
+		((e1x * dv2 - e2x * dv1) * r).store(tx + t);
+		((e1y * dv2 - e2y * dv1) * r).store(ty + t);
+		((e1z * dv2 - e2z * dv1) * r).store(tz + t);
+		((e2x * du1 - e1x * du2) * r).store(bx + t);
+		((e2y * du1 - e1y * du2) * r).store(by + t);
+		((e2z * du1 - e1z * du2) * r).store(bz + t);
+	}
+	return t;
+}
+
+// Gram-Schmidt the summed tangents against the normals, the sign of W says
+// whether the bitangent is cross(N, T) or its mirror
+template <class L>
+static size_t orthogonalizeKernel(MeshSoA& mesh, const float* bx, const float* by, const float* bz, size_t i, size_t count)
+{
+	float* tx = mesh.tangentX.data();
+	float* ty = mesh.tangentY.data();
+	float* tz = mesh.tangentZ.data();
+
+	for (; i + L::Width <= count; i += L::Width)
+	{
+		L nx = L::load(mesh.normalX.data() + i), ny = L::load(mesh.normalY.data() + i), nz = L::load(mesh.normalZ.data() + i);
+		L vx = L::load(tx + i), vy = L::load(ty + i), vz = L::load(tz + i);
+
+		L d = nx * vx + ny * vy + nz * vz;
+		vx = vx - nx * d;
+		vy = vy - ny * d;
+		vz = vz - nz * d;
+		L scale = recipOrZero(sqrtLanes(vx * vx + vy * vy + vz * vz));
+		vx = vx * scale;
+		vy = vy * scale;
+		vz = vz * scale;
+
+		L cx = ny * vz - nz * vy, cy = nz * vx - nx * vz, cz = nx * vy - ny * vx;
+		L handedness = cx * L::load(bx + i) + cy * L::load(by + i) + cz * L::load(bz + i);
+
+		vx.store(tx + i);
+		vy.store(ty + i);
+		vz.store(tz + i);
+		selectNegative(handedness, L::set(-1.0f), L::set(1.0f)).store(mesh.tangentW.data() + i);
+	}
+	return i;
+}
+
+template <class L>
+static size_t transformKernel(float* x, float* y, float* z, const float* m, bool translate, size_t i, size_t count)
+{
+	L m0 = L::set(m[0]), m1 = L::set(m[1]), m2 = L::set(m[2]);
+	L m4 = L::set(m[4]), m5 = L::set(m[5]), m6 = L::set(m[6]);
+	L m8 = L::set(m[8]), m9 = L::set(m[9]), m10 = L::set(m[10]);
+	L m12 = L::set(translate ? m[12] : 0.0f), m13 = L::set(translate ? m[13] : 0.0f), m14 = L::set(translate ? m[14] : 0.0f);
+
+	for (; i + L::Width <= count; i += L::Width)
+	{
+		L vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+		(m0 * vx + m4 * vy + m8 * vz + m12).store(x + i);
+		(m1 * vx + m5 * vy + m9 * vz + m13).store(y + i);
+		(m2 * vx + m6 * vy + m10 * vz + m14).store(z + i);
+	}
+	return i;
+}
+
+// ================================
+// public functions
+// ===============================
+
+void MeshSoA::resize(size_t count, bool withTangents)
+{
+	vertexCount = count;
+	positionX.resize(count);
+	positionY.resize(count);
+	positionZ.resize(count);
+	normalX.resize(count);
+	normalY.resize(count);
+	normalZ.resize(count);
+	texCoordU.resize(count);
+	texCoordV.resize(count);
+
+	if (withTangents || !tangentX.empty())
+	{
+		tangentX.resize(count);
+		tangentY.resize(count);
+		tangentZ.resize(count);
+		tangentW.resize(count);
+	}
+}
+
+void computeBounds(const MeshSoA& mesh, MeshBounds& bounds)
+{
+	const FloatStream* streams[3] = { &mesh.positionX, &mesh.positionY, &mesh.positionZ };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float* values = streams[axis]->data();
+		bounds.min[axis] = FLT_MAX;
+		bounds.max[axis] = -FLT_MAX;
+
+		size_t done = minMaxKernel<WideLanes>(values, 0, mesh.vertexCount, bounds.min[axis], bounds.max[axis]);
+		for (; done < mesh.vertexCount; done++)
+		{
+			bounds.min[axis] = fminf(bounds.min[axis], values[done]);
+			bounds.max[axis] = fmaxf(bounds.max[axis], values[done]);
+		}
+	}
+}
+
+void computeFaceNormals(const MeshSoA& mesh, FloatStream& x, FloatStream& y, FloatStream& z)
+{
+	size_t triangles = mesh.indices.size() / 3;
+	x.resize(triangles);
+	y.resize(triangles);
+	z.resize(triangles);
+
+	size_t done = faceNormalKernel<WideLanes>(mesh, x.data(), y.data(), z.data(), 0, triangles);
+	faceNormalKernel<ScalarLanes>(mesh, x.data(), y.data(), z.data(), done, triangles);
+}
+
+static void normalizeStreams(float* x, float* y, float* z, size_t count)
+{
+	size_t done = normalizeKernel<WideLanes>(x, y, z, 0, count);
+	normalizeKernel<ScalarLanes>(x, y, z, done, count);
+}
+
+// Give every corner its own vertex: the first corner using a vertex keeps it,
+// the others get copies appended in corner order
+static void splitSharedVertices(MeshSoA& mesh)
+{
+	std::vector<unsigned char> used(mesh.vertexCount, 0);
+	size_t shared = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		unsigned int v = mesh.indices[i];
+		if (used[v])
+			shared++;
+		used[v] = 1;
+	}
+	if (shared == 0)
+		return;
+
+	size_t next = mesh.vertexCount;
+	mesh.resize(mesh.vertexCount + shared);
+	FloatStream* streams[] = {
+		&mesh.positionX, &mesh.positionY, &mesh.positionZ,
+		&mesh.normalX, &mesh.normalY, &mesh.normalZ,
+		&mesh.texCoordU, &mesh.texCoordV,
+		&mesh.tangentX, &mesh.tangentY, &mesh.tangentZ, &mesh.tangentW
+	};
+	int streamCount = mesh.tangentX.empty() ? 8 : 12;
+
+	std::fill(used.begin(), used.end(), 0);
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		unsigned int v = mesh.indices[i];
+		if (!used[v])
+		{
+			used[v] = 1;
+			continue;
+		}
+		for (int s = 0; s < streamCount; s++)
+			(*streams[s])[next] = (*streams[s])[v];
+		mesh.indices[i] = (unsigned int)next++;
+	}
+}
+
+void computeNormals(MeshSoA& mesh, bool smooth)
+{
+	if (!smooth)
+		splitSharedVertices(mesh);
+
+	FloatStream faceX, faceY, faceZ;
+	computeFaceNormals(mesh, faceX, faceY, faceZ);
+
+	size_t triangles = faceX.size();
+	const unsigned int* indices = mesh.indices.data();
+	float* nx = mesh.normalX.data();
+	float* ny = mesh.normalY.data();
+	float* nz = mesh.normalZ.data();
+
+	if (smooth)
+	{
+		// The scatter is scalar, the sums are normalised with the wide kernel
+		std::fill(mesh.normalX.begin(), mesh.normalX.end(), 0.0f);
+		std::fill(mesh.normalY.begin(), mesh.normalY.end(), 0.0f);
+		std::fill(mesh.normalZ.begin(), mesh.normalZ.end(), 0.0f);
+
+		for (size_t t = 0; t < triangles; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				nx[v] += faceX[t];
+				ny[v] += faceY[t];
+				nz[v] += faceZ[t];
+			}
+		}
+		normalizeStreams(nx, ny, nz, mesh.vertexCount);
+	}
+	else
+	{
+		// Every vertex belongs to one corner now
+		normalizeStreams(faceX.data(), faceY.data(), faceZ.data(), triangles);
+
+		for (size_t t = 0; t < triangles; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				nx[v] = faceX[t];
+				ny[v] = faceY[t];
+				nz[v] = faceZ[t];
+			}
+		}
+	}
+}
+
+void computeTangents(MeshSoA& mesh)
+{
+	size_t triangles = mesh.indices.size() / 3;
+	FloatStream faceTX(triangles), faceTY(triangles), faceTZ(triangles);
+	FloatStream faceBX(triangles), faceBY(triangles), faceBZ(triangles);
+
+	size_t done = faceTangentKernel<WideLanes>(mesh, faceTX.data(), faceTY.data(), faceTZ.data(),
+		faceBX.data(), faceBY.data(), faceBZ.data(), 0, triangles);
+	faceTangentKernel<ScalarLanes>(mesh, faceTX.data(), faceTY.data(), faceTZ.data(),
+		faceBX.data(), faceBY.data(), faceBZ.data(), done, triangles);
+
+	// Sum per vertex
+	mesh.resize(mesh.vertexCount, true);
+	std::fill(mesh.tangentX.begin(), mesh.tangentX.end(), 0.0f);
+	std::fill(mesh.tangentY.begin(), mesh.tangentY.end(), 0.0f);
+	std::fill(mesh.tangentZ.begin(), mesh.tangentZ.end(), 0.0f);
+	FloatStream bx(mesh.vertexCount, 0.0f), by(mesh.vertexCount, 0.0f), bz(mesh.vertexCount, 0.0f);
+
+	const unsigned int* indices = mesh.indices.data();
+	for (size_t t = 0; t < triangles; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			mesh.tangentX[v] += faceTX[t];
+			mesh.tangentY[v] += faceTY[t];
+			mesh.tangentZ[v] += faceTZ[t];
+			bx[v] += faceBX[t];
+			by[v] += faceBY[t];
+			bz[v] += faceBZ[t];
+		}
+	}
+
+	done = orthogonalizeKernel<WideLanes>(mesh, bx.data(), by.data(), bz.data(), 0, mesh.vertexCount);
+	orthogonalizeKernel<ScalarLanes>(mesh, bx.data(), by.data(), bz.data(), done, mesh.vertexCount);
+}
+
+void transformPositions(MeshSoA& mesh, const float* matrix)
+{
+	float* x = mesh.positionX.data();
+	float* y = mesh.positionY.data();
+	float* z = mesh.positionZ.data();
+
+	size_t done = transformKernel<WideLanes>(x, y, z, matrix, true, 0, mesh.vertexCount);
+	transformKernel<ScalarLanes>(x, y, z, matrix, true, done, mesh.vertexCount);
+}
+
+void transformNormals(MeshSoA& mesh, const float* matrix)
+{
+	// Widen the 3x3 to the 4x4 layout the transform kernel reads
+	const float m[16] = {
+		matrix[0], matrix[1], matrix[2], 0.0f,
+		matrix[3], matrix[4], matrix[5], 0.0f,
+		matrix[6], matrix[7], matrix[8], 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+
+	float* x = mesh.normalX.data();
+	float* y = mesh.normalY.data();
+	float* z = mesh.normalZ.data();
+
+	size_t done = transformKernel<WideLanes>(x, y, z, m, false, 0, mesh.vertexCount);
+	transformKernel<ScalarLanes>(x, y, z, m, false, done, mesh.vertexCount);
+	normalizeStreams(x, y, z, mesh.vertexCount);
+}
+
+void interleaveVertices(const MeshSoA& mesh, std::vector<float>& out)
+{
+	out.resize(mesh.vertexCount * 9);
+
+	float* p = out.data();
+	for (size_t i = 0; i < mesh.vertexCount; i++, p += 9)
+	{
+		p[0] = mesh.positionX[i];
+		p[1] = mesh.positionY[i];
+		p[2] = mesh.positionZ[i];
+		p[3] = mesh.normalX[i];
+		p[4] = mesh.normalY[i];
+		p[5] = mesh.normalZ[i];
+		p[6] = mesh.texCoordU[i];
+		p[7] = 1.0f - mesh.texCoordV[i]; // Inverted coordinates due to opengl
+		p[8] = 0.0f; // Unused value
+	}
+}
@@ -0,0 +1,115 @@
+#ifndef MESHSOA_H
+#define MESHSOA_H
+
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+// Kernel selection happens at compile time: AVX2 when the compiler targets it
+// (/arch:AVX2, -mavx2), SSE2 on any other x86 build, plain C++ otherwise.
+// Define MESHSOA_NO_SIMD to force the scalar kernels
+#if !defined(MESHSOA_NO_SIMD) && defined(__AVX2__)
+#define MESHSOA_AVX2
+#elif !defined(MESHSOA_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MESHSOA_SSE
+#endif
+
+const size_t MESHSOA_ALIGNMENT = 32;
+
+// Allocator handing out MESHSOA_ALIGNMENT aligned blocks so the kernels can use
+// aligned loads. The original pointer is kept just in front of the block
+template <class T>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	template <class U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U> other;
+	};
+
+	AlignedAllocator() {}
+	template <class U>
+	AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		void* raw = malloc(n * sizeof(T) + MESHSOA_ALIGNMENT + sizeof(void*));
+		if (!raw)
+			throw std::bad_alloc();
+		uintptr_t aligned = ((uintptr_t)raw + sizeof(void*) + MESHSOA_ALIGNMENT - 1) & ~(uintptr_t)(MESHSOA_ALIGNMENT - 1);
+		((void**)aligned)[-1] = raw;
+		return (T*)aligned;
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		if (p)
+			free(((void**)p)[-1]);
+	}
+};
+
+template <class T, class U>
+bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return false; }
+
+typedef std::vector<float, AlignedAllocator<float> > FloatStream;
+
+// A triangle mesh with every vertex attribute in its own float stream
+struct MeshSoA
+{
+	size_t vertexCount = 0;
+
+	FloatStream positionX, positionY, positionZ;
+	FloatStream normalX, normalY, normalZ;
+	FloatStream texCoordU, texCoordV;
+
+	// Filled by computeTangents, W is the bitangent sign
+	FloatStream tangentX, tangentY, tangentZ, tangentW;
+
+	std::vector<unsigned int> indices;
+
+	// Resize every stream, new tangents are only allocated if withTangents is set
+	void resize(size_t count, bool withTangents = false);
+};
+
+struct MeshBounds
+{
+	float min[3];
+	float max[3];
+};
+
+// Name of the kernel set compiled in ("avx2", "sse2" or "scalar")
+const char* meshSoaKernels();
+
+// Axis aligned bounding box of all vertex positions
+void computeBounds(const MeshSoA& mesh, MeshBounds& bounds);
+
+// One normal per triangle, the length is twice the triangle area
+void computeFaceNormals(const MeshSoA& mesh, FloatStream& x, FloatStream& y, FloatStream& z);
+
+// Rebuild the vertex normals from the triangles. Flat gives every corner its
+// triangle's normal, first splitting vertices that several corners share so no
+// triangle overwrites another's; this can add vertices. Smooth sums the area
+// weighted normals of every triangle sharing a vertex index
+void computeNormals(MeshSoA& mesh, bool smooth);
+
+// Per vertex tangents from positions and texture coordinates, orthogonalised
+// against the vertex normals
+void computeTangents(MeshSoA& mesh);
+
+// Transform positions by a column major 4x4 matrix (as glm::value_ptr gives)
+void transformPositions(MeshSoA& mesh, const float* matrix);
+
+// Transform and renormalise normals by a column major 3x3 matrix, normally
+// the inverse transpose of the model matrix
+void transformNormals(MeshSoA& mesh, const float* matrix);
+
+// Interleave into the GPU vertex layout used by loadVertices: position (3),
+// normal (3), texture coordinate (2, V flipped for OpenGL), padding (1)
+void interleaveVertices(const MeshSoA& mesh, std::vector<float>& out);
+
+#endif
@@ -0,0 +1,8 @@
+#version 330 core
+out vec3 color;
+
+// Added up with additive blending, every fragment shaded at a pixel makes it brighter
+void main()
+{
+    color = vec3(0.1f, 0.05f, 0.02f);
+}
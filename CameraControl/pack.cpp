@@ -0,0 +1,502 @@
+// Asset pack files: header, hashed table of contents, path strings, then the
+// entries one after the other, each starting on an ALIGNMENT boundary
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "pack.h"
+
+namespace pack
+{
+	static const char PACK_MAGIC[4] = { 'P', 'A', 'C', 'K' };
+	static const uint32_t PACK_VERSION = 1;
+
+	static const uint32_t ENTRY_USED = 1;
+	static const uint32_t ENTRY_LZ4 = 2;
+
+	struct PackHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t slotCount;		// Power of two, at least twice the entries
+		uint32_t stringBytes;
+		uint32_t reserved;
+		uint64_t dataOffset;
+	};
+
+	struct PackEntry
+	{
+		uint32_t hash;
+		uint32_t name;			// Offset of the path in the string table
+		uint32_t flags;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+	};
+
+	static_assert(sizeof(PackHeader) == 32, "PackHeader is stored as is in packs");
+	static_assert(sizeof(PackEntry) == 40, "PackEntry is stored as is in packs");
+
+	// The open pack, mapped read only
+	static struct Mapping
+	{
+		const char* data = NULL;
+		size_t size = 0;
+		const PackHeader* header = NULL;
+		const PackEntry* slots = NULL;
+		const char* strings = NULL;
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#endif
+	} mapped;
+
+	// FNV-1a
+	static uint32_t hashPath(const std::string& path)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < path.size(); i++)
+		{
+			hash ^= (unsigned char)path[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	std::string normalize(const std::string& path)
+	{
+		std::string result = path;
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			if (result[i] == '\\')
+				result[i] = '/';
+		}
+		while (result.compare(0, 2, "./") == 0)
+			result.erase(0, 2);
+		return result;
+	}
+
+	static bool readFile(const std::string& path, std::vector<char>& contents)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			return false;
+		std::streamoff size = file.tellg();
+		if (size < 0)
+			return false;
+		contents.resize((size_t)size);
+		file.seekg(0);
+		return size == 0 || file.read(contents.data(), size).gcount() == size;
+	}
+
+	static size_t alignUp(size_t value)
+	{
+		return (value + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+
+	bool write(const std::string& path, const std::vector<std::string>& files, bool compress)
+	{
+		std::vector<std::string> names;
+		std::vector<std::vector<char> > contents;
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			std::string name = normalize(files[i]);
+			bool duplicate = false;
+			for (size_t j = 0; j < names.size() && !duplicate; j++)
+				duplicate = names[j] == name;
+			if (duplicate)
+				continue;
+
+			contents.push_back(std::vector<char>());
+			if (!readFile(files[i], contents.back()))
+			{
+				std::cout << "ERROR::PACK::FILE_NOT_FOUND " << files[i] << std::endl;
+				return false;
+			}
+			names.push_back(name);
+		}
+
+		PackHeader header;
+		memcpy(header.magic, PACK_MAGIC, 4);
+		header.version = PACK_VERSION;
+		header.entryCount = (uint32_t)names.size();
+		header.slotCount = 8;
+		while (header.slotCount < header.entryCount * 2)
+			header.slotCount *= 2;
+		header.reserved = 0;
+
+		std::string strings;
+		std::vector<PackEntry> slots(header.slotCount);
+		memset(slots.data(), 0, slots.size() * sizeof(PackEntry));
+		std::vector<PackEntry*> entries(names.size());
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			uint32_t hash = hashPath(names[i]);
+			uint32_t slot = hash & (header.slotCount - 1);
+			while (slots[slot].flags & ENTRY_USED)
+				slot = (slot + 1) & (header.slotCount - 1);
+
+			PackEntry& entry = slots[slot];
+			entry.hash = hash;
+			entry.name = (uint32_t)strings.size();
+			entry.flags = ENTRY_USED;
+			entry.size = contents[i].size();
+			entries[i] = &entry;
+			strings += names[i];
+			strings.push_back('\0');
+		}
+		header.stringBytes = (uint32_t)strings.size();
+		header.dataOffset = alignUp(sizeof(PackHeader) + slots.size() * sizeof(PackEntry) + strings.size());
+
+		// Compressed entries replace their contents, so the offsets are known before writing
+		uint64_t offset = header.dataOffset;
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			std::vector<char>& data = contents[i];
+			if (compress && !data.empty())
+			{
+				std::vector<char> packed(compressBound(data.size()));
+				size_t packedSize = pack::compress(data.data(), data.size(), packed.data(), packed.size());
+				if (packedSize > 0 && packedSize <= data.size() - data.size() / 8)
+				{
+					packed.resize(packedSize);
+					data.swap(packed);
+					entries[i]->flags |= ENTRY_LZ4;
+				}
+			}
+			entries[i]->offset = offset;
+			entries[i]->storedSize = data.size();
+			offset = alignUp((size_t)(offset + data.size()));
+		}
+
+		FILE* file = fopen(path.c_str(), "wb");
+		if (file == NULL)
+		{
+			std::cout << "ERROR::PACK::NOT_WRITTEN " << path << std::endl;
+			return false;
+		}
+		std::vector<char> padding(ALIGNMENT, 0);
+		size_t written = sizeof(PackHeader) + slots.size() * sizeof(PackEntry) + strings.size();
+		bool valid = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(slots.data(), sizeof(PackEntry), slots.size(), file) == slots.size()
+			&& fwrite(strings.data(), 1, strings.size(), file) == strings.size()
+			&& fwrite(padding.data(), 1, (size_t)header.dataOffset - written, file) == (size_t)header.dataOffset - written;
+		for (size_t i = 0; i < names.size() && valid; i++)
+		{
+			const std::vector<char>& data = contents[i];
+			size_t pad = alignUp(data.size()) - data.size();
+			valid = fwrite(data.data(), 1, data.size(), file) == data.size()
+				&& (i + 1 == names.size() || fwrite(padding.data(), 1, pad, file) == pad);
+		}
+		valid = fclose(file) == 0 && valid;
+		if (!valid)
+			std::cout << "ERROR::PACK::NOT_WRITTEN " << path << std::endl;
+		return valid;
+	}
+
+	static bool mapFile(const std::string& path)
+	{
+#ifdef _WIN32
+		mapped.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (mapped.file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(mapped.file, &size) || size.QuadPart == 0)
+			return false;
+		mapped.mapping = CreateFileMappingA(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapped.mapping == NULL)
+			return false;
+		mapped.data = (const char*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+		mapped.size = (size_t)size.QuadPart;
+		return mapped.data != NULL;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+		struct stat status;
+		void* data = MAP_FAILED;
+		if (fstat(file, &status) == 0 && status.st_size > 0)
+			data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping keeps the file alive
+		::close(file);
+		if (data == MAP_FAILED)
+			return false;
+		mapped.data = (const char*)data;
+		mapped.size = (size_t)status.st_size;
+		return true;
+#endif
+	}
+
+	// Every table entry and string has to lie inside the file
+	static bool validate()
+	{
+		if (mapped.size < sizeof(PackHeader))
+			return false;
+		const PackHeader& header = *(const PackHeader*)mapped.data;
+		if (memcmp(header.magic, PACK_MAGIC, 4) != 0 || header.version != PACK_VERSION)
+			return false;
+		if (header.slotCount == 0 || (header.slotCount & (header.slotCount - 1)) != 0 || header.entryCount >= header.slotCount)
+			return false;
+		uint64_t tableEnd = sizeof(PackHeader) + (uint64_t)header.slotCount * sizeof(PackEntry) + header.stringBytes;
+		if (tableEnd > header.dataOffset || header.dataOffset > mapped.size)
+			return false;
+
+		const PackEntry* slots = (const PackEntry*)(mapped.data + sizeof(PackHeader));
+		const char* strings = (const char*)(slots + header.slotCount);
+		if (header.stringBytes > 0 && strings[header.stringBytes - 1] != '\0')
+			return false;
+		for (uint32_t i = 0; i < header.slotCount; i++)
+		{
+			const PackEntry& entry = slots[i];
+			if (!(entry.flags & ENTRY_USED))
+				continue;
+			if (entry.name >= header.stringBytes || entry.offset < header.dataOffset
+				|| entry.offset > mapped.size || entry.storedSize > mapped.size - entry.offset)
+				return false;
+			if (!(entry.flags & ENTRY_LZ4) && entry.storedSize != entry.size)
+				return false;
+		}
+
+		mapped.header = &header;
+		mapped.slots = slots;
+		mapped.strings = strings;
+		return true;
+	}
+
+	bool open(const std::string& path)
+	{
+		close();
+		if (!mapFile(path))
+		{
+			close();
+			return false;
+		}
+		if (!validate())
+		{
+			std::cout << "ERROR::PACK::INVALID " << path << std::endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (mapped.data != NULL)
+			UnmapViewOfFile(mapped.data);
+		if (mapped.mapping != NULL)
+			CloseHandle(mapped.mapping);
+		if (mapped.file != INVALID_HANDLE_VALUE)
+			CloseHandle(mapped.file);
+#else
+		if (mapped.data != NULL)
+			munmap((void*)mapped.data, mapped.size);
+#endif
+		mapped = Mapping();
+	}
+
+	bool isOpen()
+	{
+		return mapped.header != NULL;
+	}
+
+	bool load(const std::string& path, Asset& asset)
+	{
+		if (!isOpen())
+			return false;
+
+		std::string name = normalize(path);
+		uint32_t hash = hashPath(name);
+		uint32_t mask = mapped.header->slotCount - 1;
+		for (uint32_t slot = hash & mask; mapped.slots[slot].flags & ENTRY_USED; slot = (slot + 1) & mask)
+		{
+			const PackEntry& entry = mapped.slots[slot];
+			if (entry.hash != hash || name != mapped.strings + entry.name)
+				continue;
+
+			const char* stored = mapped.data + entry.offset;
+			if (entry.flags & ENTRY_LZ4)
+			{
+				asset.storage.resize((size_t)entry.size);
+				if (!decompress(stored, (size_t)entry.storedSize, asset.storage.data(), asset.storage.size()))
+				{
+					std::cout << "ERROR::PACK::CORRUPT_ENTRY " << name << std::endl;
+					return false;
+				}
+				asset.data = asset.storage.data();
+			}
+			else
+			{
+				asset.storage.clear();
+				asset.data = stored;
+			}
+			asset.size = (size_t)entry.size;
+			return true;
+		}
+		return false;
+	}
+
+	bool read(const std::string& path, Asset& asset)
+	{
+		if (load(path, asset))
+			return true;
+		if (!readFile(path, asset.storage))
+			return false;
+		asset.data = asset.storage.data();
+		asset.size = asset.storage.size();
+		return true;
+	}
+
+	// LZ4 block format: sequences of a token, literals and a match of at least
+	// four bytes up to 64KiB back. The last five bytes are always literals and no
+	// match starts in the last twelve
+	static const size_t MIN_MATCH = 4;
+	static const size_t LAST_LITERALS = 5;
+	static const size_t MATCH_LIMIT = 12;
+	static const int HASH_BITS = 12;
+
+	static uint32_t read32(const char* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, 4);
+		return value;
+	}
+
+	// Lengths past 15 continue in bytes of 255 and a final smaller byte
+	static char* writeLength(char* out, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			*out++ = (char)255;
+		*out++ = (char)length;
+		return out;
+	}
+
+	size_t compressBound(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	size_t compress(const char* source, size_t sourceSize, char* destination, size_t capacity)
+	{
+		if (capacity < compressBound(sourceSize))
+			return 0;
+
+		// Positions of the last four byte sequence seen with each hash
+		std::vector<uint32_t> table(1 << HASH_BITS, 0);
+		char* out = destination;
+		size_t anchor = 0;
+		size_t position = 0;
+		while (sourceSize > MATCH_LIMIT && position < sourceSize - MATCH_LIMIT)
+		{
+			uint32_t sequence = read32(source + position);
+			uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			size_t candidate = table[hash];
+			table[hash] = (uint32_t)position;
+			if (candidate >= position || position - candidate > 65535 || read32(source + candidate) != sequence)
+			{
+				position++;
+				continue;
+			}
+
+			size_t length = MIN_MATCH;
+			while (position + length < sourceSize - LAST_LITERALS && source[candidate + length] == source[position + length])
+				length++;
+
+			size_t literals = position - anchor;
+			size_t matchExtra = length - MIN_MATCH;
+			*out++ = (char)(((literals < 15 ? literals : 15) << 4) | (matchExtra < 15 ? matchExtra : 15));
+			if (literals >= 15)
+				out = writeLength(out, literals - 15);
+			memcpy(out, source + anchor, literals);
+			out += literals;
+			size_t offset = position - candidate;
+			*out++ = (char)(offset & 0xff);
+			*out++ = (char)(offset >> 8);
+			if (matchExtra >= 15)
+				out = writeLength(out, matchExtra - 15);
+
+			position += length;
+			anchor = position;
+		}
+
+		size_t literals = sourceSize - anchor;
+		*out++ = (char)((literals < 15 ? literals : 15) << 4);
+		if (literals >= 15)
+			out = writeLength(out, literals - 15);
+		memcpy(out, source + anchor, literals);
+		out += literals;
+		return (size_t)(out - destination);
+	}
+
+	// Adds the 255 continued bytes of a length, false if the input runs out
+	static bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length)
+	{
+		unsigned char byte;
+		do
+		{
+			if (in >= end)
+				return false;
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	bool decompress(const char* source, size_t sourceSize, char* destination, size_t size)
+	{
+		const unsigned char* in = (const unsigned char*)source;
+		const unsigned char* inEnd = in + sourceSize;
+		char* out = destination;
+		char* outEnd = destination + size;
+		while (in < inEnd)
+		{
+			unsigned char token = *in++;
+			size_t literals = token >> 4;
+			if (literals == 15 && !readLength(in, inEnd, literals))
+				return false;
+			if (literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out))
+				return false;
+			memcpy(out, in, literals);
+			in += literals;
+			out += literals;
+			if (in == inEnd)
+				break;
+
+			if (inEnd - in < 2)
+				return false;
+			size_t offset = in[0] | (in[1] << 8);
+			in += 2;
+			if (offset == 0 || offset > (size_t)(out - destination))
+				return false;
+			size_t length = token & 15;
+			if (length == 15 && !readLength(in, inEnd, length))
+				return false;
+			length += MIN_MATCH;
+			if (length > (size_t)(outEnd - out))
+				return false;
+			// Matches may overlap what they write, so copy forwards one byte at a time
+			const char* match = out - offset;
+			for (size_t i = 0; i < length; i++)
+				out[i] = match[i];
+			out += length;
+		}
+		return out == outEnd;
+	}
+}
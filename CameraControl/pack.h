@@ -0,0 +1,53 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Assets gathered into one file, so startup maps a single file instead of opening
+// every object, texture and shader through a path relative to the working
+// directory. The table of contents is an open addressing hash table of the asset
+// paths and every entry starts on a page boundary, so it is used straight from
+// the mapping. Entries can be stored LZ4 compressed, those are expanded on load
+namespace pack
+{
+	// Entries start on multiples of this, the page size of the usual mapping granularity
+	const size_t ALIGNMENT = 4096;
+
+	// The bytes of an asset, pointing into the mapping or into storage when they had
+	// to be decompressed or read from disk
+	struct Asset
+	{
+		const char* data = NULL;
+		size_t size = 0;
+		std::vector<char> storage;
+	};
+
+	// Write the files into a pack. With compress, entries that shrink by at least
+	// an eighth are stored compressed. Returns false if a file is missing
+	bool write(const std::string& path, const std::vector<std::string>& files, bool compress);
+
+	// Map a pack, loads look in it until it is closed. Returns false if it is
+	// missing or not a valid pack
+	bool open(const std::string& path);
+	void close();
+	bool isOpen();
+
+	// Find an asset in the open pack
+	bool load(const std::string& path, Asset& asset);
+
+	// The asset from the open pack if it holds it, otherwise read from disk
+	bool read(const std::string& path, Asset& asset);
+
+	// Paths are looked up with '/' separators and without a leading "./"
+	std::string normalize(const std::string& path);
+
+	// LZ4 block format. compress returns the compressed size, 0 if it does not
+	// fit in capacity. decompress fails unless exactly size bytes come out
+	size_t compressBound(size_t size);
+	size_t compress(const char* source, size_t sourceSize, char* destination, size_t capacity);
+	bool decompress(const char* source, size_t sourceSize, char* destination, size_t size);
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+
+#include "jobs.h"
+
+// Threads parallelFor uses when the caller does not ask for a number
+inline unsigned int parallelThreadCount()
+{
+	return jobs::threadCount();
+}
+
+template <class F>
+void parallelForRange(void* fn, size_t begin, size_t end)
+{
+	(*(const F*)fn)(begin, end);
+}
+
+// Split [0, count) into contiguous ranges of at least minRange elements and run
+// fn(begin, end) for each range as a job, the calling thread takes the first range
+// and then helps with the rest. Returns once every range is done. threads limits
+// the number of ranges, 0 allows one per scheduler thread
+template <class F>
+void parallelFor(size_t count, size_t minRange, const F& fn, unsigned int threads = 0)
+{
+	if (count == 0)
+		return;
+	if (threads == 0)
+		threads = parallelThreadCount();
+
+	minRange = std::max<size_t>(minRange, 1);
+	size_t ranges = std::min<size_t>(threads, (count + minRange - 1) / minRange);
+	if (ranges <= 1)
+	{
+		fn((size_t)0, count);
+		return;
+	}
+
+	size_t step = (count + ranges - 1) / ranges;
+	jobs::Counter counter;
+	for (size_t begin = step; begin < count; begin += step)
+		jobs::run(&parallelForRange<F>, (void*)&fn, begin, std::min(count, begin + step), counter);
+
+	fn((size_t)0, step);
+	jobs::wait(counter);
+}
+
+#endif
@@ -0,0 +1,370 @@
+// CPU / GPU scope profiler with a rolling summary and Chrome trace output
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "profiler.h"
+
+namespace profiler
+{
+	// A single timed scope, times are microseconds since init()
+	struct ScopeRecord
+	{
+		const char* name;
+		int depth;
+		double cpuBegin;
+		double cpuEnd;
+		bool gpu;
+		unsigned int queryBegin;	// Index into the frame's query pool
+		double gpuBegin;
+		double gpuEnd;
+	};
+
+	struct FrameRecord
+	{
+		std::vector<ScopeRecord> scopes;
+		std::vector<GLuint> queries;
+		unsigned int queriesUsed = 0;
+		bool pending = false;
+		bool traced = false;
+	};
+
+	// Totals for one scope name over the report interval
+	struct Stat
+	{
+		const char* name;
+		int depth;
+		double cpuTotal;
+		double gpuTotal;
+		int gpuSamples;
+	};
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+#ifdef PROFILER_ENABLED
+	static bool enabled = true;
+#else
+	static bool enabled = false;
+#endif
+	static bool initialised = false;
+	static Clock::time_point epoch;
+	static double gpuOffset = 0.0;	// GPU timestamp (us) to CPU timeline
+
+	static FrameRecord frames[PROFILER_FRAME_LATENCY];
+	static unsigned long long frameIndex = 0;
+	static std::vector<int> stack;
+	static bool inFrame = false;
+
+	static std::vector<Stat> stats;
+	static int framesInReport = 0;
+	static std::string summary;
+
+	static int traceFramesLeft = 0;
+	static std::string tracePath;
+	static std::vector<ScopeRecord> traceEvents;
+
+	static double nowUs()
+	{
+		return std::chrono::duration<double, std::micro>(Clock::now() - epoch).count();
+	}
+
+	void init()
+	{
+		epoch = Clock::now();
+
+		// Line the GPU clock up with the CPU clock for the trace output
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		gpuOffset = nowUs() - gpuNow / 1000.0;
+
+		initialised = true;
+	}
+
+	void shutdown()
+	{
+		for (int i = 0; i < PROFILER_FRAME_LATENCY; i++)
+		{
+			if (!frames[i].queries.empty())
+				glDeleteQueries((GLsizei)frames[i].queries.size(), &frames[i].queries[0]);
+			frames[i] = FrameRecord();
+		}
+		initialised = false;
+	}
+
+	static void resolve(FrameRecord& frame);
+	static void writeTrace();
+
+	// Write a trace still being captured with the frames recorded so far, oldest
+	// first. A frame still open is left out, and GPU times only where they landed
+	static void finishTrace()
+	{
+		bool capturing = traceFramesLeft > 0, resolved = false;
+		traceFramesLeft = 0;
+		for (int i = 1; i <= PROFILER_FRAME_LATENCY; i++)
+		{
+			FrameRecord& frame = frames[(frameIndex + i) % PROFILER_FRAME_LATENCY];
+			if (!frame.pending || !frame.traced)
+				continue;
+			capturing = true;
+			if (inFrame && i == PROFILER_FRAME_LATENCY)
+				frame.traced = false;
+			else
+			{
+				resolve(frame);
+				resolved = true;
+			}
+		}
+		// Resolving the last traced frame may have written it already
+		if (capturing && (!resolved || !traceEvents.empty()))
+			writeTrace();
+	}
+
+	void setEnabled(bool value)
+	{
+#ifdef PROFILER_ENABLED
+		// Disabled frames are never resolved, so a trace being captured is
+		// written now rather than left unfinished
+		if (enabled && !value && initialised)
+			finishTrace();
+		enabled = value;
+#endif
+	}
+
+	bool isEnabled()
+	{
+		return enabled;
+	}
+
+	static void writeTrace()
+	{
+		std::ofstream file(tracePath);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << tracePath << std::endl;
+			return;
+		}
+
+		file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+		for (size_t i = 0; i < traceEvents.size(); i++)
+		{
+			const ScopeRecord& e = traceEvents[i];
+			file << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << e.cpuBegin
+				<< ",\"dur\":" << e.cpuEnd - e.cpuBegin << "}";
+			if (e.gpu && e.gpuEnd >= e.gpuBegin && e.gpuBegin > 0.0)
+			{
+				file << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":" << e.gpuBegin
+					<< ",\"dur\":" << e.gpuEnd - e.gpuBegin << "}";
+			}
+		}
+		file << "\n]}\n";
+
+		std::cout << "Profiler trace written to " << tracePath << " (" << traceEvents.size() << " scopes)" << std::endl;
+		traceEvents.clear();
+	}
+
+	static void report()
+	{
+		std::ostringstream console;
+		console << std::fixed << std::setprecision(3)
+			<< "---- profile (avg of " << framesInReport << " frames, ms) ----" << std::endl;
+
+		for (size_t i = 0; i < stats.size(); i++)
+		{
+			const Stat& s = stats[i];
+			console << std::string(s.depth * 2, ' ') << std::left << std::setw(24 - s.depth * 2) << s.name
+				<< " cpu " << std::right << std::setw(8) << s.cpuTotal / framesInReport / 1000.0;
+			if (s.gpuSamples > 0)
+				console << "  gpu " << std::setw(8) << s.gpuTotal / s.gpuSamples / 1000.0;
+			console << std::endl;
+		}
+		std::cout << console.str();
+
+		// The first top level scope is the whole frame
+		std::ostringstream line;
+		line << std::fixed << std::setprecision(2);
+		if (!stats.empty())
+		{
+			line << "cpu " << stats[0].cpuTotal / framesInReport / 1000.0 << " ms";
+			double gpu = 0.0;
+			for (size_t i = 0; i < stats.size(); i++)
+				if (stats[i].depth == 1 && stats[i].gpuSamples > 0)
+					gpu += stats[i].gpuTotal / stats[i].gpuSamples / 1000.0;
+			line << " | gpu " << gpu << " ms";
+		}
+		summary = line.str();
+
+		stats.clear();
+		framesInReport = 0;
+	}
+
+	// Collect the results of a frame that was submitted PROFILER_FRAME_LATENCY frames ago
+	static void resolve(FrameRecord& frame)
+	{
+		if (!frame.pending)
+			return;
+		frame.pending = false;
+
+		// Only read the queries back if they are ready, otherwise drop the GPU
+		// numbers for this frame rather than stall the pipeline
+		bool gpuReady = frame.queriesUsed > 0;
+		if (gpuReady)
+		{
+			GLint available = 0;
+			glGetQueryObjectiv(frame.queries[frame.queriesUsed - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			gpuReady = available != 0;
+		}
+
+		for (size_t i = 0; i < frame.scopes.size(); i++)
+		{
+			ScopeRecord& scope = frame.scopes[i];
+			scope.gpuBegin = scope.gpuEnd = 0.0;
+			if (scope.gpu && gpuReady)
+			{
+				GLuint64 begin = 0, end = 0;
+				glGetQueryObjectui64v(frame.queries[scope.queryBegin], GL_QUERY_RESULT, &begin);
+				glGetQueryObjectui64v(frame.queries[scope.queryBegin + 1], GL_QUERY_RESULT, &end);
+				scope.gpuBegin = begin / 1000.0 + gpuOffset;
+				scope.gpuEnd = end / 1000.0 + gpuOffset;
+			}
+
+			// Names are string literals, so pointer equality is the common case
+			Stat* stat = NULL;
+			for (size_t s = 0; s < stats.size() && !stat; s++)
+				if (stats[s].depth == scope.depth && (stats[s].name == scope.name || strcmp(stats[s].name, scope.name) == 0))
+					stat = &stats[s];
+			if (!stat)
+			{
+				Stat fresh = { scope.name, scope.depth, 0.0, 0.0, 0 };
+				stats.push_back(fresh);
+				stat = &stats.back();
+			}
+
+			stat->cpuTotal += scope.cpuEnd - scope.cpuBegin;
+			if (scope.gpu && gpuReady)
+			{
+				stat->gpuTotal += scope.gpuEnd - scope.gpuBegin;
+				stat->gpuSamples++;
+			}
+		}
+
+		if (frame.traced)
+		{
+			traceEvents.insert(traceEvents.end(), frame.scopes.begin(), frame.scopes.end());
+			if (traceFramesLeft == 0)
+			{
+				bool last = true;
+				for (int i = 0; i < PROFILER_FRAME_LATENCY; i++)
+					last = last && !(frames[i].pending && frames[i].traced);
+				if (last)
+					writeTrace();
+			}
+		}
+
+		if (++framesInReport >= PROFILER_REPORT_INTERVAL)
+			report();
+	}
+
+	void beginFrame()
+	{
+		if (!enabled || !initialised)
+			return;
+
+		FrameRecord& frame = frames[frameIndex % PROFILER_FRAME_LATENCY];
+		resolve(frame);
+
+		frame.scopes.clear();
+		frame.queriesUsed = 0;
+		frame.pending = true;
+		frame.traced = traceFramesLeft > 0;
+		if (traceFramesLeft > 0)
+			traceFramesLeft--;
+
+		stack.clear();
+		inFrame = true;
+		pushScope("Frame", false);
+	}
+
+	void endFrame()
+	{
+		if (!inFrame)
+			return;
+
+		while (!stack.empty())
+			popScope();
+		inFrame = false;
+		frameIndex++;
+	}
+
+	void pushScope(const char* name, bool gpu)
+	{
+		if (!inFrame)
+			return;
+
+		FrameRecord& frame = frames[frameIndex % PROFILER_FRAME_LATENCY];
+
+		ScopeRecord scope;
+		scope.name = name;
+		scope.depth = (int)stack.size();
+		scope.gpu = gpu;
+		scope.queryBegin = 0;
+		scope.gpuBegin = scope.gpuEnd = 0.0;
+
+		if (gpu)
+		{
+			// Timestamp pairs rather than GL_TIME_ELAPSED so scopes can nest
+			if (frame.queries.size() < frame.queriesUsed + 2)
+			{
+				size_t old = frame.queries.size();
+				frame.queries.resize(old + 16);
+				glGenQueries(16, &frame.queries[old]);
+			}
+			scope.queryBegin = frame.queriesUsed;
+			frame.queriesUsed += 2;
+			glQueryCounter(frame.queries[scope.queryBegin], GL_TIMESTAMP);
+		}
+
+		scope.cpuBegin = nowUs();
+		scope.cpuEnd = scope.cpuBegin;
+
+		stack.push_back((int)frame.scopes.size());
+		frame.scopes.push_back(scope);
+	}
+
+	void popScope()
+	{
+		if (!inFrame || stack.empty())
+			return;
+
+		FrameRecord& frame = frames[frameIndex % PROFILER_FRAME_LATENCY];
+		ScopeRecord& scope = frame.scopes[stack.back()];
+		stack.pop_back();
+
+		scope.cpuEnd = nowUs();
+		if (scope.gpu)
+			glQueryCounter(frame.queries[scope.queryBegin + 1], GL_TIMESTAMP);
+	}
+
+	const std::string& frameSummary()
+	{
+		return summary;
+	}
+
+	void captureTrace(int frameCount, const std::string& path)
+	{
+		if (traceFramesLeft > 0 || !traceEvents.empty())
+			return;
+		traceFramesLeft = frameCount;
+		tracePath = path;
+		std::cout << "Profiler capturing " << frameCount << " frames" << std::endl;
+	}
+}
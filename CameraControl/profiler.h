@@ -0,0 +1,60 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+// Compile the profiling scopes in, comment out to remove them entirely
+#define PROFILER_ENABLED
+
+// Number of frames GPU queries are kept in flight before being read back,
+// results are only read once available so the CPU never waits on the GPU
+const int PROFILER_FRAME_LATENCY = 3;
+
+// Frames averaged for each console / title summary
+const int PROFILER_REPORT_INTERVAL = 60;
+
+namespace profiler
+{
+	// Create the query pools and calibrate the GPU clock, needs a current GL context
+	void init();
+	void shutdown();
+
+	// Runtime switch, when disabled scopes cost a single branch. Disabling writes a
+	// trace still being captured with the frames recorded so far
+	void setEnabled(bool enabled);
+	bool isEnabled();
+
+	// Frame boundaries, all scopes must be opened and closed between these
+	void beginFrame();
+	void endFrame();
+
+	// Nested scopes, gpu scopes also record GL timestamps
+	void pushScope(const char* name, bool gpu);
+	void popScope();
+
+	// One line summary of the last report interval (for the window title)
+	const std::string& frameSummary();
+
+	// Record the next frameCount frames and write them as Chrome trace JSON
+	// (chrome://tracing or ui.perfetto.dev) once they have been resolved
+	void captureTrace(int frameCount, const std::string& path);
+
+	// Closes the enclosing scope when it goes out of C++ scope
+	struct Scope
+	{
+		Scope(const char* name, bool gpu) { pushScope(name, gpu); }
+		~Scope() { popScope(); }
+	};
+}
+
+#ifdef PROFILER_ENABLED
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) profiler::Scope PROFILER_CONCAT(profileScope, __LINE__)(name, false)
+#define PROFILE_GPU_SCOPE(name) profiler::Scope PROFILER_CONCAT(profileScope, __LINE__)(name, true)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,148 @@
+// Fenced ring buffer for per frame data
+
+#include <iostream>
+
+#include "ringbuffer.h"
+
+RingBuffer::~RingBuffer()
+{
+	// Global buffers outlive glfwTerminate, there is no context left to free them with
+	if (id)
+		std::cout << "ERROR::RINGBUFFER::NOT_DESTROYED" << std::endl;
+}
+
+bool RingBuffer::create(GLenum bufferTarget, size_t bytes, int sections)
+{
+	destroy();
+
+	target = bufferTarget;
+	sectionBytes = bytes;
+	sectionCount = sections < 1 ? 1 : (sections > MAX_SECTIONS ? MAX_SECTIONS : sections);
+	section = sectionCount - 1;
+	head = 0;
+
+	size_t totalBytes = sectionBytes * sectionCount;
+	glGenBuffers(1, &id);
+	glBindBuffer(target, id);
+
+	persistent = GLEW_ARB_buffer_storage != 0;
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, totalBytes, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(target, 0, totalBytes, flags);
+		if (!mapped)
+		{
+			std::cout << "ERROR::RINGBUFFER::MAP_FAILED" << std::endl;
+			glBindBuffer(target, 0);
+			destroy();
+			return false;
+		}
+	}
+	else
+		glBufferData(target, totalBytes, NULL, GL_STREAM_DRAW);
+
+	glBindBuffer(target, 0);
+	return true;
+}
+
+void RingBuffer::destroy()
+{
+	if (!id)
+		return;
+
+	for (int i = 0; i < sectionCount; i++)
+	{
+		if (fences[i])
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+	if (mapped)
+	{
+		glBindBuffer(target, id);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		mapped = NULL;
+	}
+	glDeleteBuffers(1, &id);
+	id = 0;
+}
+
+bool RingBuffer::reserve(size_t bytes)
+{
+	if (id && bytes <= sectionBytes)
+		return true;
+
+	// Deleting a buffer the GPU still reads is fine, GL keeps it alive until it is done
+	return create(target, bytes + bytes / 2, sectionCount ? sectionCount : 3);
+}
+
+void RingBuffer::waitFence(int index)
+{
+	if (!fences[index])
+		return;
+
+	GLenum result = glClientWaitSync(fences[index], 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		stallCount++;
+		// Flush so the fence is sure to signal, then block in one millisecond steps
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		do
+		{
+			result = glClientWaitSync(fences[index], flags, 1000000);
+			flags = 0;
+		}
+		while (result == GL_TIMEOUT_EXPIRED);
+	}
+	glDeleteSync(fences[index]);
+	fences[index] = 0;
+}
+
+void RingBuffer::beginFrame()
+{
+	section = (section + 1) % sectionCount;
+	head = 0;
+	waitFence(section);
+
+	// The fence already covers this section, so the map must not sync again
+	if (!persistent)
+	{
+		glBindBuffer(target, id);
+		mapped = (unsigned char*)glMapBufferRange(target, section * sectionBytes, sectionBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		glBindBuffer(target, 0);
+		if (!mapped)
+			std::cout << "ERROR::RINGBUFFER::MAP_FAILED" << std::endl;
+	}
+}
+
+void* RingBuffer::allocate(size_t bytes, size_t alignment, GLintptr& offset)
+{
+	size_t start = alignment > 1 ? (head + alignment - 1) / alignment * alignment : head;
+	if (!mapped || start + bytes > sectionBytes)
+		return NULL;
+
+	head = start + bytes;
+	offset = (GLintptr)(section * sectionBytes + start);
+	// The persistent mapping covers every section, the fallback maps only this one
+	return persistent ? mapped + offset : mapped + start;
+}
+
+void RingBuffer::finishWrites()
+{
+	if (!persistent && mapped)
+	{
+		glBindBuffer(target, id);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		mapped = NULL;
+	}
+}
+
+void RingBuffer::endFrame()
+{
+	fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,60 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <stddef.h>
+
+// Buffer for data written fresh every frame (uniform blocks, instance data). It is
+// split into one section per frame in flight and each section is fenced after its
+// frame is submitted, so the CPU only waits when it laps the GPU. With
+// ARB_buffer_storage the buffer stays mapped persistently and coherently and
+// writes go straight to memory the GPU reads. Without it each section is mapped
+// unsynchronized for the writes and unmapped before the draws
+class RingBuffer
+{
+public:
+	static const int MAX_SECTIONS = 4;
+
+	// destroy() has to have run while the GL context was current
+	~RingBuffer();
+
+	// Allocate sections * sectionBytes, target is where the buffer is bound to map it
+	bool create(GLenum target, size_t sectionBytes, int sections = 3);
+	void destroy();
+
+	// Make sure a section holds at least bytes, recreating the buffer if it is smaller
+	bool reserve(size_t bytes);
+
+	// Move to the next section, waiting until the GPU has finished reading it
+	void beginFrame();
+	// Carve an aligned slice out of the current section. Returns a pointer to write
+	// to and the slice's offset in the buffer, or NULL if the section is full
+	void* allocate(size_t bytes, size_t alignment, GLintptr& offset);
+	// Done writing, the slices can be used by draws from here on
+	void finishWrites();
+	// Fence the section once the draws reading it are submitted
+	void endFrame();
+
+	GLuint buffer() const { return id; }
+	bool isPersistent() const { return persistent; }
+	// Number of frames beginFrame had to block for the GPU
+	unsigned long long stalls() const { return stallCount; }
+
+private:
+	void waitFence(int index);
+
+	GLenum target = GL_UNIFORM_BUFFER;
+	GLuint id = 0;
+	unsigned char* mapped = NULL;
+	bool persistent = false;
+	size_t sectionBytes = 0;
+	int sectionCount = 0;
+	int section = 0;
+	size_t head = 0;
+	GLsync fences[MAX_SECTIONS] = {};
+	unsigned long long stallCount = 0;
+};
+
+#endif
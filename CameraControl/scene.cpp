@@ -0,0 +1,555 @@
+// Scene files: text for authoring, a baked binary form for fast loading
+
+#include <iostream>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "scene.h"
+#include "pack.h"
+#include "xorshift.h"
+
+// Binary layout: header, string table, material and mesh records holding string
+// table offsets (materials then their flags), the nodes in depth first order, then the object and animation
+// arrays exactly as they are in memory
+static const uint32_t SCENE_MATERIAL_MATTE = 1;
+static const char SCENE_MAGIC[4] = { 'S', 'C', 'N', 'B' };
+static const uint32_t SCENE_VERSION = 3;
+
+struct SceneHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t materialCount;
+	uint32_t meshCount;
+	uint32_t nodeCount;
+	uint32_t objectCount;
+	uint32_t animationCount;
+	uint32_t stringBytes;
+};
+
+// The arrays are read straight into the vectors, so their layout must not change silently
+struct SceneNodeRecord
+{
+	int32_t parent;
+	glm::mat4 local;
+};
+
+static_assert(sizeof(SceneNodeRecord) == 17 * 4, "SceneNodeRecord is stored as is in binary scenes");
+static_assert(sizeof(SceneObject) == 2 * 4, "SceneObject is stored as is in binary scenes");
+static_assert(sizeof(SceneAnimation) == 11 * 4, "SceneAnimation is stored as is in binary scenes");
+
+static const glm::vec3 UP(0.0f, 1.0f, 0.0f);
+
+// Apply the rotation and scale of a transform to m
+static glm::mat4 rotateScale(glm::mat4 m, const SceneTransform& transform)
+{
+	if (transform.rotation.x != 0.0f)
+		m = glm::rotate(m, glm::radians(transform.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	if (transform.rotation.y != 0.0f)
+		m = glm::rotate(m, glm::radians(transform.rotation.y), UP);
+	if (transform.rotation.z != 0.0f)
+		m = glm::rotate(m, glm::radians(transform.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	return glm::scale(m, transform.scale);
+}
+
+glm::mat4 composeTransform(const SceneTransform& transform)
+{
+	return rotateScale(glm::translate(glm::mat4(), transform.position), transform);
+}
+
+static glm::mat4 animatedTransform(const SceneAnimation& animation, double time)
+{
+	// Keep the angle small so float precision does not run out in long sessions
+	float spin = (float)fmod(animation.spinSpeed * time, 360.0);
+
+	glm::mat4 local = glm::translate(glm::mat4(), animation.transform.position);
+	local = glm::rotate(local, glm::radians(spin), UP);
+	return rotateScale(local, animation.transform);
+}
+
+void Scene::clear()
+{
+	materials.clear();
+	meshes.clear();
+	objects.clear();
+	animations.clear();
+	transforms.clear();
+}
+
+int Scene::findMesh(const std::string& name) const
+{
+	for (size_t i = 0; i < meshes.size(); i++)
+		if (meshes[i].name == name)
+			return (int)i;
+	return -1;
+}
+
+bool Scene::isAnimated(unsigned int node) const
+{
+	for (int at = (int)node; at >= 0; at = transforms.parent((unsigned int)at))
+	{
+		for (size_t i = 0; i < animations.size(); i++)
+			if (animations[i].node == (unsigned int)at)
+				return true;
+	}
+	return false;
+}
+
+size_t Scene::animate(double time, unsigned int threads)
+{
+	for (size_t i = 0; i < animations.size(); i++)
+		transforms.setLocal(animations[i].node, animatedTransform(animations[i], time));
+	return transforms.update(threads);
+}
+
+bool Scene::load(const std::string& path)
+{
+	pack::Asset file;
+	if (!pack::read(path, file))
+		return false;
+
+	if (file.size >= 4 && memcmp(file.data, SCENE_MAGIC, 4) == 0)
+		return parseBinary(path, file.data, file.size);
+	return parseText(path, file.data, file.size);
+}
+
+bool Scene::loadText(const std::string& path)
+{
+	pack::Asset file;
+	return pack::read(path, file) && parseText(path, file.data, file.size);
+}
+
+bool Scene::loadBinary(const std::string& path)
+{
+	pack::Asset file;
+	return pack::read(path, file) && parseBinary(path, file.data, file.size);
+}
+
+// Whitespace separated tokens of one line, parsed in place
+struct LineReader
+{
+	const char* at;
+	const char* end;
+
+	void skipSpace()
+	{
+		while (at < end && (*at == ' ' || *at == '\t' || *at == '\r'))
+			at++;
+	}
+
+	bool word(std::string& out)
+	{
+		skipSpace();
+		const char* start = at;
+		while (at < end && *at != ' ' && *at != '\t' && *at != '\r')
+			at++;
+		out.assign(start, at);
+		return at > start;
+	}
+
+	// Leaves the cursor alone if the next token is not a number
+	bool number(float& out)
+	{
+		skipSpace();
+		if (at >= end)
+			return false;
+		char* stop;
+		float value = strtof(at, &stop);
+		if (stop == at || stop > end)
+			return false;
+		out = value;
+		at = stop;
+		return true;
+	}
+
+	bool vec3(glm::vec3& out)
+	{
+		return number(out.x) && number(out.y) && number(out.z);
+	}
+};
+
+// Children listed after other nodes split their parent's subtree, put them back together
+static void sortNodes(Scene& scene)
+{
+	if (scene.transforms.isDepthFirst())
+		return;
+
+	std::vector<unsigned int> remap;
+	scene.transforms.sortDepthFirst(remap);
+	for (size_t i = 0; i < scene.objects.size(); i++)
+		scene.objects[i].node = remap[scene.objects[i].node];
+	for (size_t i = 0; i < scene.animations.size(); i++)
+		scene.animations[i].node = remap[scene.animations[i].node];
+}
+
+bool Scene::parseText(const std::string& path, const char* text, size_t size)
+{
+	clear();
+	std::unordered_map<std::string, unsigned int> meshIds;
+	std::unordered_map<std::string, unsigned int> groupNodes;
+	std::string keyword, name, value;
+	int lineNumber = 0;
+
+	const char* at = text;
+	const char* textEnd = text + size;
+	while (at < textEnd)
+	{
+		const char* lineEnd = (const char*)memchr(at, '\n', textEnd - at);
+		if (!lineEnd)
+			lineEnd = textEnd;
+		LineReader line = { at, lineEnd };
+		at = lineEnd + 1;
+		lineNumber++;
+
+		if (!line.word(keyword) || keyword[0] == '#')
+			continue;
+
+		bool valid = true;
+		if (keyword == "material")
+		{
+			SceneMaterial material;
+			valid = line.word(material.name) && line.word(material.diffuse);
+			std::string option;
+			if (valid && line.word(option))
+			{
+				valid = option == "matte";
+				material.matte = valid;
+			}
+			if (valid)
+				materials.push_back(material);
+		}
+		else if (keyword == "mesh")
+		{
+			SceneMesh mesh;
+			valid = line.word(mesh.name) && line.word(mesh.path);
+			line.word(mesh.material);
+			if (valid)
+			{
+				meshIds[mesh.name] = (unsigned int)meshes.size();
+				meshes.push_back(mesh);
+			}
+		}
+		else if (keyword == "group" || keyword == "object")
+		{
+			// Groups are named nodes without a mesh, objects are drawn
+			bool isGroup = keyword == "group";
+			valid = line.word(name) && (isGroup || meshIds.count(name) > 0);
+
+			SceneAnimation animation;
+			animation.spinSpeed = 0.0f;
+			SceneTransform& transform = animation.transform;
+			int parent = -1;
+			while (valid && line.word(value))
+			{
+				if (value == "position")
+					valid = line.vec3(transform.position);
+				else if (value == "rotation")
+					valid = line.vec3(transform.rotation);
+				else if (value == "scale")
+				{
+					// One value scales uniformly
+					valid = line.number(transform.scale.x);
+					transform.scale.y = transform.scale.z = transform.scale.x;
+					if (valid && line.number(transform.scale.y))
+						valid = line.number(transform.scale.z);
+				}
+				else if (value == "spin")
+					valid = line.number(animation.spinSpeed);
+				else if (value == "parent")
+				{
+					valid = line.word(value) && groupNodes.count(value) > 0;
+					if (valid)
+						parent = (int)groupNodes[value];
+				}
+				else
+					valid = false;
+			}
+
+			if (valid)
+			{
+				animation.node = transforms.add(composeTransform(transform), parent);
+				if (animation.spinSpeed != 0.0f)
+					animations.push_back(animation);
+
+				if (isGroup)
+					groupNodes[name] = animation.node;
+				else
+				{
+					SceneObject object;
+					object.mesh = meshIds[name];
+					object.node = animation.node;
+					objects.push_back(object);
+				}
+			}
+		}
+		else if (keyword == "scatter")
+		{
+			// scatter <mesh> <count> <seed> <minX> <minZ> <maxX> <maxZ> <y> <minScale> <maxScale>
+			float count, seed, minX, minZ, maxX, maxZ, y, minScale, maxScale;
+			valid = line.word(name) && meshIds.count(name) > 0 && line.number(count) && line.number(seed)
+				&& line.number(minX) && line.number(minZ) && line.number(maxX) && line.number(maxZ)
+				&& line.number(y) && line.number(minScale) && line.number(maxScale) && count >= 0.0f;
+			if (valid)
+			{
+				// The same seed always places the same instances
+				XorShift32 random((uint32_t)seed);
+
+				objects.reserve(objects.size() + (size_t)count);
+				for (unsigned int i = 0; i < (unsigned int)count; i++)
+				{
+					SceneTransform transform;
+					transform.position = glm::vec3(minX + (maxX - minX) * random(), y, minZ + (maxZ - minZ) * random());
+					transform.rotation.y = 360.0f * random();
+					transform.scale = glm::vec3(minScale + (maxScale - minScale) * random());
+
+					SceneObject object;
+					object.mesh = meshIds[name];
+					object.node = transforms.add(composeTransform(transform));
+					objects.push_back(object);
+				}
+			}
+		}
+		else
+			valid = false;
+
+		if (!valid)
+			std::cout << "ERROR::SCENE::INVALID_LINE " << path << ":" << lineNumber << std::endl;
+	}
+
+	sortNodes(*this);
+	return !objects.empty();
+}
+
+// Offset of a string in the table, adding it
+static uint32_t addString(std::string& table, const std::string& value)
+{
+	uint32_t offset = (uint32_t)table.size();
+	table += value;
+	table += '\0';
+	return offset;
+}
+
+bool Scene::saveBinary(const std::string& path) const
+{
+	std::string strings;
+	std::vector<uint32_t> materialRecords;
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		materialRecords.push_back(addString(strings, materials[i].name));
+		materialRecords.push_back(addString(strings, materials[i].diffuse));
+		materialRecords.push_back(materials[i].matte ? SCENE_MATERIAL_MATTE : 0);
+	}
+	std::vector<uint32_t> meshRecords;
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		meshRecords.push_back(addString(strings, meshes[i].name));
+		meshRecords.push_back(addString(strings, meshes[i].path));
+		meshRecords.push_back(addString(strings, meshes[i].material));
+	}
+
+	std::vector<SceneNodeRecord> nodes(transforms.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		nodes[i].parent = transforms.parent((unsigned int)i);
+		nodes[i].local = transforms.local((unsigned int)i);
+	}
+
+	SceneHeader header;
+	memcpy(header.magic, SCENE_MAGIC, 4);
+	header.version = SCENE_VERSION;
+	header.materialCount = (uint32_t)materials.size();
+	header.meshCount = (uint32_t)meshes.size();
+	header.nodeCount = (uint32_t)nodes.size();
+	header.objectCount = (uint32_t)objects.size();
+	header.animationCount = (uint32_t)animations.size();
+	header.stringBytes = (uint32_t)strings.size();
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "ERROR::SCENE::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(strings.data(), 1, strings.size(), file) == strings.size()
+		&& fwrite(materialRecords.data(), sizeof(uint32_t), materialRecords.size(), file) == materialRecords.size()
+		&& fwrite(meshRecords.data(), sizeof(uint32_t), meshRecords.size(), file) == meshRecords.size()
+		&& fwrite(nodes.data(), sizeof(SceneNodeRecord), nodes.size(), file) == nodes.size()
+		&& fwrite(objects.data(), sizeof(SceneObject), objects.size(), file) == objects.size()
+		&& fwrite(animations.data(), sizeof(SceneAnimation), animations.size(), file) == animations.size();
+	fclose(file);
+
+	if (!written)
+		std::cout << "ERROR::SCENE::CANNOT_WRITE " << path << std::endl;
+	return written;
+}
+
+// Copies the next bytes of a file held in memory, false once it runs out
+struct MemoryReader
+{
+	const char* at;
+	const char* end;
+
+	bool read(void* out, size_t size, size_t count)
+	{
+		size_t bytes = size * count;
+		if ((size_t)(end - at) < bytes)
+			return false;
+		memcpy(out, at, bytes);
+		at += bytes;
+		return true;
+	}
+
+	// Resize out to count elements and read them. The count comes from the file,
+	// so it is checked against the bytes left before anything is allocated for it
+	template <class Container>
+	bool readArray(Container& out, size_t count)
+	{
+		if (count > (size_t)(end - at) / sizeof(typename Container::value_type))
+			return false;
+		out.resize(count);
+		return count == 0 || read(&out[0], sizeof(out[0]), count);
+	}
+};
+
+bool Scene::parseBinary(const std::string& path, const char* data, size_t size)
+{
+	MemoryReader file = { data, data + size };
+
+	clear();
+	SceneHeader header;
+	bool valid = file.read(&header, sizeof(header), 1)
+		&& memcmp(header.magic, SCENE_MAGIC, 4) == 0 && header.version == SCENE_VERSION;
+
+	std::string strings;
+	std::vector<uint32_t> materialRecords, meshRecords;
+	std::vector<SceneNodeRecord> nodes;
+	if (valid)
+	{
+		valid = file.readArray(strings, header.stringBytes)
+			&& file.readArray(materialRecords, (size_t)header.materialCount * 3)
+			&& file.readArray(meshRecords, (size_t)header.meshCount * 3)
+			&& file.readArray(nodes, header.nodeCount)
+			&& file.readArray(objects, header.objectCount)
+			&& file.readArray(animations, header.animationCount);
+	}
+
+	// Every offset and index has to point inside the file's own tables
+	for (size_t i = 0; valid && i < materialRecords.size(); i++)
+		valid = i % 3 == 2 || materialRecords[i] < strings.size();
+	for (size_t i = 0; valid && i < meshRecords.size(); i++)
+		valid = meshRecords[i] < strings.size();
+	for (size_t i = 0; valid && i < nodes.size(); i++)
+		valid = nodes[i].parent < (int32_t)i;
+	for (size_t i = 0; valid && i < objects.size(); i++)
+		valid = objects[i].mesh < header.meshCount && objects[i].node < header.nodeCount;
+	for (size_t i = 0; valid && i < animations.size(); i++)
+		valid = animations[i].node < header.nodeCount;
+	if (valid && !strings.empty())
+		valid = strings.back() == '\0';
+
+	if (!valid)
+	{
+		std::cout << "ERROR::SCENE::INVALID_BINARY " << path << std::endl;
+		clear();
+		return false;
+	}
+
+	materials.resize(header.materialCount);
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		materials[i].name = &strings[materialRecords[i * 3]];
+		materials[i].diffuse = &strings[materialRecords[i * 3 + 1]];
+		materials[i].matte = (materialRecords[i * 3 + 2] & SCENE_MATERIAL_MATTE) != 0;
+	}
+	meshes.resize(header.meshCount);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		meshes[i].name = &strings[meshRecords[i * 3]];
+		meshes[i].path = &strings[meshRecords[i * 3 + 1]];
+		meshes[i].material = &strings[meshRecords[i * 3 + 2]];
+	}
+
+	// Roots, the bulk of most scenes, just copy their local matrix
+	transforms.reserve(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+		transforms.add(nodes[i].local, nodes[i].parent);
+	sortNodes(*this);
+
+	return !objects.empty();
+}
+
+void Scene::makeDefault()
+{
+	clear();
+
+	// The object files name these materials but their MTL files are not shipped
+	const char* materialTextures[][2] = {
+		{ "watchtower", "textures/watchtower.dds" },
+		{ "Fir_v1", "textures/fir.dds" },
+		{ "floor", "textures/floor1.dds" },
+		{ "Raven.001", "textures/raven.dds" },
+	};
+	for (size_t i = 0; i < 4; i++)
+	{
+		SceneMaterial material;
+		material.name = materialTextures[i][0];
+		material.diffuse = materialTextures[i][1];
+		material.matte = material.name == "floor";
+		materials.push_back(material);
+	}
+
+	const char* meshFiles[][3] = {
+		{ "watchtower", "objects/watchtower.obj", "" },
+		{ "tree", "objects/fir.obj", "" },
+		{ "floor", "@floor", "floor" },
+		{ "raven", "objects/raven.obj", "" },
+	};
+	for (size_t i = 0; i < 4; i++)
+	{
+		SceneMesh mesh;
+		mesh.name = meshFiles[i][0];
+		mesh.path = meshFiles[i][1];
+		mesh.material = meshFiles[i][2];
+		meshes.push_back(mesh);
+	}
+
+	SceneObject object;
+	SceneTransform transform;
+
+	object.mesh = 0;
+	object.node = transforms.add(composeTransform(transform));
+	objects.push_back(object);
+
+	transform.position = glm::vec3(2.0f, 0.0f, -7.0f);
+	transform.scale = glm::vec3(1.5f);
+	object.mesh = 1;
+	object.node = transforms.add(composeTransform(transform));
+	objects.push_back(object);
+
+	transform.position = glm::vec3(0.0f, 0.635f, 0.0f);
+	transform.scale = glm::vec3(1.0f);
+	object.mesh = 2;
+	object.node = transforms.add(composeTransform(transform));
+	objects.push_back(object);
+
+	// The raven hangs off a node above the tree that turns once every 2 pi seconds
+	SceneAnimation orbit;
+	orbit.transform.position = glm::vec3(-0.25f, 5.94f, -0.25f);
+	orbit.spinSpeed = 57.29578f;
+	orbit.node = transforms.add(composeTransform(orbit.transform));
+	animations.push_back(orbit);
+
+	transform.position = glm::vec3(2.25f, 0.0f, -6.75f);
+	transform.rotation = glm::vec3(45.0f, -90.0f, 0.0f);
+	transform.scale = glm::vec3(0.3f);
+	object.mesh = 3;
+	object.node = transforms.add(composeTransform(transform), (int)orbit.node);
+	objects.push_back(object);
+}
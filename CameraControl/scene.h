@@ -0,0 +1,98 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "transform.h"
+
+// A texture stood in for a material the object files name but do not ship.
+// Matte materials have no specular highlight
+struct SceneMaterial
+{
+	std::string name;
+	std::string diffuse;
+	bool matte = false;
+};
+
+// A mesh and where it comes from. The path "@floor" is the generated terrain,
+// a material name overrides the one the object file uses
+struct SceneMesh
+{
+	std::string name;
+	std::string path;
+	std::string material;
+};
+
+// Placement relative to the parent node, rotation in degrees applied Z, then Y, then X
+struct SceneTransform
+{
+	glm::vec3 position;
+	glm::vec3 rotation;
+	glm::vec3 scale;
+
+	SceneTransform() : scale(1.0f) {}
+};
+
+// One entry of the flat render list, a mesh drawn with the world matrix of a node
+struct SceneObject
+{
+	unsigned int mesh;
+	unsigned int node;
+};
+
+// A node turning about its own vertical axis in degrees per second. Children
+// of a spinning node orbit it
+struct SceneAnimation
+{
+	unsigned int node;
+	SceneTransform transform;
+	float spinSpeed;
+};
+
+// The meshes, materials, transform nodes and placed objects of a scene. Scenes are
+// authored as text and can be baked to a binary file that loads with a handful of reads
+class Scene
+{
+public:
+	// Load a text or binary scene file, the format is told apart by its first bytes.
+	// Scenes in the open asset pack are read from it
+	bool load(const std::string& path);
+	bool loadText(const std::string& path);
+	bool loadBinary(const std::string& path);
+	bool saveBinary(const std::string& path) const;
+
+	// The watchtower, tree, floor and orbiting raven used when no scene file is found
+	void makeDefault();
+
+	// Move the animated nodes and rebuild the world matrices below them, nothing
+	// else changes. Returns the number of world matrices rebuilt
+	size_t animate(double time, unsigned int threads = 0);
+
+	const glm::mat4& world(const SceneObject& object) const { return transforms.world(object.node); }
+
+	// Index of a mesh name, or -1
+	int findMesh(const std::string& name) const;
+
+	// True if an animation moves the node, itself or through one of its parents
+	bool isAnimated(unsigned int node) const;
+
+	void clear();
+
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneMesh> meshes;
+	std::vector<SceneObject> objects;
+	std::vector<SceneAnimation> animations;
+	TransformHierarchy transforms;
+
+private:
+	bool parseText(const std::string& path, const char* text, size_t size);
+	bool parseBinary(const std::string& path, const char* data, size_t size);
+};
+
+// Translation * rotation * scale
+glm::mat4 composeTransform(const SceneTransform& transform);
+
+#endif
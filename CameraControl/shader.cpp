@@ -4,83 +4,262 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 
 #include <GLFW/glfw3.h>
 
-GLuint initShader(const GLchar* vertexPath, const GLchar* fragmentPath){
+#include "shader.h"
+#include "pack.h"
+
+static std::string readShaderFile(const GLchar* path)
+{
+	pack::Asset packed;
+	if (pack::load(path, packed))
+		return std::string(packed.data, packed.size);
 
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
+	std::ifstream shaderFile;
 	// ensures ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::badbit);
+	shaderFile.exceptions(std::ifstream::badbit);
 	try
 	{
-		// Open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		// Read file's buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		// close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
+		// Open file and read its buffer contents into a stream
+		shaderFile.open(path);
+		std::stringstream shaderStream;
+		shaderStream << shaderFile.rdbuf();
+		shaderFile.close();
 		// Convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		return shaderStream.str();
 	}
 	catch (std::ifstream::failure e)
 	{
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
+	return std::string();
+}
 
-	const GLchar* vertexShaderSource = vertexCode.c_str();
-	const GLchar * fragmentShaderSource = fragmentCode.c_str();
+// Start compiling, the status is only asked for once the program is done
+static GLuint startShader(GLenum type, const GLchar* path, const std::string& defines)
+{
+	std::string code = readShaderFile(path);
+	if (!defines.empty())
+	{
+		// #version has to stay the first line
+		size_t lineEnd = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+		if (lineEnd == std::string::npos)
+			code = defines + code;
+		else
+			code.insert(lineEnd + 1, defines);
+	}
+	const GLchar* source = code.c_str();
 
-	// Vertex shader
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-	// Check for compile time errors
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+// Check for compile time errors
+static void checkShader(GLuint shader, const char* stage)
+{
 	GLint success;
 	GLchar infoLog[512];
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog << std::endl;
 	}
-	// Fragment shader
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-	// Check for compile time errors
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-	if (!success)
+}
+
+namespace shaders
+{
+	struct Entry
+	{
+		GLuint program;
+		GLuint vertexShader;
+		GLuint fragmentShader;
+		ProgramSetup setup;
+		Handle fallback;
+		bool ready;
+	};
+
+	static std::vector<Entry> entries;
+	static size_t compiling = 0;
+	static bool parallel = false;
+	static bool configured = false;
+	static double firstSubmit = 0.0;
+	static double lastReady = 0.0;
+
+	// Check the shaders and the link, then hand the program to its setup
+	static void complete(Entry& entry)
+	{
+		checkShader(entry.vertexShader, "VERTEX");
+		checkShader(entry.fragmentShader, "FRAGMENT");
+
+		// Check for linking errors
+		GLint success;
+		GLchar infoLog[512];
+		glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+		if (!success) {
+			glGetProgramInfoLog(entry.program, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		}
+		glDeleteShader(entry.vertexShader);
+		glDeleteShader(entry.fragmentShader);
+		entry.vertexShader = entry.fragmentShader = 0;
+
+		if (entry.setup)
+		{
+			// The setup sets uniforms, leave the bound program as it was
+			GLint bound = 0;
+			glGetIntegerv(GL_CURRENT_PROGRAM, &bound);
+			glUseProgram(entry.program);
+			entry.setup(entry.program);
+			glUseProgram((GLuint)bound);
+		}
+
+		entry.ready = true;
+		compiling--;
+		lastReady = glfwGetTime();
+	}
+
+	Handle submit(const char* vertexPath, const char* fragmentPath, ProgramSetup setup, Handle fallback,
+		const std::string& defines)
+	{
+		if (!configured)
+		{
+			configured = true;
+			// Let the driver pick the number of compiler threads
+			if (GLEW_KHR_parallel_shader_compile)
+			{
+				glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+				parallel = true;
+			}
+			else if (GLEW_ARB_parallel_shader_compile)
+			{
+				glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+				parallel = true;
+			}
+		}
+		if (compiling == 0 && entries.empty())
+			firstSubmit = glfwGetTime();
+
+		Entry entry;
+		entry.vertexShader = startShader(GL_VERTEX_SHADER, vertexPath, defines);
+		entry.fragmentShader = startShader(GL_FRAGMENT_SHADER, fragmentPath, defines);
+
+		// Link shaders
+		entry.program = glCreateProgram();
+		glAttachShader(entry.program, entry.vertexShader);
+		glAttachShader(entry.program, entry.fragmentShader);
+		glLinkProgram(entry.program);
+
+		entry.setup = setup;
+		entry.fallback = fallback;
+		entry.ready = false;
+		entries.push_back(entry);
+		compiling++;
+		return (Handle)entries.size() - 1;
+	}
+
+	bool poll()
+	{
+		if (compiling == 0)
+			return true;
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			Entry& entry = entries[i];
+			if (entry.ready)
+				continue;
+
+			// Without the extension asking for the status waits for the driver,
+			// so everything is finished on the first poll after submitting
+			GLint done = GL_TRUE;
+			if (parallel)
+				glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &done);
+			if (done)
+				complete(entry);
+		}
+		return compiling == 0;
+	}
+
+	void finish(Handle handle)
 	{
-		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+		for (size_t i = 0; i < entries.size(); i++)
+			if (!entries[i].ready && (handle < 0 || (size_t)handle == i))
+				complete(entries[i]);
 	}
 
-	// Link shaders
-	GLuint shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-	// Check for linking errors
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+	bool isReady(Handle handle)
+	{
+		return handle >= 0 && (size_t)handle < entries.size() && entries[handle].ready;
 	}
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
 
-	return shaderProgram;
-}
\ No newline at end of file
+	GLuint program(Handle handle)
+	{
+		while (handle >= 0 && (size_t)handle < entries.size())
+		{
+			if (entries[handle].ready)
+				return entries[handle].program;
+			handle = entries[handle].fallback;
+		}
+		return 0;
+	}
+
+	double readyMs()
+	{
+		return compiling == 0 && !entries.empty() ? (lastReady - firstSubmit) * 1000.0 : 0.0;
+	}
+
+	bool isParallel()
+	{
+		return parallel;
+	}
+
+	void shutdown()
+	{
+		finish();
+		for (size_t i = 0; i < entries.size(); i++)
+			glDeleteProgram(entries[i].program);
+		entries.clear();
+	}
+
+	void Permutations::init(const char* vertex, const char* fragment, const char* const* featureNames,
+		ProgramSetup programSetup, Handle fallbackHandle, const std::string& sharedDefines)
+	{
+		vertexPath = vertex;
+		fragmentPath = fragment;
+		names = featureNames;
+		setup = programSetup;
+		fallback = fallbackHandle;
+		defines = sharedDefines;
+		variants.clear();
+	}
+
+	Handle Permutations::get(unsigned int features)
+	{
+		std::unordered_map<unsigned int, Handle>::const_iterator found = variants.find(features);
+		if (found != variants.end())
+			return found->second;
+
+		std::string variantDefines = defines;
+		for (unsigned int bit = 0; names && names[bit]; bit++)
+			if (features & (1u << bit))
+				variantDefines += std::string("#define ") + names[bit] + "\n";
+
+		Handle handle = submit(vertexPath.c_str(), fragmentPath.c_str(), setup, fallback, variantDefines);
+		variants[features] = handle;
+		return handle;
+	}
+}
+
+GLuint initShader(const GLchar* vertexPath, const GLchar* fragmentPath){
+
+	shaders::Handle handle = shaders::submit(vertexPath, fragmentPath);
+	shaders::finish(handle);
+	return shaders::program(handle);
+}
@@ -1,11 +1,73 @@
 #ifndef shader_H
 #define shader_H
 
+#include <string>
+#include <unordered_map>
+
 #define GLEW_STATIC
 #include <GL/glew.h>
 
 // This is the content of the .h file, which is where the declarations go
+// Compile and link a program, waiting until it is done
 GLuint initShader(const GLchar* vertexPath, const GLchar* fragmentPath);
 
+// Programs compiled without waiting on them. Everything is submitted up front and
+// polled once a frame; with KHR/ARB_parallel_shader_compile the driver compiles on
+// its own threads and readiness is read without blocking. A program can name a
+// simpler one to stand in for it until it is ready
+namespace shaders
+{
+	typedef int Handle;
+
+	// Called once a program has linked, to set its constant uniforms and bindings
+	typedef void (*ProgramSetup)(GLuint program);
+
+	// Start compiling and linking, the fallback (or -1) is drawn with until then.
+	// defines are inserted into both sources after their #version line
+	Handle submit(const char* vertexPath, const char* fragmentPath, ProgramSetup setup = NULL, Handle fallback = -1,
+		const std::string& defines = "");
+
+	// Pick up the programs that finished, returns true once none is left compiling
+	bool poll();
+	// Wait for one program, or for all of them with -1
+	void finish(Handle handle = -1);
+
+	bool isReady(Handle handle);
+	// The program if it is ready, otherwise its fallback's, 0 if neither is
+	GLuint program(Handle handle);
+
+	// Milliseconds from the first submit until the last program was ready
+	double readyMs();
+	// Whether the driver compiles in parallel
+	bool isParallel();
+
+	void shutdown();
+
+	// Variants of one shader pair specialised at compile time. Each bit of a
+	// feature mask #defines one name, and every mask is compiled once, the first
+	// time it is asked for, and kept
+	class Permutations
+	{
+	public:
+		// names[bit] is defined for that feature bit, the list ends with NULL.
+		// defines go ahead of the feature names in every variant
+		void init(const char* vertexPath, const char* fragmentPath, const char* const* names,
+			ProgramSetup setup = NULL, Handle fallback = -1, const std::string& defines = "");
+
+		// The variant for a feature mask, submitted if this is its first request
+		Handle get(unsigned int features);
+		size_t size() const { return variants.size(); }
+
+	private:
+		std::string vertexPath;
+		std::string fragmentPath;
+		const char* const* names = NULL;
+		ProgramSetup setup = NULL;
+		Handle fallback = -1;
+		std::string defines;
+		std::unordered_map<unsigned int, Handle> variants;
+	};
+}
+
 					   // This is the end of the header guard
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,124 @@
+// Cached point light shadow maps
+
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shadow.h"
+
+bool PointShadow::create(int size, float nearDistance, float farDistance)
+{
+	destroy();
+	faceSize = size;
+	nearPlane = nearDistance;
+	farPlane = farDistance;
+
+	// Compared in the shader with hardware filtering of the 2x2 results, and
+	// filtered across the edges of the faces
+	glGenTextures(2, textures);
+	for (int map = 0; map < 2; map++)
+	{
+		glBindTexture(GL_TEXTURE_CUBE_MAP, textures[map]);
+		for (int face = 0; face < FACES; face++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	}
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, textures[0], 0);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (!complete)
+		std::cout << "ERROR::SHADOW::FRAMEBUFFER_INCOMPLETE" << std::endl;
+
+	// Nothing casts a shadow until it is drawn
+	glClearDepth(1.0);
+	for (int face = 0; face < FACES; face++)
+	{
+		for (int map = 0; map < 2; map++)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, textures[map], 0);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	staticValid = false;
+	redraws = 0;
+	dynamicFaces = 0;
+	return complete;
+}
+
+void PointShadow::destroy()
+{
+	if (framebuffer)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (textures[0])
+		glDeleteTextures(2, textures);
+	framebuffer = 0;
+	textures[0] = textures[1] = 0;
+}
+
+glm::mat4 PointShadow::faceViewProjection(const glm::vec3& light, int face) const
+{
+	// The orientations the cube map lookup expects for each face
+	static const glm::vec3 directions[FACES] = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	static const glm::vec3 ups[FACES] = {
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+	return glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane)
+		* glm::lookAt(light, light + directions[face], ups[face]);
+}
+
+bool PointShadow::claimStaticRedraw(const glm::vec3& light, bool cache)
+{
+	if (cache && staticValid && light == staticLight)
+		return false;
+	staticValid = true;
+	staticLight = light;
+	redraws++;
+	return true;
+}
+
+void PointShadow::beginFace(bool dynamic, int face)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, textures[dynamic ? 1 : 0], 0);
+	glViewport(0, 0, faceSize, faceSize);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	if (dynamic)
+		dynamicFaces |= 1u << face;
+}
+
+void PointShadow::clearStaleFaces(unsigned int faceMask)
+{
+	unsigned int stale = dynamicFaces & ~faceMask;
+	if (!stale)
+		return;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	for (int face = 0; face < FACES; face++)
+	{
+		if (!(stale & (1u << face)))
+			continue;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, textures[1], 0);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+	dynamicFaces &= faceMask;
+}
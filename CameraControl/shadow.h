@@ -0,0 +1,62 @@
+#ifndef SHADOW_H
+#define SHADOW_H
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+// Shadows of a point light in two depth cube maps around it. The static map holds
+// everything that never moves and is only redrawn when the light moves or it is
+// invalidated; the dynamic map is cleared and redrawn every frame with the moving
+// casters, on the faces they reach. The shading pass takes the nearer of the two
+class PointShadow
+{
+public:
+	static const int FACES = 6;
+
+	// Needs a current GL context. size is the side of each face in texels
+	bool create(int size, float nearPlane, float farPlane);
+	void destroy();
+
+	// The light's view of a face, faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+	glm::mat4 faceViewProjection(const glm::vec3& light, int face) const;
+
+	// Whether a frame lit from light has to redraw the static map. The first frame
+	// asked for a light position redraws it and the ones after reuse it, without
+	// caching every frame redraws it
+	bool claimStaticRedraw(const glm::vec3& light, bool cache);
+	// The static casters moved, or their redraw could not be done
+	void invalidate() { staticValid = false; }
+
+	// Bind a face of a map as the render target and clear it, the viewport is set
+	// to the face. The dynamic faces drawn are remembered so they get cleared again
+	void beginFace(bool dynamic, int face);
+	// Clear the dynamic faces drawn last frame that get no casters this frame,
+	// faceMask has a bit per face that does
+	void clearStaleFaces(unsigned int faceMask);
+
+	GLuint staticTexture() const { return textures[0]; }
+	GLuint dynamicTexture() const { return textures[1]; }
+	int size() const { return faceSize; }
+	// Window depth of a point at distance along the major axis of its face is
+	// depthScale() - depthBias() / distance
+	float depthScale() const { return farPlane / (farPlane - nearPlane); }
+	float depthBias() const { return farPlane * nearPlane / (farPlane - nearPlane); }
+	// Times the static map was drawn since create
+	unsigned int staticRedraws() const { return redraws; }
+
+private:
+	GLuint textures[2] = {};
+	GLuint framebuffer = 0;
+	int faceSize = 0;
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+
+	bool staticValid = false;
+	glm::vec3 staticLight;
+	unsigned int redraws = 0;
+	unsigned int dynamicFaces = 0;
+};
+
+#endif
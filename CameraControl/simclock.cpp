@@ -0,0 +1,29 @@
+// Fixed step simulation clock
+
+#include <math.h>
+
+#include "simclock.h"
+
+SimClock::SimClock(double step, int maxSteps)
+	: stepSeconds(step), maxSteps(maxSteps), accumulator(0.0), stepCount(0)
+{
+}
+
+int SimClock::advance(double seconds)
+{
+	if (seconds > 0.0)
+		accumulator += seconds;
+
+	int steps = (int)floor(accumulator / stepSeconds);
+	if (steps > maxSteps)
+	{
+		// Fell behind, carry on from now instead of catching up
+		steps = maxSteps;
+		accumulator = 0.0;
+	}
+	else
+		accumulator -= steps * stepSeconds;
+
+	stepCount += steps;
+	return steps;
+}
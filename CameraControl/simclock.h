@@ -0,0 +1,37 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+// Fixed step simulation clock. Real time is accumulated in double precision and
+// handed out in whole steps, so the simulation runs the same steps whatever the
+// frame rate. Rendering sits between the last two steps, alpha says how far
+class SimClock
+{
+public:
+	// maxSteps bounds the work per frame, time beyond it is dropped so a slow
+	// frame cannot make the next one slower still
+	explicit SimClock(double step = 1.0 / 60.0, int maxSteps = 8);
+
+	// Add elapsed real time, returns the number of steps to simulate now
+	int advance(double seconds);
+
+	double step() const { return stepSeconds; }
+	unsigned long long steps() const { return stepCount; }
+
+	// Simulated time after the last step. Kept as a step count so it never drifts
+	double time() const { return stepCount * stepSeconds; }
+
+	// Fraction of a step the real time is past the last step, [0, 1)
+	double alpha() const { return accumulator / stepSeconds; }
+
+	// Time to render, interpolated between the last two steps. There is nothing
+	// to interpolate from before the first step
+	double renderTime() const { return stepCount == 0 ? 0.0 : time() - stepSeconds + accumulator; }
+
+private:
+	double stepSeconds;
+	int maxSteps;
+	double accumulator;
+	unsigned long long stepCount;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#version 330 core
+out vec3 color;
+
+in vec3 FragPos;  
+in vec3 Normal;  
+in vec2 UV;
+
+uniform vec3 lightPos; 
+uniform vec3 lightColor;
+
+uniform sampler2D texture1;
+
+// Ambient and diffuse from the main light only, drawn with while frag.glsl compiles
+void main()
+{
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(lightPos - FragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    color = (0.1f + diff) * lightColor * texture(texture1, UV).rgb;
+} 
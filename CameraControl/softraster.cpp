@@ -0,0 +1,539 @@
+// Tile based software rasterizer, see softraster.h
+
+#include <algorithm>
+#include <math.h>
+
+#include "dds.h"
+#include "parallel.h"
+#include "softraster.h"
+
+#ifdef SOFTRASTER_SSE
+#include <emmintrin.h>
+#endif
+
+static const int BLOCKS_PER_ROW = SoftRasterizer::TILE_SIZE / SoftRasterizer::BLOCK_SIZE;
+static const int TILE_PIXELS = SoftRasterizer::TILE_SIZE * SoftRasterizer::TILE_SIZE;
+static const int TILE_BLOCKS = BLOCKS_PER_ROW * BLOCKS_PER_ROW;
+
+// Window positions are snapped to 1/256 pixel so neighbouring triangles agree exactly
+static const float SUBPIXEL_STEPS = 256.0f;
+
+bool loadSoftTexture(const char* path, SoftTexture& texture)
+{
+	DDSImage image;
+	if (!readDDS(path, image) || !decodeDDS(image, texture.rgba))
+		return false;
+	texture.width = image.width;
+	texture.height = image.height;
+	return true;
+}
+
+// Bilinear lookup with repeat, texel centres at half texel coordinates as in GL
+static glm::vec3 sample(const SoftTexture& texture, float u, float v)
+{
+	float x = u * texture.width - 0.5f;
+	float y = v * texture.height - 0.5f;
+	float fx = floorf(x), fy = floorf(y);
+	float tx = x - fx, ty = y - fy;
+
+	int w = (int)texture.width, h = (int)texture.height;
+	int x0 = (int)fx % w, y0 = (int)fy % h;
+	if (x0 < 0)
+		x0 += w;
+	if (y0 < 0)
+		y0 += h;
+	int x1 = x0 + 1 == w ? 0 : x0 + 1;
+	int y1 = y0 + 1 == h ? 0 : y0 + 1;
+
+	const unsigned char* row0 = &texture.rgba[(size_t)y0 * w * 4];
+	const unsigned char* row1 = &texture.rgba[(size_t)y1 * w * 4];
+	glm::vec3 result;
+	for (int i = 0; i < 3; i++)
+	{
+		float top = row0[x0 * 4 + i] + (row0[x1 * 4 + i] - row0[x0 * 4 + i]) * tx;
+		float bottom = row1[x0 * 4 + i] + (row1[x1 * 4 + i] - row1[x0 * 4 + i]) * tx;
+		(&result.x)[i] = (top + (bottom - top) * ty) * (1.0f / 255.0f);
+	}
+	return result;
+}
+
+static inline float plane(const float* p, float x, float y)
+{
+	return p[0] * x + p[1] * y + p[2];
+}
+
+void SoftRasterizer::resize(unsigned int width, unsigned int height)
+{
+	frameWidth = width;
+	frameHeight = height;
+	tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	size_t tiles = (size_t)tilesX * tilesY;
+	depths.resize(tiles * TILE_PIXELS);
+	nearestTriangles.resize(tiles * TILE_PIXELS);
+	blockFarthest.resize(tiles * TILE_BLOCKS);
+	colors.assign((size_t)width * height * 4, 255);
+}
+
+void SoftRasterizer::setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position)
+{
+	viewProjection = projection * view;
+	cameraPosition = position;
+}
+
+void SoftRasterizer::setLight(const glm::vec3& position, const glm::vec3& color)
+{
+	lightPosition = position;
+	lightColor = color;
+}
+
+void SoftRasterizer::draw(const SoftMesh& mesh, const glm::mat4& model, const SoftMaterial& material)
+{
+	Draw draw;
+	draw.mesh = &mesh;
+	draw.model = model;
+	draw.normalMatrix = glm::mat3(glm::transpose(glm::inverse(model)));
+	draw.material = &material;
+	draw.firstVertex = vertexCount;
+	draw.firstTriangle = triangleCount;
+	draws.push_back(draw);
+
+	vertexCount += mesh.vertices.size() / 9;
+	triangleCount += mesh.indices.size() / 3;
+}
+
+size_t SoftRasterizer::triangles() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < batchesUsed; i++)
+		count += batches[i].triangles.size();
+	return count;
+}
+
+void SoftRasterizer::render(unsigned int threads)
+{
+	if (threads == 0)
+		threads = parallelThreadCount();
+
+	// Vertices of every draw, then the triangles in batches of a fixed size so
+	// the tile lists come out in the same order on any number of threads
+	vertices.resize(vertexCount);
+	parallelFor(vertexCount, 1024, [this](size_t begin, size_t end)
+	{
+		transformVertices(begin, end);
+	}, threads);
+
+	batchesUsed = (triangleCount + BATCH_TRIANGLES - 1) / BATCH_TRIANGLES;
+	if (batches.size() < batchesUsed)
+		batches.resize(batchesUsed);
+	parallelFor(batchesUsed, 1, [this](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			setUpBatch(i);
+	}, threads);
+
+	// Tiles differ a lot in cost, so each job takes the next tile nobody has started
+	unsigned int tileCount = tilesX * tilesY;
+	nextTile = 0;
+	parallelFor(std::min(threads, tileCount), 1, [this, tileCount](size_t, size_t)
+	{
+		for (unsigned int tile = nextTile++; tile < tileCount; tile = nextTile++)
+			rasterTile(tile);
+	}, threads);
+
+	draws.clear();
+	vertexCount = 0;
+	triangleCount = 0;
+}
+
+void SoftRasterizer::transformVertices(size_t begin, size_t end)
+{
+	// The draw holding the first vertex, the rest follow in order
+	size_t drawIndex = 0;
+	while (drawIndex + 1 < draws.size() && draws[drawIndex + 1].firstVertex <= begin)
+		drawIndex++;
+
+	for (size_t i = begin; i < end; i++)
+	{
+		while (drawIndex + 1 < draws.size() && draws[drawIndex + 1].firstVertex <= i)
+			drawIndex++;
+		const Draw& draw = draws[drawIndex];
+		const float* source = &draw.mesh->vertices[(i - draw.firstVertex) * 9];
+
+		glm::vec4 world = draw.model * glm::vec4(source[0], source[1], source[2], 1.0f);
+		glm::vec3 normal = draw.normalMatrix * glm::vec3(source[3], source[4], source[5]);
+		Vertex& vertex = vertices[i];
+		vertex.clip = viewProjection * world;
+		vertex.attributes[0] = world.x;
+		vertex.attributes[1] = world.y;
+		vertex.attributes[2] = world.z;
+		vertex.attributes[3] = normal.x;
+		vertex.attributes[4] = normal.y;
+		vertex.attributes[5] = normal.z;
+		vertex.attributes[6] = source[6];
+		vertex.attributes[7] = source[7];
+	}
+}
+
+void SoftRasterizer::setUpBatch(size_t index)
+{
+	Batch& batch = batches[index];
+	batch.triangles.clear();
+	batch.bins.resize((size_t)tilesX * tilesY);
+	for (size_t i = 0; i < batch.bins.size(); i++)
+		batch.bins[i].clear();
+
+	size_t begin = index * BATCH_TRIANGLES;
+	size_t end = std::min(triangleCount, begin + BATCH_TRIANGLES);
+	size_t drawIndex = 0;
+	for (size_t i = begin; i < end; i++)
+	{
+		while (drawIndex + 1 < draws.size() && draws[drawIndex + 1].firstTriangle <= i)
+			drawIndex++;
+		const Draw& draw = draws[drawIndex];
+		const unsigned int* indices = &draw.mesh->indices[(i - draw.firstTriangle) * 3];
+
+		const Vertex* corners[3];
+		for (int k = 0; k < 3; k++)
+			corners[k] = &vertices[draw.firstVertex + indices[k]];
+		clipAndSetUp(corners, draw.material, batch);
+	}
+}
+
+// Distance of a clip space position inside one of the frustum planes, negative outside
+static inline float planeDistance(const glm::vec4& p, int plane)
+{
+	switch (plane)
+	{
+	case 0: return p.w + p.z;
+	case 1: return p.w - p.z;
+	case 2: return p.w + p.x;
+	case 3: return p.w - p.x;
+	case 4: return p.w + p.y;
+	default: return p.w - p.y;
+	}
+}
+
+void SoftRasterizer::clipAndSetUp(const Vertex* corners[3], const SoftMaterial* material, Batch& batch)
+{
+	// Most triangles are entirely in or out of the frustum
+	unsigned int outsideAll = 0x3F, outsideAny = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		unsigned int outside = 0;
+		for (int p = 0; p < 6; p++)
+			if (planeDistance(corners[k]->clip, p) < 0.0f)
+				outside |= 1u << p;
+		outsideAll &= outside;
+		outsideAny |= outside;
+	}
+	if (outsideAll)
+		return;
+	if (!outsideAny)
+	{
+		setUpTriangle(*corners[0], *corners[1], *corners[2], material, batch);
+		return;
+	}
+
+	// Cut the polygon by each plane it crosses, three corners gain at most one per plane
+	Vertex polygons[2][9];
+	int count = 3;
+	for (int k = 0; k < 3; k++)
+		polygons[0][k] = *corners[k];
+	int current = 0;
+	for (int p = 0; p < 6 && count > 0; p++)
+	{
+		if (!(outsideAny & (1u << p)))
+			continue;
+		const Vertex* in = polygons[current];
+		Vertex* out = polygons[current ^ 1];
+		int outCount = 0;
+		for (int k = 0; k < count; k++)
+		{
+			const Vertex& a = in[k];
+			const Vertex& b = in[(k + 1) % count];
+			float da = planeDistance(a.clip, p);
+			float db = planeDistance(b.clip, p);
+			if (da >= 0.0f)
+				out[outCount++] = a;
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				float t = da / (da - db);
+				Vertex& cut = out[outCount++];
+				cut.clip = a.clip + (b.clip - a.clip) * t;
+				for (int i = 0; i < 8; i++)
+					cut.attributes[i] = a.attributes[i] + (b.attributes[i] - a.attributes[i]) * t;
+			}
+		}
+		count = outCount;
+		current ^= 1;
+	}
+
+	for (int k = 2; k < count; k++)
+		setUpTriangle(polygons[current][0], polygons[current][k - 1], polygons[current][k], material, batch);
+}
+
+void SoftRasterizer::setUpTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const SoftMaterial* material, Batch& batch)
+{
+	// Window coordinates with y up like GL, depth in [0, 1]
+	const Vertex* corners[3] = { &v0, &v1, &v2 };
+	float x[3], y[3], z[3], inverseW[3];
+	for (int k = 0; k < 3; k++)
+	{
+		const glm::vec4& clip = corners[k]->clip;
+		inverseW[k] = 1.0f / clip.w;
+		x[k] = floorf((clip.x * inverseW[k] * 0.5f + 0.5f) * frameWidth * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+		y[k] = floorf((clip.y * inverseW[k] * 0.5f + 0.5f) * frameHeight * SUBPIXEL_STEPS + 0.5f) / SUBPIXEL_STEPS;
+		z[k] = clip.z * inverseW[k] * 0.5f + 0.5f;
+	}
+
+	float dx1 = x[1] - x[0], dy1 = y[1] - y[0];
+	float dx2 = x[2] - x[0], dy2 = y[2] - y[0];
+	float area = dx1 * dy2 - dx2 * dy1;
+	if (area == 0.0f)
+		return;
+
+	// Pixels whose centre can be inside
+	Triangle triangle;
+	triangle.minX = std::max(0, (int)ceilf(std::min(x[0], std::min(x[1], x[2])) - 0.5f));
+	triangle.minY = std::max(0, (int)ceilf(std::min(y[0], std::min(y[1], y[2])) - 0.5f));
+	triangle.maxX = std::min((int)frameWidth - 1, (int)floorf(std::max(x[0], std::max(x[1], x[2])) - 0.5f));
+	triangle.maxY = std::min((int)frameHeight - 1, (int)floorf(std::max(y[0], std::max(y[1], y[2])) - 0.5f));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	// Edge k runs between the other two corners and is positive on the side of
+	// corner k. A shared edge gets exactly opposite functions in its two
+	// triangles, so a pixel centre on it goes to the one where it is a left or top edge
+	float orientation = area > 0.0f ? 1.0f : -1.0f;
+	for (int k = 0; k < 3; k++)
+	{
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		float* edge = triangle.edges[k];
+		edge[0] = (y[a] - y[b]) * orientation;
+		edge[1] = (x[b] - x[a]) * orientation;
+		edge[2] = (x[a] * y[b] - x[b] * y[a]) * orientation;
+		triangle.includeEdge[k] = edge[0] > 0.0f || (edge[0] == 0.0f && edge[1] > 0.0f);
+	}
+
+	auto setPlane = [&](float* p, float v0, float v1, float v2)
+	{
+		p[0] = ((v1 - v0) * dy2 - (v2 - v0) * dy1) / area;
+		p[1] = ((v2 - v0) * dx1 - (v1 - v0) * dx2) / area;
+		p[2] = v0 - p[0] * x[0] - p[1] * y[0];
+	};
+	setPlane(triangle.depth, z[0], z[1], z[2]);
+	setPlane(triangle.inverseW, inverseW[0], inverseW[1], inverseW[2]);
+	for (int i = 0; i < 8; i++)
+		setPlane(triangle.attributes[i], v0.attributes[i] * inverseW[0], v1.attributes[i] * inverseW[1], v2.attributes[i] * inverseW[2]);
+	triangle.nearest = std::min(z[0], std::min(z[1], z[2]));
+	triangle.material = material;
+
+	// Add it to every tile its bounds touch unless an edge leaves the whole tile outside
+	unsigned int index = (unsigned int)batch.triangles.size();
+	batch.triangles.push_back(triangle);
+	int firstTileX = triangle.minX / TILE_SIZE, lastTileX = triangle.maxX / TILE_SIZE;
+	int firstTileY = triangle.minY / TILE_SIZE, lastTileY = triangle.maxY / TILE_SIZE;
+	for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+	{
+		for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
+		{
+			bool touches = true;
+			if (firstTileX != lastTileX || firstTileY != lastTileY)
+			{
+				float left = tileX * TILE_SIZE + 0.5f, right = left + TILE_SIZE - 1.0f;
+				float bottom = tileY * TILE_SIZE + 0.5f, top = bottom + TILE_SIZE - 1.0f;
+				for (int k = 0; k < 3 && touches; k++)
+				{
+					const float* edge = triangle.edges[k];
+					touches = plane(edge, edge[0] > 0.0f ? right : left, edge[1] > 0.0f ? top : bottom) >= 0.0f;
+				}
+			}
+			if (touches)
+				batch.bins[tileY * tilesX + tileX].push_back(index);
+		}
+	}
+}
+
+void SoftRasterizer::rasterTile(unsigned int tile)
+{
+	int tileX = (int)(tile % tilesX) * TILE_SIZE;
+	int tileY = (int)(tile / tilesX) * TILE_SIZE;
+	float* depth = &depths[(size_t)tile * TILE_PIXELS];
+	const Triangle** nearest = &nearestTriangles[(size_t)tile * TILE_PIXELS];
+	float* farthest = &blockFarthest[(size_t)tile * TILE_BLOCKS];
+	std::fill(depth, depth + TILE_PIXELS, 1.0f);
+	std::fill(nearest, nearest + TILE_PIXELS, (const Triangle*)NULL);
+	std::fill(farthest, farthest + TILE_BLOCKS, 1.0f);
+
+	for (size_t b = 0; b < batchesUsed; b++)
+	{
+		const Batch& batch = batches[b];
+		const std::vector<unsigned int>& bin = batch.bins[tile];
+		for (size_t i = 0; i < bin.size(); i++)
+			rasterTriangle(batch.triangles[bin[i]], tileX, tileY, depth, nearest, farthest);
+	}
+
+	shadeTile(tileX, tileY, nearest);
+}
+
+void SoftRasterizer::rasterTriangle(const Triangle& triangle, int tileX, int tileY, float* depth, const Triangle** nearest, float* farthest)
+{
+	int minX = std::max(triangle.minX, tileX) - tileX;
+	int minY = std::max(triangle.minY, tileY) - tileY;
+	int maxX = std::min(triangle.maxX, tileX + TILE_SIZE - 1) - tileX;
+	int maxY = std::min(triangle.maxY, tileY + TILE_SIZE - 1) - tileY;
+	if (minX > maxX || minY > maxY)
+		return;
+
+#ifdef SOFTRASTER_SSE
+	__m128 edgeA[3], edgeB[3], edgeC[3], include[3];
+	for (int k = 0; k < 3; k++)
+	{
+		edgeA[k] = _mm_set1_ps(triangle.edges[k][0]);
+		edgeB[k] = _mm_set1_ps(triangle.edges[k][1]);
+		edgeC[k] = _mm_set1_ps(triangle.edges[k][2]);
+		include[k] = _mm_castsi128_ps(_mm_set1_epi32(triangle.includeEdge[k] ? -1 : 0));
+	}
+	__m128 depthA = _mm_set1_ps(triangle.depth[0]);
+	__m128 depthB = _mm_set1_ps(triangle.depth[1]);
+	__m128 depthC = _mm_set1_ps(triangle.depth[2]);
+	__m128 zero = _mm_setzero_ps();
+	__m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+#endif
+
+	for (int blockY = minY / BLOCK_SIZE; blockY <= maxY / BLOCK_SIZE; blockY++)
+	{
+		for (int blockX = minX / BLOCK_SIZE; blockX <= maxX / BLOCK_SIZE; blockX++)
+		{
+			// Everything already drawn in the block is nearer
+			int block = blockY * BLOCKS_PER_ROW + blockX;
+			if (triangle.nearest >= farthest[block])
+				continue;
+
+			// Or the block is entirely outside one of the edges
+			float left = (float)(tileX + blockX * BLOCK_SIZE) + 0.5f, right = left + BLOCK_SIZE - 1.0f;
+			float bottom = (float)(tileY + blockY * BLOCK_SIZE) + 0.5f, top = bottom + BLOCK_SIZE - 1.0f;
+			bool outside = false;
+			for (int k = 0; k < 3 && !outside; k++)
+			{
+				const float* edge = triangle.edges[k];
+				outside = plane(edge, edge[0] > 0.0f ? right : left, edge[1] > 0.0f ? top : bottom) < 0.0f;
+			}
+			if (outside)
+				continue;
+
+			bool written = false;
+			int firstRow = std::max(minY, blockY * BLOCK_SIZE), lastRow = std::min(maxY, blockY * BLOCK_SIZE + BLOCK_SIZE - 1);
+			for (int row = firstRow; row <= lastRow; row++)
+			{
+				float y = (float)(tileY + row) + 0.5f;
+				for (int column = blockX * BLOCK_SIZE; column < blockX * BLOCK_SIZE + BLOCK_SIZE; column += 4)
+				{
+					int pixel = row * TILE_SIZE + column;
+#ifdef SOFTRASTER_SSE
+					__m128 xs = _mm_add_ps(_mm_set1_ps((float)(tileX + column)), laneOffsets);
+					__m128 ys = _mm_set1_ps(y);
+					__m128 covered = _mm_castsi128_ps(_mm_set1_epi32(-1));
+					for (int k = 0; k < 3; k++)
+					{
+						__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[k], xs), _mm_mul_ps(edgeB[k], ys)), edgeC[k]);
+						__m128 inside = _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(_mm_cmpeq_ps(e, zero), include[k]));
+						covered = _mm_and_ps(covered, inside);
+					}
+					__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(depthA, xs), _mm_mul_ps(depthB, ys)), depthC);
+					__m128 stored = _mm_loadu_ps(depth + pixel);
+					__m128 pass = _mm_and_ps(covered, _mm_cmplt_ps(z, stored));
+					int mask = _mm_movemask_ps(pass);
+					if (!mask)
+						continue;
+					_mm_storeu_ps(depth + pixel, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, stored)));
+					for (int lane = 0; lane < 4; lane++)
+						if (mask & (1 << lane))
+							nearest[pixel + lane] = &triangle;
+					written = true;
+#else
+					for (int lane = 0; lane < 4; lane++)
+					{
+						float x = (float)(tileX + column + lane) + 0.5f;
+						bool covered = true;
+						for (int k = 0; k < 3 && covered; k++)
+						{
+							float e = plane(triangle.edges[k], x, y);
+							covered = e > 0.0f || (e == 0.0f && triangle.includeEdge[k]);
+						}
+						float z = plane(triangle.depth, x, y);
+						if (covered && z < depth[pixel + lane])
+						{
+							depth[pixel + lane] = z;
+							nearest[pixel + lane] = &triangle;
+							written = true;
+						}
+					}
+#endif
+				}
+			}
+
+			if (written)
+			{
+				float blockMax = 0.0f;
+				for (int row = 0; row < BLOCK_SIZE; row++)
+				{
+					const float* line = depth + (blockY * BLOCK_SIZE + row) * TILE_SIZE + blockX * BLOCK_SIZE;
+					for (int column = 0; column < BLOCK_SIZE; column++)
+						blockMax = std::max(blockMax, line[column]);
+				}
+				farthest[block] = blockMax;
+			}
+		}
+	}
+}
+
+void SoftRasterizer::shadeTile(int tileX, int tileY, const Triangle* const* nearest)
+{
+	int width = std::min(TILE_SIZE, (int)frameWidth - tileX);
+	int height = std::min(TILE_SIZE, (int)frameHeight - tileY);
+	for (int row = 0; row < height; row++)
+	{
+		// Rows are stored top first
+		unsigned char* out = &colors[((size_t)(frameHeight - 1 - (tileY + row)) * frameWidth + tileX) * 4];
+		for (int column = 0; column < width; column++, out += 4)
+		{
+			const Triangle* triangle = nearest[row * TILE_SIZE + column];
+			glm::vec3 color = triangle ? shade(*triangle, tileX + column + 0.5f, tileY + row + 0.5f) : clearColor;
+			out[0] = (unsigned char)(glm::clamp(color.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+			out[1] = (unsigned char)(glm::clamp(color.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+			out[2] = (unsigned char)(glm::clamp(color.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+			out[3] = 255;
+		}
+	}
+}
+
+// The lighting of frag.glsl for the main light, with a white specular map
+glm::vec3 SoftRasterizer::shade(const Triangle& triangle, float x, float y) const
+{
+	float w = 1.0f / plane(triangle.inverseW, x, y);
+	float values[8];
+	for (int i = 0; i < 8; i++)
+		values[i] = plane(triangle.attributes[i], x, y) * w;
+	glm::vec3 position(values[0], values[1], values[2]);
+	glm::vec3 norm = glm::normalize(glm::vec3(values[3], values[4], values[5]));
+
+	glm::vec3 ambient = 0.1f * lightColor;
+	glm::vec3 lightDir = glm::normalize(lightPosition - position);
+	float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+	glm::vec3 light = ambient + diff * lightColor;
+
+	const SoftMaterial& material = *triangle.material;
+	if (material.specularColor != glm::vec3(0.0f))
+	{
+		glm::vec3 viewDir = glm::normalize(cameraPosition - position);
+		glm::vec3 reflectDir = 2.0f * glm::dot(norm, lightDir) * norm - lightDir;
+		float spec = powf(std::max(glm::dot(viewDir, reflectDir), 0.0f), material.shininess);
+		light += material.specularColor * spec * lightColor;
+	}
+
+	glm::vec3 texel = material.diffuse ? sample(*material.diffuse, values[6], values[7]) : glm::vec3(1.0f);
+	return light * texel;
+}
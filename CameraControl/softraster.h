@@ -0,0 +1,153 @@
+#ifndef SOFTRASTER_H
+#define SOFTRASTER_H
+
+#include <atomic>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Coverage and depth are tested four pixels at a time with SSE2 on x86 builds,
+// one at a time otherwise. Define SOFTRASTER_NO_SIMD to force the scalar path
+#if !defined(SOFTRASTER_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SOFTRASTER_SSE
+#endif
+
+// An 8 bit RGBA texture, rows in file order like the GL upload so the same
+// texture coordinates apply
+struct SoftTexture
+{
+	unsigned int width = 0;
+	unsigned int height = 0;
+	std::vector<unsigned char> rgba;
+};
+
+// Read and decompress the top level of a DDS file, false if it is missing or unsupported
+bool loadSoftTexture(const char* path, SoftTexture& texture);
+
+// Vertices in the loadVertices layout: position (3), normal (3), texture coordinate (2), padding (1)
+struct SoftMesh
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+};
+
+// The material inputs of frag.glsl, no diffuse texture draws white
+struct SoftMaterial
+{
+	const SoftTexture* diffuse = NULL;
+	glm::vec3 specularColor = glm::vec3(0.0f);
+	float shininess = 32.0f;
+};
+
+// Draws meshes on the CPU with the lighting of frag.glsl, for machines without
+// a GPU. Triangles are clipped and set up in fixed size batches, and each batch
+// sorts its triangles into the screen tiles they touch. Every tile is then one
+// job: edge functions find the covered pixels, whole blocks are skipped when the
+// triangle is behind the farthest depth in them, and once every triangle is in
+// only the nearest one of each pixel is shaded. The image does not depend on the
+// number of threads
+class SoftRasterizer
+{
+public:
+	static const int TILE_SIZE = 64;
+	static const int BLOCK_SIZE = 8;
+	static const int BATCH_TRIANGLES = 2048;
+
+	void resize(unsigned int width, unsigned int height);
+	unsigned int width() const { return frameWidth; }
+	unsigned int height() const { return frameHeight; }
+
+	void setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& position);
+	void setLight(const glm::vec3& position, const glm::vec3& color);
+	void setClearColor(const glm::vec3& color) { clearColor = color; }
+
+	// Queue a mesh for the next render, the mesh and material have to stay alive until then
+	void draw(const SoftMesh& mesh, const glm::mat4& model, const SoftMaterial& material);
+
+	// Draw and then forget the queued meshes, threads = 0 uses every scheduler thread
+	void render(unsigned int threads = 0);
+
+	// The last image as 8 bit RGBA, top row first
+	const std::vector<unsigned char>& pixels() const { return colors; }
+
+	// Triangles left to rasterize after clipping in the last render
+	size_t triangles() const;
+
+private:
+	struct Draw
+	{
+		const SoftMesh* mesh;
+		glm::mat4 model;
+		glm::mat3 normalMatrix;
+		const SoftMaterial* material;
+		size_t firstVertex;
+		size_t firstTriangle;
+	};
+
+	// A vertex in clip space with the values interpolated across triangles:
+	// world position (3), normal (3), texture coordinate (2)
+	struct Vertex
+	{
+		glm::vec4 clip;
+		float attributes[8];
+	};
+
+	// Everything rasterizing and shading needs, as planes a * x + b * y + c over
+	// the window. Attributes are divided by w so they interpolate in perspective
+	struct Triangle
+	{
+		float edges[3][3];
+		bool includeEdge[3];
+		float depth[3];
+		float inverseW[3];
+		float attributes[8][3];
+		float nearest;
+		int minX, minY, maxX, maxY;
+		const SoftMaterial* material;
+	};
+
+	// Triangles set up by one job, with the ones touching each tile in submission order
+	struct Batch
+	{
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<unsigned int> > bins;
+	};
+
+	void transformVertices(size_t begin, size_t end);
+	void setUpBatch(size_t batch);
+	void clipAndSetUp(const Vertex* corners[3], const SoftMaterial* material, Batch& batch);
+	void setUpTriangle(const Vertex& v0, const Vertex& v1, const Vertex& v2, const SoftMaterial* material, Batch& batch);
+	void rasterTile(unsigned int tile);
+	void rasterTriangle(const Triangle& triangle, int tileX, int tileY, float* depth, const Triangle** nearest, float* farthest);
+	void shadeTile(int tileX, int tileY, const Triangle* const* nearest);
+	glm::vec3 shade(const Triangle& triangle, float x, float y) const;
+
+	unsigned int frameWidth = 0;
+	unsigned int frameHeight = 0;
+	unsigned int tilesX = 0;
+	unsigned int tilesY = 0;
+
+	glm::mat4 viewProjection;
+	glm::vec3 cameraPosition;
+	glm::vec3 lightPosition;
+	glm::vec3 lightColor = glm::vec3(1.0f);
+	glm::vec3 clearColor;
+
+	std::vector<Draw> draws;
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	std::vector<Vertex> vertices;
+	std::vector<Batch> batches;
+	size_t batchesUsed = 0;
+
+	// Per tile, TILE_SIZE squared pixels each: depth, the nearest triangle, and
+	// the farthest depth of every block
+	std::vector<float> depths;
+	std::vector<const Triangle*> nearestTriangles;
+	std::vector<float> blockFarthest;
+	std::vector<unsigned char> colors;
+
+	std::atomic<unsigned int> nextTile;
+};
+
+#endif
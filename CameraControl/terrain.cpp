@@ -0,0 +1,284 @@
+// Geomipmapped heightmap terrain
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+
+#include "terrain.h"
+#include "parallel.h"
+
+// Value in [-1, 1] at an integer lattice point
+static float lattice(int x, int z, uint32_t seed)
+{
+	uint32_t h = (uint32_t)x * 374761393u + (uint32_t)z * 668265263u + seed * 2246822519u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	h ^= h >> 16;
+	return (h & 0xFFFFFF) * (2.0f / 16777215.0f) - 1.0f;
+}
+
+// Lattice values blended with a smoothstep, in [-1, 1]
+static float valueNoise(float x, float z, uint32_t seed)
+{
+	float fx = floorf(x), fz = floorf(z);
+	int ix = (int)fx, iz = (int)fz;
+	float tx = x - fx, tz = z - fz;
+	tx = tx * tx * (3.0f - 2.0f * tx);
+	tz = tz * tz * (3.0f - 2.0f * tz);
+
+	float a = lattice(ix, iz, seed), b = lattice(ix + 1, iz, seed);
+	float c = lattice(ix, iz + 1, seed), d = lattice(ix + 1, iz + 1, seed);
+	return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * tz;
+}
+
+float Terrain::height(float x, float z) const
+{
+	float radius = sqrtf(x * x + z * z);
+	float t = settings.flatBlend > 0.0f ? (radius - settings.flatRadius) / settings.flatBlend : (radius > settings.flatRadius ? 1.0f : 0.0f);
+	t = std::min(1.0f, std::max(0.0f, t));
+	if (t == 0.0f)
+		return 0.0f;
+	t = t * t * (3.0f - 2.0f * t);
+
+	// Four octaves, each twice the frequency and half the height of the one before
+	float sum = 0.0f, amplitude = 0.5f, frequency = 1.0f / settings.hillSize;
+	for (uint32_t octave = 0; octave < 4; octave++)
+	{
+		sum += valueNoise(x * frequency, z * frequency, settings.seed + octave) * amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+	}
+	return settings.hillHeight * t * sum / 0.9375f;
+}
+
+void Terrain::generate(const TerrainSettings& terrainSettings, unsigned int threads)
+{
+	settings = terrainSettings;
+	unsigned int quads = std::max(1u, settings.chunkQuads);
+	while (quads & (quads - 1))
+		quads &= quads - 1;
+	settings.chunkQuads = quads;
+	for (levelCount = 1; (1u << (levelCount - 1)) < quads; levelCount++)
+		;
+
+	chunksPerSide = std::max(1u, (unsigned int)(settings.size / settings.chunkSize + 0.5f));
+	chunkVertexCount = (quads + 1) * (quads + 1);
+	chunks.resize(chunksPerSide * chunksPerSide);
+	chunkVertices.resize(chunks.size() * chunkVertexCount * 9);
+
+	// Positions come from the global grid index, so the edges two chunks share
+	// get exactly the same vertices
+	const float spacing = settings.chunkSize / quads;
+	const float origin = -0.5f * chunksPerSide * settings.chunkSize;
+	parallelFor(chunks.size(), 4, [this, quads, spacing, origin](size_t begin, size_t end)
+	{
+		for (size_t c = begin; c < end; c++)
+		{
+			unsigned int cx = (unsigned int)(c % chunksPerSide), cz = (unsigned int)(c / chunksPerSide);
+			float* vertex = &chunkVertices[c * chunkVertexCount * 9];
+			Chunk& chunk = chunks[c];
+			chunk.low = glm::vec3(origin + cx * quads * spacing, INFINITY, origin + cz * quads * spacing);
+			chunk.high = glm::vec3(origin + (cx + 1) * quads * spacing, -INFINITY, origin + (cz + 1) * quads * spacing);
+
+			for (unsigned int j = 0; j <= quads; j++)
+			{
+				for (unsigned int i = 0; i <= quads; i++, vertex += 9)
+				{
+					float x = origin + (cx * quads + i) * spacing;
+					float z = origin + (cz * quads + j) * spacing;
+					float y = height(x, z);
+					glm::vec3 normal = glm::normalize(glm::vec3(height(x - spacing, z) - height(x + spacing, z),
+						2.0f * spacing, height(x, z - spacing) - height(x, z + spacing)));
+
+					vertex[0] = x;
+					vertex[1] = y;
+					vertex[2] = z;
+					vertex[3] = normal.x;
+					vertex[4] = normal.y;
+					vertex[5] = normal.z;
+					vertex[6] = x / settings.textureSize;
+					vertex[7] = z / settings.textureSize;
+					vertex[8] = 0.0f;
+					chunk.low.y = std::min(chunk.low.y, y);
+					chunk.high.y = std::max(chunk.high.y, y);
+				}
+			}
+		}
+	}, threads);
+
+	low = chunks[0].low;
+	high = chunks[0].high;
+	for (size_t c = 1; c < chunks.size(); c++)
+	{
+		low = glm::min(low, chunks[c].low);
+		high = glm::max(high, chunks[c].high);
+	}
+
+	buildPatterns();
+}
+
+// Triangles of every level and edge mask. At level L a chunk is drawn with every
+// 2^L vertex. A stitched edge moves its odd vertices onto the even ones before
+// them, which leaves the edge the coarser neighbour draws, and drops the triangles
+// that collapse
+void Terrain::buildPatterns()
+{
+	const unsigned int quads = settings.chunkQuads;
+	patterns.resize(levelCount * EDGE_MASKS);
+	patternIndices.clear();
+
+	for (unsigned int level = 0; level < levelCount; level++)
+	{
+		const unsigned int step = 1u << level;
+		const unsigned int cells = quads / step;
+		for (unsigned int mask = 0; mask < EDGE_MASKS; mask++)
+		{
+			Pattern& pattern = patterns[level * EDGE_MASKS + mask];
+			if (level == levelCount - 1 && mask != 0)
+			{
+				pattern = patterns[level * EDGE_MASKS];
+				continue;
+			}
+
+			auto vertex = [quads, step, cells, mask](unsigned int a, unsigned int b)
+			{
+				if ((a & 1) && ((b == 0 && (mask & EDGE_NEAR_Z)) || (b == cells && (mask & EDGE_FAR_Z))))
+					a--;
+				if ((b & 1) && ((a == 0 && (mask & EDGE_NEAR_X)) || (a == cells && (mask & EDGE_FAR_X))))
+					b--;
+				return b * step * (quads + 1) + a * step;
+			};
+
+			pattern.offset = (unsigned int)patternIndices.size();
+			for (unsigned int b = 0; b < cells; b++)
+			{
+				for (unsigned int a = 0; a < cells; a++)
+				{
+					// Counter clockwise seen from above
+					unsigned int triangles[2][3] = {
+						{ vertex(a, b), vertex(a, b + 1), vertex(a + 1, b) },
+						{ vertex(a + 1, b), vertex(a, b + 1), vertex(a + 1, b + 1) }
+					};
+					for (int t = 0; t < 2; t++)
+					{
+						const unsigned int* v = triangles[t];
+						if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+							continue;
+						patternIndices.insert(patternIndices.end(), v, v + 3);
+					}
+				}
+			}
+			pattern.count = (unsigned int)patternIndices.size() - pattern.offset;
+		}
+	}
+}
+
+void Terrain::select(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPos,
+	MeshletDrawList& out) const
+{
+	out.counts.clear();
+	out.offsets.clear();
+	out.baseVertices.clear();
+	out.visibleMeshlets = 0;
+	out.visibleTriangles = 0;
+	out.frustumCulled = 0;
+	out.coneCulled = 0;
+	if (chunks.empty())
+		return;
+
+	// Object space clip planes as the meshlet culling takes them
+	glm::mat4 mvp = viewProjection * model;
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+		rows[i] = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2]
+	};
+
+	glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+	float scale = glm::length(glm::vec3(model[0]));
+
+	// The level every chunk wants from its distance, the culled ones too since
+	// their levels decide how the visible ones next to them are stitched
+	const unsigned char top = (unsigned char)(levelCount - 1);
+	std::vector<unsigned char> chunkLevels(chunks.size());
+	for (size_t c = 0; c < chunks.size(); c++)
+	{
+		const Chunk& chunk = chunks[c];
+		float distance = glm::length(localCamera - glm::clamp(localCamera, chunk.low, chunk.high)) * scale;
+		unsigned char level = 0;
+		if (distance >= settings.lodDistance)
+			level = (unsigned char)std::min<float>(top, 1.0f + floorf(log2f(distance / settings.lodDistance)));
+		chunkLevels[c] = level;
+	}
+
+	// Refine chunks until no two neighbours are more than a level apart
+	const unsigned int side = chunksPerSide;
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (unsigned int c = 0; c < chunks.size(); c++)
+		{
+			unsigned int cx = c % side, cz = c / side;
+			unsigned char finest = chunkLevels[c];
+			if (cx > 0) finest = std::min(finest, chunkLevels[c - 1]);
+			if (cx + 1 < side) finest = std::min(finest, chunkLevels[c + 1]);
+			if (cz > 0) finest = std::min(finest, chunkLevels[c - side]);
+			if (cz + 1 < side) finest = std::min(finest, chunkLevels[c + side]);
+			if (chunkLevels[c] > finest + 1)
+			{
+				chunkLevels[c] = finest + 1;
+				changed = true;
+			}
+		}
+	}
+
+	for (unsigned int c = 0; c < chunks.size(); c++)
+	{
+		const Chunk& chunk = chunks[c];
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			glm::vec3 corner(planes[p].x >= 0.0f ? chunk.high.x : chunk.low.x,
+				planes[p].y >= 0.0f ? chunk.high.y : chunk.low.y,
+				planes[p].z >= 0.0f ? chunk.high.z : chunk.low.z);
+			outside = glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f;
+		}
+		if (outside)
+		{
+			out.frustumCulled++;
+			continue;
+		}
+
+		unsigned int cx = c % side, cz = c / side;
+		unsigned char level = chunkLevels[c];
+		unsigned int mask = 0;
+		if (cz > 0 && chunkLevels[c - side] > level)
+			mask |= EDGE_NEAR_Z;
+		if (cx + 1 < side && chunkLevels[c + 1] > level)
+			mask |= EDGE_FAR_X;
+		if (cz + 1 < side && chunkLevels[c + side] > level)
+			mask |= EDGE_FAR_Z;
+		if (cx > 0 && chunkLevels[c - 1] > level)
+			mask |= EDGE_NEAR_X;
+
+		const Pattern& pattern = patterns[level * EDGE_MASKS + mask];
+		out.counts.push_back((int)pattern.count);
+		out.offsets.push_back((const void*)(uintptr_t)(pattern.offset * sizeof(unsigned int)));
+		out.baseVertices.push_back((int)(c * chunkVertexCount));
+		out.visibleMeshlets++;
+		out.visibleTriangles += pattern.count / 3;
+	}
+}
+
+void Terrain::expand(const MeshletDrawList& list, std::vector<unsigned int>& indices) const
+{
+	for (size_t i = 0; i < list.counts.size(); i++)
+	{
+		size_t first = (uintptr_t)list.offsets[i] / sizeof(unsigned int);
+		unsigned int base = i < list.baseVertices.size() ? (unsigned int)list.baseVertices[i] : 0;
+		for (size_t k = 0; k < (size_t)list.counts[i]; k++)
+			indices.push_back(patternIndices[first + k] + base);
+	}
+}
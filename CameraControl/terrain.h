@@ -0,0 +1,99 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "meshlet.h"
+
+// Shape and detail of the generated ground, distances in terrain units
+struct TerrainSettings
+{
+	// Side of the square terrain, centred on the origin, and of its chunks
+	float size = 1024.0f;
+	float chunkSize = 32.0f;
+	// Quads along a chunk side at full detail, a power of two
+	unsigned int chunkQuads = 16;
+	// Hills rise and fall by up to hillHeight over about hillSize
+	float hillHeight = 14.0f;
+	float hillSize = 160.0f;
+	unsigned int seed = 1;
+	// The ground is level at height 0 within flatRadius of the origin, where the
+	// scene stands, and becomes hills over the next flatBlend
+	float flatRadius = 24.0f;
+	float flatBlend = 40.0f;
+	// The floor texture repeats every textureSize
+	float textureSize = 100.0f;
+	// Chunks nearer the camera than this are drawn at full detail, and every
+	// doubling of the distance halves the quads along their sides
+	float lodDistance = 24.0f;
+};
+
+// Heightmap ground split into fixed size chunks drawn with geomipmapping. Every
+// chunk has its own vertices at full detail, and one shared set of index patterns
+// draws any chunk at any detail level with base vertex draws. Neighbouring chunks
+// are kept at most one level apart, and a chunk next to a coarser one drops every
+// other vertex along that edge so the two meet without cracks
+class Terrain
+{
+public:
+	// Edges of a chunk that are stitched to a coarser neighbour
+	enum Edge { EDGE_NEAR_Z = 1, EDGE_FAR_X = 2, EDGE_FAR_Z = 4, EDGE_NEAR_X = 8 };
+	static const unsigned int EDGE_MASKS = 16;
+
+	// Build the chunk meshes on the job threads, threads = 0 uses every scheduler thread
+	void generate(const TerrainSettings& settings, unsigned int threads = 0);
+
+	// Ground height under a point, the same the vertices are built from
+	float height(float x, float z) const;
+
+	// Vertices of every chunk one after another, position, normal and texture
+	// coordinates in 9 floats like the object meshes
+	const std::vector<float>& vertices() const { return chunkVertices; }
+	// The index patterns of every detail level and edge mask, relative to the first vertex of a chunk
+	const std::vector<unsigned int>& indices() const { return patternIndices; }
+
+	unsigned int chunkCount() const { return (unsigned int)chunks.size(); }
+	unsigned int levels() const { return levelCount; }
+	glm::vec3 boundsMin() const { return low; }
+	glm::vec3 boundsMax() const { return high; }
+
+	// Pick a detail level for every chunk from its distance to the camera, and list
+	// the index ranges of the chunks in the frustum with the base vertex of each.
+	// model places the terrain and is expected to have uniform scale
+	void select(const glm::mat4& model, const glm::mat4& viewProjection, const glm::vec3& cameraPos,
+		MeshletDrawList& out) const;
+
+	// Append the ranges of out with their base vertex added, for renderers that
+	// have no base vertex draws
+	void expand(const MeshletDrawList& list, std::vector<unsigned int>& indices) const;
+
+private:
+	struct Chunk
+	{
+		glm::vec3 low, high;
+	};
+
+	struct Pattern
+	{
+		unsigned int offset;
+		unsigned int count;
+	};
+
+	void buildPatterns();
+
+	TerrainSettings settings;
+	unsigned int chunksPerSide = 0;
+	unsigned int chunkVertexCount = 0;
+	unsigned int levelCount = 0;
+	glm::vec3 low, high;
+
+	std::vector<Chunk> chunks;
+	std::vector<float> chunkVertices;
+	// levelCount * EDGE_MASKS patterns, the coarsest level is never stitched
+	std::vector<Pattern> patterns;
+	std::vector<unsigned int> patternIndices;
+};
+
+#endif
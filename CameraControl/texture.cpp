@@ -6,55 +6,20 @@
 
 #include <GLFW/glfw3.h>
 
-#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
-#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
-#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+#include "dds.h"
 
-GLuint textureID[5];
+GLuint loadDDS(const char* imagepath) {
 
-GLuint loadDDS(const char* imagepath, int textureIndex) {
+	DDSImage image;
 
-	unsigned char header[124];
-
-	FILE* fp;
-
-	/* try to open the file */
-	fp = fopen(imagepath, "rb");
-	if (fp == NULL) {
-		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar();
-		return 0;
-	}
-
-	/* verify the type of file */
-	char filecode[4];
-	fread(filecode, 1, 4, fp);
-	if (strncmp(filecode, "DDS ", 4) != 0) {
-		fclose(fp);
+	/* read the file and its mip chain */
+	if (!readDDS(imagepath, image)) {
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath);
 		return 0;
 	}
 
-	/* get the surface desc */
-	fread(&header, 124, 1, fp);
-
-	unsigned int height = *(unsigned int*)&(header[8]);
-	unsigned int width = *(unsigned int*)&(header[12]);
-	unsigned int linearSize = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC = *(unsigned int*)&(header[80]);
-
-
-	unsigned char* buffer;
-	unsigned int bufsize;
-	/* how big is it going to be including all mipmaps? */
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize;
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char));
-	fread(buffer, 1, bufsize, fp);
-	/* close the file pointer */
-	fclose(fp);
-
-	unsigned int components = (fourCC == FOURCC_DXT1) ? 3 : 4;
 	unsigned int format;
-	switch (fourCC)
+	switch (image.fourCC)
 	{
 	case FOURCC_DXT1:
 		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
@@ -62,33 +27,33 @@ GLuint loadDDS(const char* imagepath, int textureIndex) {
 	case FOURCC_DXT3:
 		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
 		break;
-	case FOURCC_DXT5:
+	default:
 		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
 		break;
-	default:
-		free(buffer);
-		return 0;
 	}
 
-	// Populate textureid array only once
-	if (textureID[0] == NULL) {
-		glGenTextures(5, textureID);
-	}
+	// Create one OpenGL texture
+	GLuint textureID;
+	glGenTextures(1, &textureID);
 
 	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glActiveTexture(GL_TEXTURE0 + textureIndex);
-	glBindTexture(GL_TEXTURE_2D, textureID[textureIndex]);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, textureID);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
+	unsigned int blockSize = image.blockSize;
 	unsigned int offset = 0;
+	unsigned int width = image.width;
+	unsigned int height = image.height;
 
 	/* load the mipmaps */
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level)
+	for (unsigned int level = 0; level < image.mipMapCount && (width || height); ++level)
 	{
 		unsigned int size = ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		if (offset + size > image.data.size())
+			break;
 		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,
-			0, size, buffer + offset);
+			0, size, &image.data[0] + offset);
 
 		offset += size;
 		width /= 2;
@@ -100,9 +65,21 @@ GLuint loadDDS(const char* imagepath, int textureIndex) {
 
 	}
 
-	free(buffer);
+	return textureID;
+
+
+}
 
-	return textureID[textureIndex];
+GLuint createSolidTexture(unsigned char r, unsigned char g, unsigned char b) {
+	unsigned char texel[4] = { r, g, b, 255 };
 
+	GLuint textureID;
+	glGenTextures(1, &textureID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-}
\ No newline at end of file
+	return textureID;
+}
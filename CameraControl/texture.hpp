@@ -1,8 +1,12 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
-// Load a .DDS file using GLFW's own loader
-GLuint loadDDS(const char* imagepath, int textureIndex);
+// Load a .DDS file using GLFW's own loader into a new texture, returns 0 on failure.
+// The texture is left bound to unit 0
+GLuint loadDDS(const char* imagepath);
+
+// A 1x1 texture of one colour, used where a material has no texture map
+GLuint createSolidTexture(unsigned char r, unsigned char g, unsigned char b);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+// Flat transform hierarchy with dirty subtree updates
+
+#include <algorithm>
+
+#include "transform.h"
+#include "parallel.h"
+
+// Fewer moved nodes than this are cheaper to rebuild on the calling thread
+static const size_t PARALLEL_MIN_NODES = 4096;
+
+unsigned int TransformHierarchy::add(const glm::mat4& local, int parent)
+{
+	unsigned int node = (unsigned int)parents.size();
+	glm::mat4 world = parent >= 0 ? worlds[parent] * local : local;
+
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(world);
+	subtreeEnds.push_back(node + 1);
+	dirtyFlags.push_back(0);
+
+	if (!depthFirst)
+		return node;
+
+	// Close the subtrees the new node is not part of
+	if (parent < 0)
+		openPath.clear();
+	while (!openPath.empty() && openPath.back() != (unsigned int)parent)
+		openPath.pop_back();
+	if (parent >= 0 && openPath.empty())
+	{
+		depthFirst = false;
+		return node;
+	}
+
+	for (size_t i = 0; i < openPath.size(); i++)
+		subtreeEnds[openPath[i]] = node + 1;
+	openPath.push_back(node);
+	return node;
+}
+
+void TransformHierarchy::sortDepthFirst(std::vector<unsigned int>& remap)
+{
+	size_t count = parents.size();
+
+	// Children of every node in the order they were added
+	std::vector<unsigned int> childStart(count + 1, 0);
+	for (size_t i = 0; i < count; i++)
+		if (parents[i] >= 0)
+			childStart[parents[i] + 1]++;
+	for (size_t i = 0; i < count; i++)
+		childStart[i + 1] += childStart[i];
+	std::vector<unsigned int> children(childStart[count]);
+	std::vector<unsigned int> fill(childStart.begin(), childStart.end() - 1);
+	for (size_t i = 0; i < count; i++)
+		if (parents[i] >= 0)
+			children[fill[parents[i]]++] = (unsigned int)i;
+
+	// Pre-order walk from every root, pushing children in reverse so they come out in order
+	std::vector<unsigned int> order;
+	order.reserve(count);
+	std::vector<unsigned int> stack;
+	for (size_t root = 0; root < count; root++)
+	{
+		if (parents[root] >= 0)
+			continue;
+		stack.push_back((unsigned int)root);
+		while (!stack.empty())
+		{
+			unsigned int node = stack.back();
+			stack.pop_back();
+			order.push_back(node);
+			for (unsigned int c = childStart[node + 1]; c > childStart[node]; c--)
+				stack.push_back(children[c - 1]);
+		}
+	}
+
+	remap.assign(count, 0);
+	for (size_t i = 0; i < count; i++)
+		remap[order[i]] = (unsigned int)i;
+
+	// Adding them again in the new order rebuilds every world matrix, pending moves included
+	std::vector<int> oldParents;
+	std::vector<glm::mat4> oldLocals;
+	oldParents.swap(parents);
+	oldLocals.swap(locals);
+
+	clear();
+	reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		int parent = oldParents[order[i]];
+		add(oldLocals[order[i]], parent >= 0 ? (int)remap[parent] : -1);
+	}
+}
+
+void TransformHierarchy::setLocal(unsigned int node, const glm::mat4& local)
+{
+	locals[node] = local;
+	if (!dirtyFlags[node])
+	{
+		dirtyFlags[node] = 1;
+		dirty.push_back(node);
+	}
+}
+
+void TransformHierarchy::rebuild(unsigned int begin, unsigned int end)
+{
+	// Parents come first, so each parent is final by the time its children need it
+	for (unsigned int i = begin; i < end; i++)
+	{
+		int parent = parents[i];
+		worlds[i] = parent >= 0 ? worlds[parent] * locals[i] : locals[i];
+	}
+}
+
+size_t TransformHierarchy::update(unsigned int threads)
+{
+	if (dirty.empty())
+		return 0;
+
+	for (size_t i = 0; i < dirty.size(); i++)
+		dirtyFlags[dirty[i]] = 0;
+
+	// Without contiguous subtrees the only safe update is all of it
+	if (!depthFirst)
+	{
+		dirty.clear();
+		rebuild(0, (unsigned int)parents.size());
+		return parents.size();
+	}
+
+	// Ancestors sort before their descendants, a dirty node inside a subtree
+	// that is rebuilt anyway is skipped
+	std::sort(dirty.begin(), dirty.end());
+	ranges.clear();
+	size_t moved = 0;
+	unsigned int covered = 0;
+	for (size_t i = 0; i < dirty.size(); i++)
+	{
+		unsigned int node = dirty[i];
+		if (node < covered)
+			continue;
+		covered = subtreeEnds[node];
+		ranges.push_back(std::make_pair(node, covered));
+		moved += covered - node;
+	}
+	dirty.clear();
+
+	// Subtrees never overlap, so they can be rebuilt on different threads
+	size_t minRanges = std::max<size_t>(1, ranges.size() * PARALLEL_MIN_NODES / moved);
+	parallelFor(ranges.size(), minRanges, [this](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			rebuild(ranges[i].first, ranges[i].second);
+	}, threads);
+
+	return moved;
+}
+
+void TransformHierarchy::reserve(size_t count)
+{
+	parents.reserve(count);
+	subtreeEnds.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	dirtyFlags.reserve(count);
+}
+
+void TransformHierarchy::clear()
+{
+	parents.clear();
+	subtreeEnds.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	dirtyFlags.clear();
+	openPath.clear();
+	depthFirst = true;
+}
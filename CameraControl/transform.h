@@ -0,0 +1,62 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Local and world matrices of a node tree, stored in flat arrays with parents
+// before their children. When nodes are kept in depth first order every subtree
+// is the contiguous range [node, subtreeEnd), so moving a node only touches the
+// nodes below it. World matrices of nodes that did not move are never rebuilt
+class TransformHierarchy
+{
+public:
+	// Append a node, parent -1 for a root. The parent has to exist already, its
+	// world matrix is used straight away. Returns the node's index
+	unsigned int add(const glm::mat4& local, int parent = -1);
+
+	// True while every subtree is contiguous. Adding a child to a node whose
+	// subtree is already closed off breaks this until sortDepthFirst is called
+	bool isDepthFirst() const { return depthFirst; }
+
+	// Reorder the nodes depth first, remap[old index] = new index
+	void sortDepthFirst(std::vector<unsigned int>& remap);
+
+	// Replace a node's local matrix, its subtree is rebuilt by the next update
+	void setLocal(unsigned int node, const glm::mat4& local);
+
+	// Rebuild the world matrices of every subtree whose root moved, splitting the
+	// subtrees over threads when enough nodes moved. Returns the number of nodes rebuilt
+	size_t update(unsigned int threads = 0);
+
+	const glm::mat4& world(unsigned int node) const { return worlds[node]; }
+	const glm::mat4& local(unsigned int node) const { return locals[node]; }
+	int parent(unsigned int node) const { return parents[node]; }
+	size_t size() const { return parents.size(); }
+
+	void reserve(size_t count);
+	void clear();
+
+private:
+	void rebuild(unsigned int begin, unsigned int end);
+
+	std::vector<int> parents;
+	std::vector<unsigned int> subtreeEnds;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+
+	// Nodes moved since the last update, each listed once
+	std::vector<unsigned int> dirty;
+	std::vector<unsigned char> dirtyFlags;
+	// Subtree ranges of the current update, kept to avoid allocating every frame
+	std::vector<std::pair<unsigned int, unsigned int> > ranges;
+
+	// Nodes from the last root to the last node added, the only valid parents
+	// for a new node if the order is to stay depth first
+	std::vector<unsigned int> openPath;
+	bool depthFirst = true;
+};
+
+#endif
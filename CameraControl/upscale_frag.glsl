@@ -0,0 +1,32 @@
+#version 330 core
+out vec3 color;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// One texel of the scene target, and the furthest texture coordinate inside the drawn part
+uniform vec2 texelSize;
+uniform vec2 sourceMax;
+// 0 is a plain bilinear upscale, higher values sharpen what the lower resolution blurred
+uniform float sharpness;
+
+vec3 fetch(vec2 offset)
+{
+    return texture(source, min(TexCoords + offset * texelSize, sourceMax)).rgb;
+}
+
+// Bilinear upscale with an unsharp mask over the four neighbours. The result is
+// kept within the neighbourhood's range so edges do not ring
+void main()
+{
+    vec3 centre = fetch(vec2(0.0f));
+    vec3 left = fetch(vec2(-1.0f, 0.0f));
+    vec3 right = fetch(vec2(1.0f, 0.0f));
+    vec3 down = fetch(vec2(0.0f, -1.0f));
+    vec3 up = fetch(vec2(0.0f, 1.0f));
+
+    vec3 sharpened = centre + sharpness * (4.0f * centre - left - right - down - up);
+    vec3 lowest = min(centre, min(min(left, right), min(down, up)));
+    vec3 highest = max(centre, max(max(left, right), max(down, up)));
+    color = clamp(sharpened, lowest, highest);
+}
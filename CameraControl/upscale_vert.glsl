@@ -0,0 +1,13 @@
+#version 330 core
+out vec2 TexCoords;
+
+// The part of the scene target that was drawn to, in texture coordinates
+uniform vec2 sourceScale;
+
+// One triangle covering the window, made from the vertex index without any buffer
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = corner * sourceScale;
+    gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
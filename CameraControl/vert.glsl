@@ -1,21 +1,39 @@
 #version 330 core
+// Features are #defined after the version line, see shaders::Permutations
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 vertexUV;
+#ifdef INSTANCED
+// One model matrix per instance instead of per draw
+layout (location = 3) in mat4 instanceModel;
+#endif
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 UV;
+out float ViewDepth;
 
-uniform mat4 model;
+#ifndef INSTANCED
+// Written per draw to a ring buffer
+layout (std140) uniform Object
+{
+    mat4 model;
+};
+#endif
 uniform mat4 view;
 uniform mat4 projection;
-uniform mat4 transform;
+
+// Must match depth_vert.glsl exactly for the depth pre-pass
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = transform * (projection * view * model * vec4(position, 1.0f));
+#ifdef INSTANCED
+    mat4 model = instanceModel;
+#endif
+    gl_Position = projection * view * model * vec4(position, 1.0f);
     FragPos = vec3(model * vec4(position, 1.0f));
+    ViewDepth = -(view * vec4(FragPos, 1.0f)).z;
     Normal = mat3(transpose(inverse(model))) * normal;
 
     UV = vertexUV;
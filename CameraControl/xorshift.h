@@ -0,0 +1,26 @@
+#ifndef XORSHIFT_H
+#define XORSHIFT_H
+
+#include <stdint.h>
+
+// xorshift32 for procedural placement, the same seed always gives the same
+// sequence on every platform and thread count
+class XorShift32
+{
+public:
+	explicit XorShift32(uint32_t seed) : state(seed * 2654435761u + 1u) {}
+
+	// Uniform in [0, 1)
+	float operator()()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+private:
+	uint32_t state;
+};
+
+#endif